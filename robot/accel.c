@@ -25,19 +25,56 @@
 
 #include "accel.h"
 #include "pta.h"
+#include "seqlock.h"
 
 #define ACCEL_AVG 10
 
+/* The running mean and variance of the raw readings move 1/ACCEL_VAR_W
+   of the way to each new reading. */
+#define ACCEL_VAR_W	8
+
+/* Differences from the mean past this (4 G) are clipped, so the
+   square fits. */
+#define ACCEL_DIFF_MAX	(4 * ACCEL_1G)
+
 unsigned int last_accel_reading;
 unsigned int accel_sum = 0;
 unsigned int accel_cnt = 0;
 unsigned int accel_pta_cb_bad_tpu_pin = 0;
 int accel_0g = ACCEL_0G;
 
+/* Running mean (in 1/16ths of a count) and variance of the raw
+   readings, and the latest single reading, published under
+   accel_sample_lock.  The interrupt handler is the only writer, and
+   no task can preempt it. */
+int accel_mean16 = 0;
+int accel_var = 0;
+static accel_sample_t accel_sample;
+static seqlock_t accel_sample_lock = SEQLOCK_INIT;
+
 void
 accel_pta_cb (int tpu_pin, unsigned int reading)
 {
+  int d;
+
   if (tpu_pin == ACCEL_TPU_PIN) {
+    if (accel_mean16 == 0)
+      accel_mean16 = reading * 16;
+    d = (int)reading * 16 - accel_mean16;
+    accel_mean16 += d / ACCEL_VAR_W;
+    d /= 16;
+    if (d > ACCEL_DIFF_MAX)
+      d = ACCEL_DIFF_MAX;
+    if (d < -ACCEL_DIFF_MAX)
+      d = -ACCEL_DIFF_MAX;
+    accel_var += (d * d - accel_var) / ACCEL_VAR_W;
+
+    seqlock_write_begin(&accel_sample_lock);
+    accel_sample.seq++;
+    accel_sample.accel = (((int)reading - accel_0g) * 65536) / ACCEL_1G;
+    accel_sample.var = accel_var;
+    seqlock_write_end(&accel_sample_lock);
+
     accel_sum += reading;
     accel_cnt++;
     if (accel_cnt == ACCEL_AVG) {
@@ -71,3 +108,17 @@ accel_read (void)
 {
   return (((int)last_accel_reading - accel_0g) * 65536) / ACCEL_1G;
 }
+
+/* Get the latest single (not averaged) reading, and how noisy the
+   readings have been lately.  Doesn't block the interrupt handler that
+   takes the readings. */
+void
+accel_get_sample (accel_sample_t *sample)
+{
+  unsigned int seq;
+
+  do {
+    seq = seqlock_read_begin(&accel_sample_lock);
+    *sample = accel_sample;
+  } while (seqlock_read_retry(&accel_sample_lock, seq));
+}
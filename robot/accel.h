@@ -35,6 +35,20 @@
 #define ACCEL_0G	20230
 #define ACCEL_1G	5130
 
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+/* The latest single reading from the accelerometer, as
+   accel_get_sample() returns it. */
+typedef struct accel_sample
+{
+  unsigned int seq;		/* goes up by one with every reading */
+  int accel;			/* G's as a 16.16, like accel_read() */
+  unsigned int var;		/* running variance of the raw readings,
+				   in raw counts squared */
+} accel_sample_t;
+
 /**********************************************************************/
 /* Functions */
 /**********************************************************************/
@@ -50,4 +64,9 @@ unsigned int accel_read_raw (void);
    positive reading indicates a forward tilt of the platform. */
 int accel_read (void);
 
+/* Get the latest single (not averaged) reading, and how noisy the
+   readings have been lately.  Doesn't block the interrupt handler that
+   takes the readings. */
+void accel_get_sample (accel_sample_t *sample);
+
 #endif
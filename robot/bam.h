@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Binary angles (BAM).  A bam32 is a heading where the whole circle is
+ * 2^32, so 90 degrees is 0x40000000 and going past 360 is just unsigned
+ * overflow - there's never any fixing up to do.  Subtracting two of
+ * them and looking at the result as an int gives the signed turn from
+ * one to the other, -180 up to (not including) 180 degrees, so heading
+ * errors, differences and which way to turn are each a subtract and a
+ * compare.  One LSB is about 8.4e-8 degrees, finer than a 16.16.
+ */
+
+#ifndef _BAM_H
+#define _BAM_H
+
+#include "f16_16.h"
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+/* int is 32 bits on the robot (see uint32 in motor.h), and keeping to
+   it lets the host benchmarks wrap the same way. */
+typedef unsigned int bam32;
+
+/**********************************************************************/
+/* Constants */
+/**********************************************************************/
+
+/* 2^39 / 360: bam32s per degree, scaled so a 16.16 (>> 23) or a 24.8
+   (>> 15) can be converted with one 32x32->64 multiply. */
+#define BAM32_MULT		1527099483L
+
+/* 2^32 / (2 pi): bam32s per radian. */
+#define BAM32_PER_RADIAN	683565276L
+
+/**********************************************************************/
+/* Macros */
+/**********************************************************************/
+
+/* Whole degrees 'd' (0 to 360, a constant) as a bam32. */
+#define BAM32_DEG(d)	((bam32)(((unsigned long long)(d) << 32) / 360))
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+/* Any 16.16 angle in degrees, negative or past 360, as a bam32. */
+static inline bam32
+bam32_from_f16_16(f16_16 a)
+{
+  return (bam32)(((long long)a * BAM32_MULT + (1 << 22)) >> 23);
+}
+
+/* Any 24.8 angle in degrees as a bam32. */
+static inline bam32
+bam32_from_24_8(int a)
+{
+  return (bam32)(((long long)a * BAM32_MULT + (1 << 14)) >> 15);
+}
+
+/* A bam32 as a 16.16 number of degrees, 0 up to 360, rounded.  (91 is
+   half a 16.16 LSB in bam32s; adding it before truncating rounds, and
+   wraps just below 360 round to 0.) */
+static inline f16_16
+f16_16_from_bam32(bam32 b)
+{
+  return (f16_16)(((unsigned long long)(bam32)(b + 91) * 360) >> 16);
+}
+
+/* A bam32 as a 24.8 number of degrees, 0 up to 360, rounded. */
+static inline int
+f24_8_from_bam32(bam32 b)
+{
+  return (int)(((unsigned long long)(bam32)(b + 23302) * 360) >> 24);
+}
+
+/* The signed turn from 'from' to 'to' in degrees as a 16.16 number;
+   positive is clockwise. */
+static inline f16_16
+bam32_diff_f16_16(bam32 to, bam32 from)
+{
+  return (f16_16)(((long long)(int)(to - from) * 360 + 32768) >> 16);
+}
+
+/* How far apart two headings are, whichever way round. */
+static inline bam32
+bam32_abs_diff(bam32 a, bam32 b)
+{
+  bam32 d = a - b;
+
+  return (int)d < 0 ? -d : d;
+}
+
+/* Whichever of two headings is further counterclockwise. */
+static inline bam32
+bam32_leftmost(bam32 a1, bam32 a2)
+{
+  return (int)(a1 - a2) > 0 ? a2 : a1;
+}
+
+/* A bam32 in hundredths of a degree, 0 to 35999, rounded (59652 is
+   half a hundredth). */
+static inline int
+bam32_centideg(bam32 b)
+{
+  return (int)(((unsigned long long)((bam32)(b + 59652) >> 8) * 36000) >> 24);
+}
+
+/* Whole degrees, and hundredths of a degree past that, for traces and
+   the LCD. */
+static inline int
+bam32_deg(bam32 b)
+{
+  return bam32_centideg(b) / 100;
+}
+
+static inline int
+bam32_hundredths(bam32 b)
+{
+  return bam32_centideg(b) % 100;
+}
+
+#endif /* _BAM_H */
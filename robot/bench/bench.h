@@ -0,0 +1,58 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Helpers shared by the host benchmarks.
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <time.h>
+
+/* Results get added in here so the compiler can't throw away the
+   work being timed. */
+static volatile long bench_sink;
+
+/* Current time in nanoseconds. */
+static inline double
+bench_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Small, repeatable pseudo-random number generator (xorshift32), so
+   every run uses the same inputs. */
+static unsigned bench_rand_state = 2463534242U;
+
+static inline unsigned
+bench_rand(void)
+{
+  bench_rand_state ^= bench_rand_state << 13;
+  bench_rand_state ^= bench_rand_state >> 17;
+  bench_rand_state ^= bench_rand_state << 5;
+  return bench_rand_state;
+}
+
+#endif /* _BENCH_H */
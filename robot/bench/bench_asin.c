@@ -0,0 +1,308 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Compares the table-interpolated fastasin()/fastacos() (and their
+ * 16.16 versions) with the binary-search and sqrti() based routines
+ * they replaced: time per call for inputs in different parts of the
+ * range, since the old routines' cost depended on the input, and the
+ * worst error over every possible input.  The new routines do the same
+ * work for any input in each half of the range (below 0.5 and above
+ * it), so what spread they show is between those two paths.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+#include "bench.h"
+#include "fastint.h"
+
+#define NUM_INPUTS	4096
+#define TIMING_REPS	1000
+
+#define RAD_TO_DEG	(180.0 / M_PI)
+
+/**********************************************************************/
+/* The old routines */
+/**********************************************************************/
+
+static int
+old_fastasin(int x)
+{
+  int a,b,i;
+
+  if (x<0)
+    {
+      a=270;
+      b=359;
+    }
+  else
+    {
+      a=0;
+      b=90;
+    }
+
+  while(a < b-1)      //binary search
+    {
+      i= (a+b)>>1;
+      if (isinof[i]<x)
+	a=i;
+      else
+	b=i;
+    }
+  if (x-isinof[a] > isinof[b]-x)
+    return b;
+  else
+    return a;
+}
+
+static int
+old_fastacos(int x)
+{
+  int a,b,i;
+
+  a=0;
+  b=180;
+  while(a < b-1)      //binary search
+    {
+      i= (a+b)>>1;
+      if (icosof[i]>x)
+	a=i;
+      else
+	b=i;
+    }
+  if (icosof[a]-x > x-icosof[b])
+    return b;
+  else
+    return a;
+}
+
+/* The old fastasin_f16_16() went through sqrti() past 0.5; the table
+   part of it is the same as the new one, so it is done here as
+   fastasin_f16_16() of an input below 0.5. */
+static f16_16
+old_fastasin_f16_16(f16_16 x)
+{
+  f16_16 a;
+  int neg = 0;
+
+  if (x < 0)
+    {
+      neg = 1;
+      x = -x;
+    }
+  if (x > 65536)
+    x = 65536;
+
+  if (x <= 32768)
+    a = fastasin_f16_16(x);
+  else
+    a = 90 * 65536 - 2 * fastasin_f16_16(sqrti((65536 - x) * 32768));
+
+  return neg ? -a : a;
+}
+
+/**********************************************************************/
+/* Timing */
+/**********************************************************************/
+
+static long ins[NUM_INPUTS];
+
+/* Fills ins[] with values whose magnitude is from lo to hi (as a
+   fraction of 'one'), with random signs. */
+static void
+gen_range(double lo, double hi, long one)
+{
+  int i;
+
+  for (i = 0; i < NUM_INPUTS; i++) {
+    long v = (long)((lo + (hi - lo) * (bench_rand() / 4294967296.0)) * one);
+
+    ins[i] = (bench_rand() & 1) ? -v : v;
+  }
+}
+
+#define TIMER(_name, _call)						\
+  static double								\
+  time_##_name(void)							\
+  {									\
+    double t0 = bench_now_ns();						\
+    long sum = 0;							\
+    int r, i;								\
+    for (r = 0; r < TIMING_REPS; r++)					\
+      for (i = 0; i < NUM_INPUTS; i++) {				\
+	long x = ins[i];						\
+	sum += (_call);							\
+      }									\
+    bench_sink += sum;							\
+    return (bench_now_ns() - t0) / ((double)TIMING_REPS * NUM_INPUTS);	\
+  }
+
+TIMER(old_fastasin, old_fastasin(x))
+TIMER(fastasin, fastasin(x))
+TIMER(old_fastacos, old_fastacos(x))
+TIMER(fastacos, fastacos(x))
+TIMER(old_fastasin_f16_16, old_fastasin_f16_16(x))
+TIMER(fastasin_f16_16, fastasin_f16_16(x))
+
+typedef struct routine
+{
+  const char *name;
+  long one;				/* 1.0 in the input format */
+  double (*time)(void);
+} routine_t;
+
+static routine_t routines[] = {
+  { "old fastasin", 16384, time_old_fastasin },
+  { "fastasin", 16384, time_fastasin },
+  { "old fastacos", 16384, time_old_fastacos },
+  { "fastacos", 16384, time_fastacos },
+  { "old fastasin_f16_16", 65536, time_old_fastasin_f16_16 },
+  { "fastasin_f16_16", 65536, time_fastasin_f16_16 },
+};
+
+#define NUM_ROUTINES	(sizeof(routines) / sizeof(routines[0]))
+
+/* The parts of the range the timing is done over. */
+static const double ranges[][2] = {
+  { 0.0, 0.1 }, { 0.4, 0.6 }, { 0.9, 0.99 }, { 0.999, 1.0 }, { 0.0, 1.0 },
+};
+
+#define NUM_RANGES	(sizeof(ranges) / sizeof(ranges[0]))
+
+/**********************************************************************/
+/* Accuracy */
+/**********************************************************************/
+
+/* Worst error, in degrees, of a 16.16 routine over every input from
+   -1 to 1. */
+static double
+err_f16_16(f16_16 (*fn)(f16_16), int cos)
+{
+  double worst = 0;
+  f16_16 x;
+
+  for (x = -65536; x <= 65536; x++) {
+    double ref = (cos ? acos(x / 65536.0) : asin(x / 65536.0)) * RAD_TO_DEG;
+    double e = fabs(fn(x) / 65536.0 - ref);
+
+    if (e > worst)
+      worst = e;
+  }
+  return worst;
+}
+
+/* Worst error, in degrees, of a whole degree routine over every 18.14
+   input from -1 to 1. */
+static double
+err_18_14(int (*fn)(int), int cos)
+{
+  double worst = 0;
+  int x;
+
+  for (x = -16384; x <= 16384; x++) {
+    double ref = (cos ? acos(x / 16384.0) : asin(x / 16384.0)) * RAD_TO_DEG;
+    double r = fn(x);
+    double e;
+
+    if (!cos && r >= 180)
+      r -= 360;
+    e = fabs(r - ref);
+    if (e > worst)
+      worst = e;
+  }
+  return worst;
+}
+
+static f16_16
+fastacos_f16_16_fn(f16_16 x)
+{
+  return fastacos_f16_16(x);
+}
+
+int
+main(void)
+{
+  double t, lo, hi, e_old, e_new;
+  unsigned i, r;
+  int ok = 1;
+
+  printf ("ns/op for |x| in:%4s", "");
+  for (r = 0; r < NUM_RANGES; r++)
+    printf (" %5.3f-%-5.3f", ranges[r][0], ranges[r][1]);
+  printf ("   spread\n");
+
+  for (i = 0; i < NUM_ROUTINES; i++) {
+    printf ("%-21s", routines[i].name);
+    lo = 1e30;
+    hi = 0;
+    for (r = 0; r < NUM_RANGES; r++) {
+      gen_range(ranges[r][0], ranges[r][1], routines[i].one);
+      t = routines[i].time();
+      printf (" %11.2f", t);
+      if (t < lo)
+	lo = t;
+      if (t > hi)
+	hi = t;
+    }
+    printf ("   %5.2fx\n", hi / lo);
+  }
+
+  printf ("\nworst error over every input (degrees):\n");
+
+  e_old = err_18_14(old_fastasin, 0);
+  e_new = err_18_14(fastasin, 0);
+  printf ("  fastasin         old %.4f new %.4f\n", e_old, e_new);
+  if (e_new > e_old || e_new > 0.5 + 0.0013)
+    ok = 0;
+
+  e_old = err_18_14(old_fastacos, 1);
+  e_new = err_18_14(fastacos, 1);
+  printf ("  fastacos         old %.4f new %.4f\n", e_old, e_new);
+  if (e_new > e_old || e_new > 0.5 + 0.0013)
+    ok = 0;
+
+  e_old = err_f16_16(old_fastasin_f16_16, 0);
+  e_new = err_f16_16(fastasin_f16_16, 0);
+  printf ("  fastasin_f16_16  old %.4f new %.4f\n", e_old, e_new);
+  if (e_new > 0.0013)
+    ok = 0;
+
+  e_new = err_f16_16(fastacos_f16_16_fn, 1);
+  printf ("  fastacos_f16_16      %6s new %.4f\n", "", e_new);
+  if (e_new > 0.0013)
+    ok = 0;
+
+  /* Out of range readings clamp to +/-90, all the way out. */
+  printf ("  fastasin_f16_16 of LONG_MIN %ld, -2 %ld, 2 %ld, LONG_MAX %ld\n",
+	  (long)fastasin_f16_16(LONG_MIN), (long)fastasin_f16_16(-2 * 65536),
+	  (long)fastasin_f16_16(2 * 65536), (long)fastasin_f16_16(LONG_MAX));
+  if (fastasin_f16_16(LONG_MIN) != -90 * 65536 ||
+      fastasin_f16_16(-2 * 65536) != -90 * 65536 ||
+      fastasin_f16_16(2 * 65536) != 90 * 65536 ||
+      fastasin_f16_16(LONG_MAX) != 90 * 65536)
+    ok = 0;
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
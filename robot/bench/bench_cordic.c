@@ -0,0 +1,195 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Compares CORDIC vectoring (cordic_vector()) against the sqrti() plus
+ * fastatan2() pair that find_candle() used to use, at a few iteration
+ * counts, and checks cordic_sincos() against libm.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "fastint.h"
+
+#define NUM_INPUTS	4096
+#define TIMING_REPS	1000
+#define ACCURACY_INPUTS	2000000
+
+#define RAD_TO_DEG	(180.0 / M_PI)
+
+static long xs[NUM_INPUTS], ys[NUM_INPUTS];
+
+/* The candle position find_candle() works with is in deci-inches and
+   in front of the robot; check the whole plane anyway. */
+static void
+gen_xy(long *x, long *y)
+{
+  do {
+    *x = (long)(bench_rand() % 2001) - 1000;
+    *y = (long)(bench_rand() % 2001) - 1000;
+  } while (*x == 0 && *y == 0);
+}
+
+static double
+angle_diff(double a, double b)
+{
+  double d = fmod(fabs(a - b), 360.0);
+
+  return d > 180.0 ? 360.0 - d : d;
+}
+
+static double
+time_old(void)
+{
+  double t0 = bench_now_ns();
+  long sum = 0;
+  int r, i;
+
+  for (r = 0; r < TIMING_REPS; r++)
+    for (i = 0; i < NUM_INPUTS; i++)
+      sum += sqrti(xs[i] * xs[i] + ys[i] * ys[i]) + fastatan2(ys[i], xs[i]);
+  bench_sink += sum;
+  return (bench_now_ns() - t0) / ((double)TIMING_REPS * NUM_INPUTS);
+}
+
+static double
+time_cordic(int iters)
+{
+  double t0 = bench_now_ns();
+  unsigned long mag;
+  f16_16 angle;
+  long sum = 0;
+  int r, i;
+
+  for (r = 0; r < TIMING_REPS; r++)
+    for (i = 0; i < NUM_INPUTS; i++) {
+      cordic_vector(xs[i], ys[i], iters, &mag, &angle);
+      sum += mag + angle;
+    }
+  bench_sink += sum;
+  return (bench_now_ns() - t0) / ((double)TIMING_REPS * NUM_INPUTS);
+}
+
+/* Worst magnitude and angle errors of cordic_vector() at 'iters'
+   iterations (or of the old pair, if iters is 0). */
+static void
+vector_error(int iters, double *mag_err, double *angle_err)
+{
+  int i;
+
+  *mag_err = *angle_err = 0;
+  for (i = 0; i < ACCURACY_INPUTS; i++) {
+    long x, y;
+    double mag, angle, ref_angle;
+
+    gen_xy(&x, &y);
+    if (iters == 0) {
+      mag = sqrti(x * x + y * y);
+      angle = fastatan2(y, x);
+    } else {
+      unsigned long m;
+      f16_16 a;
+
+      cordic_vector(x, y, iters, &m, &a);
+      mag = m;
+      angle = a / 65536.0;
+    }
+
+    ref_angle = atan2((double)y, (double)x) * RAD_TO_DEG;
+    if (ref_angle < 0)
+      ref_angle += 360.0;
+    if (fabs(mag - hypot(x, y)) > *mag_err)
+      *mag_err = fabs(mag - hypot(x, y));
+    if (angle_diff(angle, ref_angle) > *angle_err)
+      *angle_err = angle_diff(angle, ref_angle);
+  }
+}
+
+/* Worst error of cordic_sincos() over a sweep of angles, in 16.16
+   LSBs. */
+static double
+sincos_error(int iters)
+{
+  double worst = 0;
+  f16_16 a;
+
+  for (a = -360 * 65536; a <= 360 * 65536; a += 977) {
+    f16_16 s, c;
+    double r = a / 65536.0 / RAD_TO_DEG;
+
+    cordic_sincos(a, iters, &s, &c);
+    if (fabs(s - sin(r) * 65536) > worst)
+      worst = fabs(s - sin(r) * 65536);
+    if (fabs(c - cos(r) * 65536) > worst)
+      worst = fabs(c - cos(r) * 65536);
+  }
+  return worst;
+}
+
+int
+main(void)
+{
+  static const int iters[] = { 8, 12, 16, CORDIC_MAX_ITERS };
+  double t_old, t, mag_err, angle_err;
+  unsigned i;
+  int ok = 1;
+
+  for (i = 0; i < NUM_INPUTS; i++)
+    gen_xy(&xs[i], &ys[i]);
+
+  t_old = time_old();
+  vector_error(0, &mag_err, &angle_err);
+  printf ("%-22s %8s %8s %10s %10s\n",
+	  "", "ns/op", "speedup", "mag err", "angle err");
+  printf ("%-22s %8.2f %8s %10.3f %10.4f\n",
+	  "sqrti + fastatan2", t_old, "", mag_err, angle_err);
+
+  for (i = 0; i < sizeof(iters) / sizeof(iters[0]); i++) {
+    char name[32];
+
+    t = time_cordic(iters[i]);
+    vector_error(iters[i], &mag_err, &angle_err);
+    sprintf(name, "cordic_vector (%d)", iters[i]);
+    printf ("%-22s %8.2f %7.2fx %10.3f %10.4f\n",
+	    name, t, t_old / t, mag_err, angle_err);
+
+    /* Magnitude within rounding, angle within the last step (plus
+       the rounding in the 16.16 angle table). */
+    if (mag_err > 1.0 ||
+	angle_err > atan(ldexp(1.0, -(iters[i] - 1))) * RAD_TO_DEG +
+	iters[i] / 65536.0)
+      ok = 0;
+  }
+
+  for (i = 0; i < sizeof(iters) / sizeof(iters[0]); i++) {
+    double e = sincos_error(iters[i]);
+
+    printf ("cordic_sincos (%d): worst error %.1f LSB\n", iters[i], e);
+  }
+  if (sincos_error(16) > 4.0)
+    ok = 0;
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Compares the divide-free division routines in f16_16.c against
+ * div_f16_16(): time per call, and error against the exact quotient.
+ * Exits non-zero if the new routines miss the error bound documented
+ * in f16_16.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "f16_16.h"
+
+#define NUM_PAIRS	4096
+#define TIMING_REPS	2000
+#define ACCURACY_PAIRS	20000000
+
+/* Worst error allowed, in LSBs, for a quotient 'q' (also in LSBs):
+   half an LSB of rounding, plus what's left over from the reciprocal
+   being slightly off. */
+#define MAX_ERR(q)	(0.5 + fabs(q) / (1 << 29))
+
+static f16_16 as[NUM_PAIRS], bs[NUM_PAIRS];
+
+/* A random 32 bit value with a random magnitude, so small numbers
+   get tested as much as big ones. */
+static f16_16
+rand_f16_16(void)
+{
+  int shift = bench_rand() % 32;
+  int v = (int)(bench_rand() >> shift);
+
+  return (bench_rand() & 1) ? -v : v;
+}
+
+typedef struct err_stats
+{
+  const char *name;
+  double max_err;	/* worst error in LSBs */
+  double max_excess;	/* worst error beyond rounding, relative to q */
+  double sum_sq;
+  long long n;
+  long long bad;
+  int reference;	/* just for comparison, don't count misses */
+} err_stats_t;
+
+static void
+note_err(err_stats_t *st, f16_16 a, f16_16 b, f16_16 r, double exact)
+{
+  double e = fabs((double)r - exact);
+
+  st->n++;
+  st->sum_sq += e * e;
+  if (e > st->max_err)
+    st->max_err = e;
+  if (e > 0.5 && (e - 0.5) / fabs(exact) > st->max_excess)
+    st->max_excess = (e - 0.5) / fabs(exact);
+  if (e > MAX_ERR(exact) && !st->reference && st->bad++ < 10)
+    printf ("  %s: %ld / %ld = %ld, exact %.2f\n",
+	    st->name, (long)a, (long)b, (long)r, exact);
+}
+
+static void
+print_err(err_stats_t *st)
+{
+  printf ("  %-16s max %.2f LSB, rms %.4f LSB, "
+	  "worst beyond rounding %.3g * q\n", st->name, st->max_err,
+	  sqrt(st->sum_sq / st->n), st->max_excess);
+}
+
+static int
+check_accuracy(void)
+{
+  err_stats_t old = { "div_f16_16" }, fast = { "div_f16_16_fast" };
+  err_stats_t recip = { "recip_f16_16" };
+
+  old.reference = 1;
+  long long i;
+
+  for (i = 0; i < ACCURACY_PAIRS; i++) {
+    f16_16 a = rand_f16_16();
+    f16_16 b = rand_f16_16();
+    double exact = (double)a * 65536.0 / (double)b;
+
+    if (b == 0)
+      continue;
+    if (fabs(exact) < 2147483647.0) {
+      note_err(&old, a, b, div_f16_16(a, b), exact);
+      note_err(&fast, a, b, div_f16_16_fast(a, b), exact);
+    } else if (div_f16_16_fast(a, b) != (exact > 0 ? F16_16_MAX : F16_16_MIN)) {
+      if (fast.bad++ < 10)
+	printf ("  div_f16_16_fast: %ld / %ld didn't saturate\n",
+		(long)a, (long)b);
+    }
+
+    exact = 4294967296.0 / (double)b;
+    if (fabs(exact) < 2147483647.0)
+      note_err(&recip, 65536, b, recip_f16_16(b), exact);
+  }
+
+  printf ("accuracy over %d random pairs:\n", ACCURACY_PAIRS);
+  print_err(&old);
+  print_err(&fast);
+  print_err(&recip);
+
+  return fast.bad == 0 && recip.bad == 0;
+}
+
+int
+main(void)
+{
+  int i, r, ok;
+  double t0, t1, t_old, t_fast, t_by;
+  f16_16_divisor d;
+  long sum;
+
+  /* Timing inputs: what the kalman filter divides - a covariance by
+     itself plus a small measurement weight. */
+  for (i = 0; i < NUM_PAIRS; i++) {
+    as[i] = (f16_16)(bench_rand() % (100 * 65536));
+    bs[i] = as[i] + 6554;
+  }
+
+  sum = 0;
+  t0 = bench_now_ns();
+  for (r = 0; r < TIMING_REPS; r++)
+    for (i = 0; i < NUM_PAIRS; i++)
+      sum += div_f16_16(as[i] + r, bs[i]);
+  t1 = bench_now_ns();
+  t_old = (t1 - t0) / ((double)TIMING_REPS * NUM_PAIRS);
+
+  t0 = bench_now_ns();
+  for (r = 0; r < TIMING_REPS; r++)
+    for (i = 0; i < NUM_PAIRS; i++)
+      sum += div_f16_16_fast(as[i] + r, bs[i]);
+  t1 = bench_now_ns();
+  t_fast = (t1 - t0) / ((double)TIMING_REPS * NUM_PAIRS);
+
+  /* The constant divisor case: the heading update's divide by pi. */
+  f16_16_divisor_init(&d, F16_16_PI);
+  t0 = bench_now_ns();
+  for (r = 0; r < TIMING_REPS; r++)
+    for (i = 0; i < NUM_PAIRS; i++)
+      sum += div_f16_16_by(as[i] + r, &d);
+  t1 = bench_now_ns();
+  t_by = (t1 - t0) / ((double)TIMING_REPS * NUM_PAIRS);
+  bench_sink += sum;
+
+  printf ("speed (ns/op):\n");
+  printf ("  div_f16_16:       %.3f\n", t_old);
+  printf ("  div_f16_16_fast:  %.3f (%.2fx)\n", t_fast, t_old / t_fast);
+  printf ("  div_f16_16_by:    %.3f (%.2fx)\n", t_by, t_old / t_by);
+
+  ok = check_accuracy();
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
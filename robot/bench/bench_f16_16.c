@@ -0,0 +1,219 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Compares the 16.16 multiply routines in f16_16.h against the
+ * original four-partial-product mult_f16_16(), both for speed and
+ * accuracy.  Exits non-zero if the new routines are ever less
+ * accurate than the old one, or if the saturating/wrapping variants
+ * misbehave on overflow.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "f16_16.h"
+
+#define NUM_PAIRS	4096
+#define TIMING_REPS	4000
+#define ACCURACY_PAIRS	20000000
+
+/* The original mult_f16_16(), kept here as the reference.  The only
+   change is the cast of the result through int, which makes it
+   behave on a 64-bit host the way it does on the 32-bit target. */
+static f16_16
+old_mult_f16_16(f16_16 a, f16_16 b)
+{
+  int a_frac;
+  int a_int;
+  int b_frac;
+  int b_int;
+  int sign = 1;
+
+  if (a < 0) {
+    sign = -sign;
+    a = -a;
+  }
+  if (b < 0) {
+    sign = -sign;
+    b = -b;
+  }
+  a_frac = a & 0x0000ffff;
+  a_int  = (a & 0xffff0000) / 65536;
+  b_frac = b & 0x0000ffff;
+  b_int  = (b & 0xffff0000) / 65536;
+
+  return (int)((((unsigned)(a_frac * b_frac) >> 16) +
+		(a_frac * b_int) +
+		(a_int * b_frac) +
+		((a_int * b_int) << 16)) * sign);
+}
+
+/* A random 32 bit value with a random magnitude, so small numbers
+   get tested as much as big ones. */
+static f16_16
+rand_f16_16(void)
+{
+  int shift = bench_rand() % 32;
+  int v = (int)(bench_rand() >> shift);
+
+  return (bench_rand() & 1) ? -v : v;
+}
+
+/* Error of 'r' against the exact product 'p' (which is a 32.32
+   number), in 1/65536ths of a 16.16 LSB. */
+static long long
+err_of(f16_16 r, long long p)
+{
+  long long e = (long long)r * 65536 - p;
+
+  return e < 0 ? -e : e;
+}
+
+static f16_16 as[NUM_PAIRS], bs[NUM_PAIRS];
+
+static int
+check_accuracy(void)
+{
+  long long i, n = 0, worse = 0;
+  long long max_old = 0, max_new = 0;
+  double sum_old = 0, sum_new = 0;
+
+  for (i = 0; i < ACCURACY_PAIRS; i++) {
+    f16_16 a = rand_f16_16();
+    f16_16 b = rand_f16_16();
+    long long p = (long long)a * b;
+    long long e_old, e_new;
+
+    /* Only products that fit in a 16.16 are comparable. */
+    if ((p >> 16) > F16_16_MAX || (p >> 16) < F16_16_MIN)
+      continue;
+    n++;
+
+    e_old = err_of(old_mult_f16_16(a, b), p);
+    e_new = err_of(mult_f16_16(a, b), p);
+    if (e_new > e_old || e_new > 32768) {
+      if (worse++ < 10)
+	printf ("  less accurate: %ld * %ld: old %ld new %ld\n",
+		(long)a, (long)b, (long)old_mult_f16_16(a, b),
+		(long)mult_f16_16(a, b));
+    }
+    if (mult_f16_16_sat(a, b) != mult_f16_16(a, b) ||
+	mult_f16_16_wrap(a, b) != mult_f16_16(a, b)) {
+      if (worse++ < 10)
+	printf ("  variants disagree in range: %ld * %ld\n", (long)a, (long)b);
+    }
+
+    if (e_old > max_old)
+      max_old = e_old;
+    if (e_new > max_new)
+      max_new = e_new;
+    sum_old += (double)e_old * e_old;
+    sum_new += (double)e_new * e_new;
+  }
+
+  printf ("accuracy over %lld in-range products (error in LSBs):\n", n);
+  printf ("  old mult_f16_16:  max %.4f rms %.4f\n",
+	  max_old / 65536.0, sqrt(sum_old / n) / 65536.0);
+  printf ("  new mult_f16_16:  max %.4f rms %.4f\n",
+	  max_new / 65536.0, sqrt(sum_new / n) / 65536.0);
+
+  return worse == 0;
+}
+
+static int
+check_overflow(void)
+{
+  long i, bad = 0;
+
+  for (i = 0; i < ACCURACY_PAIRS / 10; i++) {
+    f16_16 a = rand_f16_16();
+    f16_16 b = rand_f16_16();
+    long long p = ((long long)a * b + 32768) >> 16;
+    f16_16 want_sat = p > F16_16_MAX ? F16_16_MAX :
+      (p < F16_16_MIN ? F16_16_MIN : (f16_16)p);
+    f16_16 want_wrap = (f16_16)(int)(unsigned)(p & 0xffffffffLL);
+
+    if (mult_f16_16_sat(a, b) != want_sat ||
+	mult_f16_16_wrap(a, b) != want_wrap) {
+      if (bad++ < 10)
+	printf ("  overflow handling wrong: %ld * %ld\n", (long)a, (long)b);
+    }
+  }
+
+  /* The corners. */
+  if (mult_f16_16_sat(F16_16_MAX, F16_16_MAX) != F16_16_MAX ||
+      mult_f16_16_sat(F16_16_MIN, F16_16_MAX) != F16_16_MIN ||
+      mult_f16_16_sat(F16_16_MIN, F16_16_MIN) != F16_16_MAX) {
+    printf ("  saturation corners wrong\n");
+    bad++;
+  }
+
+  printf ("overflow checks: %s\n", bad ? "FAILED" : "ok");
+  return bad == 0;
+}
+
+/* Times one routine over the input arrays, returns ns per call. */
+#define TIME_MULT(fn)						\
+  ({								\
+    double t0, t1;						\
+    long sum = 0;						\
+    int r, i;							\
+    t0 = bench_now_ns();					\
+    for (r = 0; r < TIMING_REPS; r++)				\
+      for (i = 0; i < NUM_PAIRS; i++)				\
+	sum += fn(as[i], bs[i] + r);				\
+    t1 = bench_now_ns();					\
+    bench_sink += sum;						\
+    (t1 - t0) / ((double)TIMING_REPS * NUM_PAIRS);		\
+  })
+
+int
+main(void)
+{
+  int i, ok;
+  double t_old, t_new, t_sat, t_wrap;
+
+  /* Timing inputs: values in the range the control loops see - a few
+     hundred in either direction with full fractional parts. */
+  for (i = 0; i < NUM_PAIRS; i++) {
+    as[i] = (f16_16)((int)(bench_rand() % (512 * 65536)) - 256 * 65536);
+    bs[i] = (f16_16)((int)(bench_rand() % (16 * 65536)) - 8 * 65536);
+  }
+
+  t_old = TIME_MULT(old_mult_f16_16);
+  t_new = TIME_MULT(mult_f16_16);
+  t_sat = TIME_MULT(mult_f16_16_sat);
+  t_wrap = TIME_MULT(mult_f16_16_wrap);
+
+  printf ("speed (ns/op):\n");
+  printf ("  old mult_f16_16:  %.3f\n", t_old);
+  printf ("  mult_f16_16:      %.3f (%.2fx)\n", t_new, t_old / t_new);
+  printf ("  mult_f16_16_sat:  %.3f (%.2fx)\n", t_sat, t_old / t_sat);
+  printf ("  mult_f16_16_wrap: %.3f (%.2fx)\n", t_wrap, t_old / t_wrap);
+
+  ok = check_accuracy();
+  ok &= check_overflow();
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Runs each of the tilt estimators in kalman_engines[] (the one state
+ * kalman(), the two state kalman2() and comp_filter()) over the same
+ * gyro/accelerometer data and compares their time per step and how
+ * well they track the tilt.
+ *
+ * With a file argument, replays a recording made on the robot with
+ * 'krec 1' / 'krec'.  Without one, makes up a minute of data with a
+ * known tilt and a gyro bias that drifts the way a warming-up gyro
+ * does, and exits non-zero if kalman2() doesn't track the bias or
+ * doesn't beat kalman() at tracking the tilt.
+ *
+ * bench_kalman_ss is the same thing built with KALMAN_STEADY_GAIN.  It
+ * also checks that the gain tables give exactly the same answers as
+ * the full update.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+#include "f16_16.h"
+#include "fastint.h"
+#include "kalman.h"
+
+#define UPDATE_HZ	250
+#define MAX_SAMPLES	(600 * UPDATE_HZ)
+#define SYNTH_SECONDS	60
+#define TIMING_REPS	50
+
+/* kalman2() has to get the bias within this many degrees/second of
+   the real one by the end of the made up data. */
+#define MAX_BIAS_ERR	0.1
+
+/* kalman.c's current gain tables; NULL makes the filters do the full
+   update. */
+struct kalman_gain_tables;
+extern struct kalman_gain_tables *volatile kalman_gain_cur;
+
+static kalman_state_t st;
+
+static f16_16 gyro[MAX_SAMPLES], accel[MAX_SAMPLES];
+static double truth[MAX_SAMPLES];	/* tilt in degrees, made up data only */
+static double true_bias;
+static int num_samples;
+static int kalman_every = 25;
+/* A recording made with KALMAN_ACCEL_EVENTS marks the samples the
+   filter ran an update on, instead of updating every kalman_every. */
+static char update[MAX_SAMPLES];
+static int marked;
+
+/* Roughly gaussian noise with standard deviation 'sd'. */
+static double
+noise(double sd)
+{
+  double sum = 0;
+  int i;
+
+  for (i = 0; i < 12; i++)
+    sum += (double)bench_rand() / 4294967296.0;
+  return (sum - 6.0) * sd;
+}
+
+/* A minute of rocking back and forth around a slowly changing lean,
+   with gyro and accelerometer noise about what the robot's sensors
+   show, and a gyro bias that creeps up from 0 to 1.5 degrees/second
+   as if the gyro were warming up. */
+static void
+make_data(void)
+{
+  double dt = 1.0 / UPDATE_HZ, t, angle, rate, b;
+  int i;
+
+  for (i = 0; i < SYNTH_SECONDS * UPDATE_HZ; i++) {
+    t = i * dt;
+    angle = 3.0 * sin(2 * M_PI * 0.7 * t) + 2.0 * sin(2 * M_PI * 0.05 * t);
+    rate = 3.0 * 2 * M_PI * 0.7 * cos(2 * M_PI * 0.7 * t) +
+      2.0 * 2 * M_PI * 0.05 * cos(2 * M_PI * 0.05 * t);
+    b = 1.5 * (1.0 - exp(-t / 15.0));
+
+    truth[i] = angle;
+    gyro[i] = (f16_16)lrint((rate + b + noise(0.3)) * 65536.0);
+    accel[i] = (f16_16)lrint((sin(angle * M_PI / 180) + noise(0.02)) *
+			     65536.0);
+    true_bias = b;
+  }
+  num_samples = i;
+}
+
+/* Reads what kalman_dump_record() printed. */
+static int
+read_data(const char *name)
+{
+  FILE *f = fopen(name, "r");
+  char line[200];
+  long g, a;
+  int n, every, m, k;
+
+  if (f == NULL) {
+    perror(name);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), f) != NULL && num_samples < MAX_SAMPLES) {
+    if (sscanf(line, "# kalman recording: %d samples at %*d Hz, kalman every %d",
+	       &n, &every) == 2)
+      kalman_every = every;
+    else if ((k = sscanf(line, "%ld %ld %d", &g, &a, &m)) >= 2) {
+      gyro[num_samples] = (f16_16)g;
+      accel[num_samples] = (f16_16)a;
+      update[num_samples] = (k == 3 && m != 0);
+      marked |= (k == 3);
+      num_samples++;
+    }
+  }
+  fclose(f);
+  return num_samples > 0;
+}
+
+/* Feeds the data through 'fn' the way kalman_step() does, starting
+   from the startup state.  Fills in 'out' with the filter's angle
+   after each step if it isn't NULL. */
+static void
+run_filter(kalman_fn fn, f16_16 *out)
+{
+  f16_16 a, theta_m = 0, th;
+  int i, cnt = 0, do_kalman;
+
+  kalman_state_init(&st);
+  for (i = 0; i < num_samples; i++) {
+    do_kalman = marked ? update[i] : (++cnt == kalman_every);
+    if (do_kalman) {
+      cnt = 0;
+      a = accel[i];
+      if (a > 65536)
+	a = 65536;
+      if (a < -65536)
+	a = -65536;
+      theta_m = fastasin_f16_16(a);
+    }
+    th = fn(&st, gyro[i], theta_m, do_kalman);
+    if (out != NULL)
+      out[i] = th;
+  }
+}
+
+static double
+time_filter(kalman_fn fn)
+{
+  double t0, t1;
+  int r;
+
+  run_filter(fn, NULL);	/* warm up */
+  t0 = bench_now_ns();
+  for (r = 0; r < TIMING_REPS; r++)
+    run_filter(fn, NULL);
+  t1 = bench_now_ns();
+  bench_sink += st.theta;
+  return (t1 - t0) / ((double)TIMING_REPS * num_samples);
+}
+
+/* Time per step for the steps that use the accelerometer - the
+   filter's worst case. */
+static double
+time_update(kalman_fn fn)
+{
+  double t0, t1;
+  int i, r;
+
+  t0 = bench_now_ns();
+  for (r = 0; r < TIMING_REPS; r++) {
+    kalman_state_init(&st);
+    for (i = 0; i < num_samples; i++)
+      fn(&st, gyro[i], accel[i], 1);
+  }
+  t1 = bench_now_ns();
+  bench_sink += st.theta;
+  return (t1 - t0) / ((double)TIMING_REPS * num_samples);
+}
+
+/* RMS difference between the filter's angle and the truth (or, for a
+   recording, the accelerometer's angle), skipping the first 5 seconds
+   while the filter settles. */
+static double
+rms_err(f16_16 *out, int synthetic)
+{
+  double sum = 0, ref, e;
+  int i, n = 0;
+
+  for (i = 5 * UPDATE_HZ; i < num_samples; i++) {
+    if (synthetic)
+      ref = truth[i];
+    else if (marked ? update[i] : (i % kalman_every == kalman_every - 1))
+      ref = fastasin_f16_16(accel[i]) / 65536.0;
+    else
+      continue;
+    e = out[i] / 65536.0 - ref;
+    sum += e * e;
+    n++;
+  }
+  return n ? sqrt(sum / n) : 0;
+}
+
+static f16_16 out[MAX_SAMPLES];
+
+#ifdef KALMAN_STEADY_GAIN
+static f16_16 full_out[MAX_SAMPLES];
+
+/* Runs 'fn' with the gain tables, then with the full update, and
+   checks that they agree exactly. */
+static int
+check_tables(const char *name, kalman_fn fn)
+{
+  double t_full, t_table, u_full, u_table;
+  int i, bad = 0;
+
+  kalman_gain_cur = NULL;
+  t_full = time_filter(fn);
+  u_full = time_update(fn);
+  run_filter(fn, full_out);
+  kalman_gain_init();
+  t_table = time_filter(fn);
+  u_table = time_update(fn);
+  run_filter(fn, out);
+
+  for (i = 0; i < num_samples; i++)
+    if (out[i] != full_out[i] && bad++ < 10)
+      printf ("  %s: step %d table %ld full %ld\n", name, i,
+	      (long)out[i], (long)full_out[i]);
+  printf ("  %-8s  full %.3f, table %.3f ns/step; "
+	  "updates: full %.3f, table %.3f (%.2fx) ns/step, %s\n",
+	  name, t_full, t_table, u_full, u_table, u_full / u_table,
+	  bad ? "DIFFERENT" : "same results");
+  return bad == 0;
+}
+#endif
+
+int
+main(int argc, char **argv)
+{
+  int synthetic = (argc < 2), ok = 1, i;
+  double err, err_kalman = 0, err_kalman2 = 0, b = 0;
+
+  if (synthetic)
+    make_data();
+  else if (!read_data(argv[1]))
+    return 1;
+
+  if (marked)
+    printf ("%d samples at %d Hz, kalman update on marked samples\n",
+	    num_samples, UPDATE_HZ);
+  else
+    printf ("%d samples at %d Hz, kalman update every %d\n", num_samples,
+	    UPDATE_HZ, kalman_every);
+
+#ifdef KALMAN_STEADY_GAIN
+  printf ("gain tables against the full update:\n");
+  for (i = 0; i < kalman_num_engines; i++)
+    ok = check_tables(kalman_engines[i].name, kalman_engines[i].fn) && ok;
+#endif
+
+  printf ("%-10s %12s %14s %12s\n", "", "ns/step", "ns/update", "rms error");
+  for (i = 0; i < kalman_num_engines; i++) {
+    double t = time_filter(kalman_engines[i].fn);
+    double u = time_update(kalman_engines[i].fn);
+
+    run_filter(kalman_engines[i].fn, out);
+    err = rms_err(out, synthetic);
+    if (kalman_engines[i].fn == kalman)
+      err_kalman = err;
+    if (kalman_engines[i].fn == kalman2) {
+      err_kalman2 = err;
+      b = st.bias / 65536.0;
+    }
+    printf ("%-10s %12.3f %14.3f %12.4f\n", kalman_engines[i].name, t, u,
+	    err);
+  }
+  printf ("(rms error in degrees against the %s)\n",
+	  synthetic ? "real tilt" : "accelerometer");
+
+  printf ("kalman2 gyro bias: %.4f degrees/second", b);
+  if (synthetic)
+    printf (" (real bias %.4f)", true_bias);
+  printf ("\n");
+
+  if (synthetic)
+    ok = ok && fabs(b - true_bias) < MAX_BIAS_ERR && err_kalman2 < err_kalman;
+  if (synthetic || !ok)
+    printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Micro-benchmarks for the math kernels the robot runs: time per call
+ * and error against a libm (double) reference, for each one.  The
+ * kernels are built from the robot sources, unchanged.
+ *
+ * Usage: bench_math [-j file]
+ *
+ * Prints a table, and with -j also writes the results to 'file' as
+ * JSON so runs can be compared by a script.  Exits non-zero if any
+ * kernel's worst error is over its limit in the table below.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+#include "f16_16.h"
+#include "fixed.h"
+#include "fastint.h"
+#include "bam.h"
+
+#define NUM_INPUTS	4096
+#define TIMING_REPS	1000
+#define ACCURACY_RUNS	256	/* x NUM_INPUTS fresh inputs */
+
+#define RAD_TO_DEG	(180.0 / M_PI)
+
+/**********************************************************************/
+/* Inputs */
+/**********************************************************************/
+
+static long in_a[NUM_INPUTS], in_b[NUM_INPUTS];
+
+/* Random long in [lo, hi]. */
+static long
+rand_range(long lo, long hi)
+{
+  unsigned long long r = ((unsigned long long)bench_rand() << 32) | bench_rand();
+
+  return lo + (long)(r % (unsigned long long)(hi - lo + 1));
+}
+
+/* Random value with a random magnitude up to 'bits' bits, so small
+   numbers get tested as much as big ones. */
+static long
+rand_mag(int bits)
+{
+  long v = (long)(bench_rand() >> (32 - bits));
+
+  v >>= bench_rand() % bits;
+  return (bench_rand() & 1) ? -v : v;
+}
+
+/* Each kernel's inputs cover the range the robot code feeds it. */
+
+static void
+gen_mult_f16_16(long *a, long *b)
+{
+  *a = rand_mag(25);		/* +/- 256.0 */
+  *b = rand_mag(20);		/* +/- 8.0 */
+}
+
+static void
+gen_div_f16_16(long *a, long *b)
+{
+  *a = rand_mag(23);		/* +/- 64.0 */
+  do
+    *b = rand_mag(23);
+  while (*b == 0);
+}
+
+static void
+gen_mult_24_8(long *a, long *b)
+{
+  *a = rand_mag(20);		/* +/- 4096.0 */
+  *b = rand_mag(16);		/* +/- 128.0 */
+}
+
+static void
+gen_atan2(long *a, long *b)
+{
+  do {
+    *a = rand_mag(20);
+    *b = rand_mag(20);
+  } while (*a == 0 && *b == 0);
+}
+
+static void
+gen_trig_18_14(long *a, long *b)
+{
+  *a = rand_range(-16384, 16384);
+  *b = 0;
+}
+
+static void
+gen_sin_f16_16(long *a, long *b)
+{
+  *a = rand_range(-65536, 65536);
+  *b = 0;
+}
+
+static void
+gen_heading_f16_16(long *a, long *b)
+{
+  *a = rand_range(0, 360 * 65536 - 1);
+  *b = rand_range(0, 360 * 65536 - 1);
+}
+
+static void
+gen_sqrti(long *a, long *b)
+{
+  *a = (long)(bench_rand() >> (bench_rand() % 32));
+  *b = 0;
+}
+
+static void
+gen_sqrti64(long *a, long *b)
+{
+  *a = (long)((((unsigned long long)bench_rand() << 32) | bench_rand()) >>
+	      (1 + bench_rand() % 63));
+  *b = 0;
+}
+
+/**********************************************************************/
+/* Kernels and their references */
+/**********************************************************************/
+
+/* Angles come back from the trig routines in [0,360); this is how far
+   apart two of them are. */
+static double
+angle_diff(double a, double b)
+{
+  double d = fmod(fabs(a - b), 360.0);
+
+  return d > 180.0 ? 360.0 - d : d;
+}
+
+static double
+err_lsb(double r, double ref)
+{
+  return fabs(r - ref);
+}
+
+static double run_mult_f16_16(long a, long b) { return mult_f16_16(a, b); }
+static double ref_mult_f16_16(long a, long b) { return (double)a * b / 65536.0; }
+
+static double run_div_f16_16(long a, long b) { return div_f16_16(a, b); }
+static double ref_div_f16_16(long a, long b) { return (double)a * 65536.0 / b; }
+
+static double run_mult_24_8(long a, long b) { return mult_24_8(a, b); }
+static double ref_mult_24_8(long a, long b) { return (double)a * b / 256.0; }
+
+static double run_fastatan2(long a, long b) { return fastatan2(a, b); }
+static double
+ref_fastatan2(long a, long b)
+{
+  double d = atan2((double)a, (double)b) * RAD_TO_DEG;
+
+  return d < 0 ? d + 360.0 : d;
+}
+
+static double run_fastatan2_24_8(long a, long b) { return fastatan2_24_8(a, b) / 256.0; }
+
+static double run_fastasin(long a, long b) { return fastasin(a); }
+static double
+ref_fastasin(long a, long b)
+{
+  double d = asin(a / 16384.0) * RAD_TO_DEG;
+
+  return d < 0 ? d + 360.0 : d;
+}
+
+static double run_fastasin_f16_16(long a, long b) { return fastasin_f16_16(a) / 65536.0; }
+static double ref_fastasin_f16_16(long a, long b) { return asin(a / 65536.0) * RAD_TO_DEG; }
+
+static double run_fastacos(long a, long b) { return fastacos(a); }
+static double ref_fastacos(long a, long b) { return acos(a / 16384.0) * RAD_TO_DEG; }
+
+static double run_fastacos_f16_16(long a, long b) { return fastacos_f16_16(a) / 65536.0; }
+static double ref_fastacos_f16_16(long a, long b) { return acos(a / 65536.0) * RAD_TO_DEG; }
+
+/* The signed turn between two 16.16 headings, through bam32s. */
+static double
+run_bam32_diff(long a, long b)
+{
+  return bam32_diff_f16_16(bam32_from_f16_16(a), bam32_from_f16_16(b));
+}
+static double
+ref_bam32_diff(long a, long b)
+{
+  double d = fmod((double)(a - b), 360.0 * 65536);
+
+  if (d >= 180.0 * 65536)
+    d -= 360.0 * 65536;
+  else if (d < -180.0 * 65536)
+    d += 360.0 * 65536;
+  return d;
+}
+
+static double run_sqrti(long a, long b) { return sqrti(a); }
+static double ref_sqrti(long a, long b) { return sqrt((double)a); }
+
+static double run_sqrti64(long a, long b) { return sqrti64(a); }
+
+/* The timing loops call each kernel directly (not through a function
+   pointer), so inlined kernels are timed inlined.  TIMER() is for the
+   kernels that take one input, TIMER2() for the ones that take two. */
+#define TIMER_LOOP(_name, _inputs, _call)				\
+  static double								\
+  time_##_name(void)							\
+  {									\
+    double t0;								\
+    long sum = 0;							\
+    int r, i;								\
+    t0 = bench_now_ns();						\
+    for (r = 0; r < TIMING_REPS; r++)					\
+      for (i = 0; i < NUM_INPUTS; i++) {				\
+	_inputs;							\
+	sum += (_call);							\
+      }									\
+    bench_sink += sum;							\
+    return (bench_now_ns() - t0) / ((double)TIMING_REPS * NUM_INPUTS);	\
+  }
+#define TIMER(_name, _call)						\
+  TIMER_LOOP(_name, long a = in_a[i], _call)
+#define TIMER2(_name, _call)						\
+  TIMER_LOOP(_name, long a = in_a[i]; long b = in_b[i], _call)
+
+TIMER2(mult_f16_16, mult_f16_16(a, b))
+TIMER2(div_f16_16, div_f16_16(a, b))
+TIMER2(mult_24_8, mult_24_8(a, b))
+TIMER2(fastatan2, fastatan2(a, b))
+TIMER2(fastatan2_24_8, fastatan2_24_8(a, b))
+TIMER(fastasin, fastasin(a))
+TIMER(fastasin_f16_16, fastasin_f16_16(a))
+TIMER(fastacos, fastacos(a))
+TIMER(fastacos_f16_16, fastacos_f16_16(a))
+TIMER2(bam32_diff, bam32_diff_f16_16(bam32_from_f16_16(a), bam32_from_f16_16(b)))
+TIMER(sqrti, sqrti(a))
+TIMER(sqrti64, sqrti64(a))
+
+typedef struct kernel
+{
+  const char *name;
+  const char *units;			/* what the error is measured in */
+  double max_err_limit;			/* fail if the worst error is over */
+  void (*gen)(long *a, long *b);	/* make one set of inputs */
+  double (*time)(void);			/* ns per call over in_a/in_b */
+  double (*run)(long a, long b);	/* one call, for checking */
+  double (*ref)(long a, long b);	/* what it should have returned */
+  double (*err)(double r, double ref);
+
+  /* Results. */
+  double ns_per_op;
+  double max_err;
+  double rms_err;
+  long long samples;
+} kernel_t;
+
+/* The error limits are what each kernel manages today, so a change
+   that makes one worse shows up as a failure.  Tighten them when a
+   kernel gets better. */
+static kernel_t kernels[] = {
+  { "mult_f16_16", "LSB", 0.5, gen_mult_f16_16, time_mult_f16_16,
+    run_mult_f16_16, ref_mult_f16_16, err_lsb },
+  { "div_f16_16", "LSB", 1.5, gen_div_f16_16, time_div_f16_16,
+    run_div_f16_16, ref_div_f16_16, err_lsb },
+  { "mult_24_8", "LSB", 1.0, gen_mult_24_8, time_mult_24_8,
+    run_mult_24_8, ref_mult_24_8, err_lsb },
+  { "fastatan2", "deg", 0.51, gen_atan2, time_fastatan2,
+    run_fastatan2, ref_fastatan2, angle_diff },
+  { "fastatan2_24_8", "deg", 1.05 / 256, gen_atan2, time_fastatan2_24_8,
+    run_fastatan2_24_8, ref_fastatan2, angle_diff },
+  { "fastasin", "deg", 0.5013, gen_trig_18_14, time_fastasin,
+    run_fastasin, ref_fastasin, angle_diff },
+  { "fastasin_f16_16", "deg", 0.0012, gen_sin_f16_16, time_fastasin_f16_16,
+    run_fastasin_f16_16, ref_fastasin_f16_16, err_lsb },
+  { "fastacos", "deg", 0.5013, gen_trig_18_14, time_fastacos,
+    run_fastacos, ref_fastacos, angle_diff },
+  { "fastacos_f16_16", "deg", 0.0012, gen_sin_f16_16, time_fastacos_f16_16,
+    run_fastacos_f16_16, ref_fastacos_f16_16, err_lsb },
+  { "bam32_diff", "LSB", 1.0, gen_heading_f16_16, time_bam32_diff,
+    run_bam32_diff, ref_bam32_diff, err_lsb },
+  { "sqrti", "units", 0.5, gen_sqrti, time_sqrti,
+    run_sqrti, ref_sqrti, err_lsb },
+  { "sqrti64", "units", 0.5, gen_sqrti64, time_sqrti64,
+    run_sqrti64, ref_sqrti, err_lsb },
+};
+
+#define NUM_KERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static void
+bench_kernel(kernel_t *k)
+{
+  double sum_sq = 0;
+  int run, i;
+
+  for (i = 0; i < NUM_INPUTS; i++)
+    k->gen(&in_a[i], &in_b[i]);
+  k->ns_per_op = k->time();
+
+  k->max_err = 0;
+  k->samples = 0;
+  for (run = 0; run < ACCURACY_RUNS; run++) {
+    for (i = 0; i < NUM_INPUTS; i++) {
+      long a, b;
+      double e;
+
+      k->gen(&a, &b);
+      e = k->err(k->run(a, b), k->ref(a, b));
+      if (e > k->max_err)
+	k->max_err = e;
+      sum_sq += e * e;
+      k->samples++;
+    }
+  }
+  k->rms_err = sqrt(sum_sq / k->samples);
+}
+
+static int
+write_json(const char *file)
+{
+  FILE *f = fopen(file, "w");
+  unsigned i;
+
+  if (f == NULL) {
+    perror(file);
+    return 0;
+  }
+
+  fprintf(f, "{\n  \"kernels\": [\n");
+  for (i = 0; i < NUM_KERNELS; i++) {
+    kernel_t *k = &kernels[i];
+
+    fprintf(f, "    { \"name\": \"%s\", \"ns_per_op\": %.4f, "
+	    "\"mops_per_sec\": %.2f, \"max_err\": %.6g, \"rms_err\": %.6g, "
+	    "\"max_err_limit\": %g, \"err_units\": \"%s\", "
+	    "\"samples\": %lld, \"pass\": %s }%s\n",
+	    k->name, k->ns_per_op, 1e3 / k->ns_per_op, k->max_err,
+	    k->rms_err, k->max_err_limit, k->units, k->samples,
+	    k->max_err <= k->max_err_limit ? "true" : "false",
+	    i + 1 < NUM_KERNELS ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+
+  return fclose(f) == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *json = NULL;
+  unsigned i;
+  int ok = 1;
+
+  if (argc == 3 && strcmp(argv[1], "-j") == 0)
+    json = argv[2];
+  else if (argc != 1) {
+    fprintf(stderr, "usage: %s [-j file]\n", argv[0]);
+    return 2;
+  }
+
+  printf ("%-16s %10s %10s %12s %12s\n",
+	  "kernel", "ns/op", "Mops/s", "max err", "rms err");
+  for (i = 0; i < NUM_KERNELS; i++) {
+    kernel_t *k = &kernels[i];
+
+    bench_kernel(k);
+    printf ("%-16s %10.3f %10.2f %8.4f %-3s %8.4f %-3s%s\n",
+	    k->name, k->ns_per_op, 1e3 / k->ns_per_op, k->max_err, k->units,
+	    k->rms_err, k->units,
+	    k->max_err > k->max_err_limit ? "  OVER LIMIT" : "");
+    if (k->max_err > k->max_err_limit)
+      ok = 0;
+  }
+
+  if (json != NULL && !write_json(json))
+    ok = 0;
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
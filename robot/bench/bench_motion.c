@@ -0,0 +1,240 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Runs moves through motor.c's motion control a tick at a time, the
+ * way the motor task does (but without the motors), and checks where
+ * they stop: trapezoids and S-curves, long moves that get up to speed
+ * and short ones that never do, forwards and backwards, and a path of
+ * two segments that runs straight from one into the other.  A move
+ * should stop within a tick's travel at its top speed (and a step of
+ * rounding) of where it was sent.  Also prints how big the steps in
+ * acceleration were.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+/* The motion control is static in motor.c, so build it in here. */
+#include "../motor.c"
+
+typedef struct move
+{
+  int32 s;
+  mot_accel_t a;
+  mot_velocity_t v;
+  int jerk;
+  int segs;			/* 0: mot_move_jerk(); 1: two segments */
+} move_t;
+
+static const move_t moves[] = {
+  /* Long moves, up to speed. */
+  { 2000, 1, 256, 0, 0 },
+  { 2000, 1, 256, 50, 0 },
+  { 2000, 1, 256, 127, 0 },
+  { 2000, 2, 384, 127, 0 },
+  { 5000, 4, 768, 127, 0 },
+  { 2000, 1, -256, 60, 0 },
+  { 2000, 16, 5*256, 30, 0 },
+  { 20000, 32, 8*256, 10, 0 },
+  { 4000, 2, 512, 0, 1 },
+  { 4000, 2, 512, 80, 1 },
+  /* Short moves, where the ramps meet before 'a' or 'v'. */
+  { 300, 1, 256, 0, 0 },
+  { 300, 1, 256, 100, 0 },
+  { 50, 1, 256, 100, 0 },
+  { 100, 2, 512, 90, 0 },
+  { 800, 1, 256, 127, 0 },
+  { 1000, 3, 700, 37, 0 },
+  { 20, 1, 256, 127, 0 },
+  { 150, 4, 1024, 64, 0 },
+  { 500, 8, 2048, 20, 0 },
+  { 200, 1, -256, 127, 0 },
+};
+
+#define NUM_MOVES	(sizeof(moves) / sizeof(moves[0]))
+
+/* Stand-ins for the hardware, the other tasks and RTEMS. */
+static volatile unsigned char port_regs[3];
+volatile unsigned char *PEPAR = &port_regs[0];
+volatile unsigned char *DDRE = &port_regs[1];
+volatile unsigned char *PORTE0 = &port_regs[2];
+
+unsigned short read_tpu_fqd0(void) { return 0; }
+unsigned short read_tpu_fqd1(void) { return 0; }
+void set_tpu_pwm0(int pwm) { }
+void set_tpu_pwm1(int pwm) { }
+void init_tpu_fqd(void) { }
+void init_tpu_pwm(void) { }
+int kalman_read(void) { return 0; }
+void control_mark_output(void) { }
+
+int
+control_register(control_stage_t stage, const char *name, control_step_fn fn)
+{
+  return 0;
+}
+
+rtems_status_code
+rtems_semaphore_create(rtems_name name, unsigned int count,
+		       rtems_attribute attribute_set, int priority_ceiling,
+		       rtems_id *id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_semaphore_obtain(rtems_id id, rtems_option option_set,
+		       rtems_interval timeout)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_semaphore_release(rtems_id id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+/* The command ring is full: let the "motor task" catch up. */
+rtems_status_code
+rtems_task_wake_after(rtems_interval ticks)
+{
+  mot_drain_cmds();
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_mode(rtems_mode mode_set, rtems_mode mask,
+		rtems_mode *previous_mode_set)
+{
+  *previous_mode_set = 0;
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_create(rtems_name name, int priority, int stack_size, int modes,
+		  int attributes, rtems_id *id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_start(rtems_id id, rtems_task (*entry)(rtems_task_argument),
+		 rtems_task_argument arg)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_rate_monotonic_create(rtems_name name, rtems_id *id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_rate_monotonic_period(rtems_id id, rtems_interval length)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_clock_get(int option, void *time_buffer)
+{
+  *(rtems_interval *)time_buffer = mot_ticks;
+  return RTEMS_SUCCESSFUL;
+}
+
+/* Run one move from a standstill at position 0, and check where it
+   stops. */
+static int
+run_move(const move_t *m)
+{
+  int32 target, err, peak = 0, prev_v = 0, prev_a = 0, v, acc;
+  int32 max_a = 0, max_da = 0, tol;
+  int t;
+
+  mot_desired_pos = 0;
+  mot_desired_pos_frac = 0;
+  mot_v = mot_v_frac = mot_cur_a = 0;
+  mot_desired_v = 0;
+  mot_stop_at_valid = 0;
+
+  if (m->segs) {
+    mot_seg_move(m->s / 2, m->a, m->v, m->jerk, 0);
+    mot_seg_move(m->s / 2, m->a, m->v / 2, m->jerk, 0);
+  } else
+    mot_move_jerk(m->s, m->a, m->v, m->jerk, mot_ticks + 1);
+
+  for (t = 0; t < 100000; t++) {
+    mot_drain_cmds();
+    mot_check_stopped();
+    mot_do_motion();
+    mot_ticks++;
+    mot_publish_status();
+
+    v = mot_v * 256 + mot_v_frac;
+    acc = v - prev_v;
+    if (abs(v) > peak)
+      peak = abs(v);
+    if (abs(acc) > max_a)
+      max_a = abs(acc);
+    if (abs(acc - prev_a) > max_da)
+      max_da = abs(acc - prev_a);
+    prev_v = v;
+    prev_a = acc;
+
+    if (t > 2 && v == 0 && mot_stop_at_valid == 0 && mot_seg_cnt == 0)
+      break;
+  }
+
+  target = (m->v < 0) ? -m->s : m->s;
+  err = (int32)mot_desired_pos - target;
+  tol = (peak + 65535) / 65536 + 1;
+
+  printf ("%6d %3d %5d %4d %4s %6d %6d %+4d %3d %6d %6d  %s\n",
+	  m->s, m->a, m->v, m->jerk, m->segs ? "segs" : "move", t,
+	  (int32)mot_desired_pos, err, tol, max_a, max_da,
+	  abs(err) <= tol ? "ok" : "FAILED");
+
+  return abs(err) <= tol;
+}
+
+int
+main(int argc, char *argv[])
+{
+  unsigned i;
+  int ok = 1;
+
+  mot_bal_on = 1;
+
+  printf ("%6s %3s %5s %4s %4s %6s %6s %4s %3s %6s %6s\n", "steps", "a",
+	  "v", "jerk", "", "ticks", "end", "err", "tol", "max a", "max da");
+  for (i = 0; i < NUM_MOVES; i++)
+    ok &= run_move(&moves[i]);
+
+  printf ("(a, v, max a and max da in 1/256, 1/256 and 1/65536 steps per "
+	  "tick)\n");
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
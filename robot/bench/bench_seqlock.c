@@ -0,0 +1,190 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Stress test for seqlock.h.  One thread keeps rewriting a
+ * mot_status_t, the way mot_step() does, while the rest read it as
+ * fast as they can, the way mot_get_status() does, and check that
+ * every copy they got came from a single write.  Then does the same
+ * again with the lock left out, to show the test can see torn reads.
+ *
+ * The robot only has one CPU, and only needs the compiler kept in
+ * order; this is built with SEQLOCK_BARRIER() as a real memory
+ * barrier so it holds up on a multi-core host too.
+ *
+ * usage: bench_seqlock [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <bsp.h>
+#include "motor.h"
+#include "seqlock.h"
+
+#define MAX_READERS	16
+
+static mot_status_t shared;
+static seqlock_t shared_lock = SEQLOCK_INIT;
+
+static volatile int stop;
+static int use_lock;
+
+typedef struct reader
+{
+  pthread_t thread;
+  unsigned long reads;
+  unsigned long retries;
+  unsigned long torn;
+} reader_t;
+
+/* Every field is worked out from the write count, so a reader can
+   tell whether they all came from the same write. */
+static void
+fill(mot_status_t *m, uint32 n)
+{
+  m->pos = n;
+  m->velocity = n * 3;
+  m->accel = n * 5;
+  m->tick = n;
+  m->stopped = n & 1;
+  m->heading_stopped = (n >> 1) & 1;
+  m->emergency = (n >> 2) & 1;
+}
+
+static int
+consistent(const mot_status_t *m)
+{
+  mot_status_t want;
+
+  fill(&want, m->tick);
+  return m->pos == want.pos && m->velocity == want.velocity &&
+    m->accel == want.accel && m->stopped == want.stopped &&
+    m->heading_stopped == want.heading_stopped &&
+    m->emergency == want.emergency;
+}
+
+static void *
+writer_main(void *arg)
+{
+  volatile mot_status_t *v = &shared;
+  uint32 n = 0;
+
+  while (!stop) {
+    n++;
+    if (use_lock)
+      seqlock_write_begin(&shared_lock);
+    /* One field at a time, like mot_publish_status(). */
+    v->pos = n;
+    v->velocity = n * 3;
+    v->accel = n * 5;
+    v->tick = n;
+    v->stopped = n & 1;
+    v->heading_stopped = (n >> 1) & 1;
+    v->emergency = (n >> 2) & 1;
+    if (use_lock)
+      seqlock_write_end(&shared_lock);
+  }
+  return NULL;
+}
+
+static void *
+reader_main(void *arg)
+{
+  reader_t *r = arg;
+  mot_status_t copy;
+  unsigned int seq;
+  int tries;
+
+  while (!stop) {
+    if (use_lock) {
+      tries = 0;
+      do {
+	if (tries++)
+	  r->retries++;
+	seq = seqlock_read_begin(&shared_lock);
+	copy = *(volatile mot_status_t *)&shared;
+      } while (seqlock_read_retry(&shared_lock, seq));
+    } else
+      copy = *(volatile mot_status_t *)&shared;
+
+    r->reads++;
+    if (!consistent(&copy))
+      r->torn++;
+  }
+  return NULL;
+}
+
+/* Runs one writer and 'n' readers for 'secs' seconds.  Returns the
+   number of torn reads. */
+static unsigned long
+run(int lock, int n, int secs)
+{
+  reader_t readers[MAX_READERS];
+  pthread_t writer;
+  unsigned long reads = 0, retries = 0, torn = 0;
+  int i;
+
+  use_lock = lock;
+  stop = 0;
+  fill(&shared, 0);
+  seqlock_init(&shared_lock);
+
+  pthread_create(&writer, NULL, writer_main, NULL);
+  for (i = 0; i < n; i++) {
+    readers[i].reads = readers[i].retries = readers[i].torn = 0;
+    pthread_create(&readers[i].thread, NULL, reader_main, &readers[i]);
+  }
+  sleep(secs);
+  stop = 1;
+  pthread_join(writer, NULL);
+  for (i = 0; i < n; i++) {
+    pthread_join(readers[i].thread, NULL);
+    reads += readers[i].reads;
+    retries += readers[i].retries;
+    torn += readers[i].torn;
+  }
+
+  printf ("%-10s %d readers: %10lu reads, %9lu retries, %lu torn\n",
+	  lock ? "seqlock" : "no lock", n, reads, retries, torn);
+  return torn;
+}
+
+int
+main(int argc, char **argv)
+{
+  int secs = argc > 1 ? atoi(argv[1]) : 2;
+  int n = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  unsigned long torn;
+
+  if (n < 2)
+    n = 2;
+  if (n > MAX_READERS)
+    n = MAX_READERS;
+
+  torn = run(1, n, secs);
+  run(0, n, secs);
+
+  printf ("%s\n", torn == 0 ? "PASS" : "FAIL");
+  return torn == 0 ? 0 : 1;
+}
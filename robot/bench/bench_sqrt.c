@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+/*
+ * Checks sqrti() against every 32 bit input, and sqrti64() against
+ * a spread of 64 bit ones, and times both against the Newton's method
+ * sqrti() they replaced.  The exhaustive check takes a while.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "fastint.h"
+
+#define NUM_INPUTS	4096
+#define TIMING_REPS	1000
+#define CHECKS_64	20000000
+
+/* The old sqrti(), unchanged. */
+static unsigned
+old_sqrti(unsigned long x)
+{
+  unsigned long rt;
+  long i;
+
+  if (x==0)
+    return 0;
+  if (x<4)
+    return 1;
+
+  for(i=2;(x>>i)>0;i+=2)  // find top bit
+    continue;
+
+  rt = x>>(i>>1);
+  if (rt == 0xFFFF)
+    return (unsigned)rt;
+
+  while (x >= rt*rt+(rt<<1)+1)
+   {
+     i = (x/rt-rt)>>1;
+     rt += i;
+     while(x<=rt*rt-(rt<<1)+1)
+      {
+	i = (rt-x/rt)>>1;
+        rt -= i;
+      }
+   }
+
+  if (rt*rt < x)
+    {
+      if ((x - rt*rt) > (rt*rt + (rt<<1) + 1 - x))
+	rt++;
+    }
+  else
+    {
+      if
+	((rt*rt - x) > (x - (rt*rt - (rt<<1) + 1)))
+	rt--;
+    }
+
+  return (unsigned)rt;
+}
+
+static unsigned long long ins[NUM_INPUTS];
+
+/* Random values of up to 'bits' bits, with a random magnitude. */
+static unsigned long long
+rand_mag(int bits)
+{
+  unsigned long long v = ((unsigned long long)bench_rand() << 32) | bench_rand();
+
+  return v >> (64 - bits + bench_rand() % bits);
+}
+
+#define TIMER(_name, _call)						\
+  static double								\
+  time_##_name(void)							\
+  {									\
+    double t0 = bench_now_ns();						\
+    unsigned long sum = 0;						\
+    int r, i;								\
+    for (r = 0; r < TIMING_REPS; r++)					\
+      for (i = 0; i < NUM_INPUTS; i++) {				\
+	unsigned long long x = ins[i];					\
+	sum += (_call);							\
+      }									\
+    bench_sink += sum;							\
+    return (bench_now_ns() - t0) / ((double)TIMING_REPS * NUM_INPUTS);	\
+  }
+
+TIMER(old_sqrti, old_sqrti(x))
+TIMER(sqrti, sqrti(x))
+TIMER(sqrti64, sqrti64(x))
+
+/* r is sqrt(x) rounded to the nearest integer exactly when
+   r^2 - r < x <= r^2 + r. */
+static int
+rounded_root(unsigned __int128 x, unsigned __int128 r)
+{
+  return r * r - r < x + (r == 0) && x <= r * r + r;
+}
+
+static int
+check_sqrti(void)
+{
+  unsigned long long x;
+  long bad = 0;
+
+  for (x = 0; x <= 0xffffffffULL; x++) {
+    if (!rounded_root(x, sqrti(x))) {
+      if (bad++ < 10)
+	printf ("  sqrti(%llu) = %u\n", x, sqrti(x));
+    }
+  }
+  printf ("sqrti: every 32 bit input %s\n", bad ? "FAILED" : "ok");
+  return bad == 0;
+}
+
+static int
+check_sqrti64(void)
+{
+  static const unsigned long long edges[] = {
+    0, 1, 2, 3, 0xffffffffULL, 0x100000000ULL, 0xfffffffe00000001ULL,
+    0xfffffffe00000002ULL, 0xffffffff00000000ULL, 0xffffffffffffffffULL,
+  };
+  unsigned long long x;
+  long i, bad = 0;
+
+  for (i = 0; i < CHECKS_64 + (long)(sizeof(edges) / sizeof(edges[0])); i++) {
+    unsigned long r;
+
+    x = i < CHECKS_64 ? rand_mag(64) : edges[i - CHECKS_64];
+    r = sqrti64(x);
+    /* The one answer that doesn't fit gets saturated. */
+    if (!rounded_root(x, r) &&
+	!(r == 0xffffffffUL && rounded_root(x, 0x100000000ULL))) {
+      if (bad++ < 10)
+	printf ("  sqrti64(%llu) = %lu\n", x, r);
+    }
+    if (x <= 0xffffffffULL && r != sqrti(x))
+      bad++;
+  }
+  printf ("sqrti64: %d random and edge inputs %s\n", CHECKS_64,
+	  bad ? "FAILED" : "ok");
+  return bad == 0;
+}
+
+int
+main(int argc, char **argv)
+{
+  static const int bits[] = { 8, 16, 24, 32 };
+  unsigned i, j;
+  int ok = 1;
+
+  printf ("ns/op for inputs up to:");
+  for (j = 0; j < sizeof(bits) / sizeof(bits[0]); j++)
+    printf ("  %2d bits", bits[j]);
+  printf ("\n");
+
+  for (i = 0; i < 3; i++) {
+    static const char *names[] = { "old sqrti", "sqrti", "sqrti64" };
+
+    printf ("%-23s", names[i]);
+    for (j = 0; j < sizeof(bits) / sizeof(bits[0]); j++) {
+      unsigned k;
+
+      for (k = 0; k < NUM_INPUTS; k++)
+	ins[k] = rand_mag(bits[j]);
+      printf (" %8.2f", i == 0 ? time_old_sqrti() :
+	      i == 1 ? time_sqrti() : time_sqrti64());
+    }
+    printf ("\n");
+  }
+
+  ok &= check_sqrti64();
+  ok &= check_sqrti();
+
+  printf ("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Stand-in for the RTEMS <bsp.h>, so robot sources that only need it
+ * for the trace macros can be built on the host.
+ */
+
+#ifndef _BENCH_BSP_H
+#define _BENCH_BSP_H
+
+#include <unistd.h>
+
+/* Just enough of the RTEMS API for kalman.c's and motor.c's task code
+   to compile.  The benchmarks only call the filters and the motion
+   control, never the tasks. */
+typedef unsigned int rtems_interval;
+typedef unsigned int rtems_name;
+typedef unsigned int rtems_id;
+typedef unsigned int Objects_Id;
+typedef unsigned int rtems_task_argument;
+typedef int rtems_status_code;
+typedef void rtems_task;
+typedef unsigned int rtems_mode;
+typedef unsigned int rtems_interrupt_level;
+typedef unsigned int rtems_attribute;
+typedef unsigned int rtems_option;
+
+#define RTEMS_SUCCESSFUL		0
+#define RTEMS_TIMEOUT			6
+#define RTEMS_MINIMUM_STACK_SIZE	4096
+#define RTEMS_DEFAULT_MODES		0
+#define RTEMS_DEFAULT_ATTRIBUTES	0
+#define RTEMS_CLOCK_GET_TICKS_SINCE_BOOT	2
+#define RTEMS_NO_PREEMPT		0x00000100
+#define RTEMS_PREEMPT_MASK		0x00000100
+#define RTEMS_WAIT			0
+#define RTEMS_NO_TIMEOUT		0
+#define RTEMS_LOCAL			0
+#define RTEMS_PRIORITY			0x00000004
+#define RTEMS_BINARY_SEMAPHORE		0x00000010
+#define RTEMS_INHERIT_PRIORITY		0x00000040
+#define RTEMS_NO_PRIORITY_CEILING	0
+
+#define SYS_CLOCK			16777216
+
+#define rtems_build_name(a,b,c,d)	(((a) << 24) | ((b) << 16) | ((c) << 8) | (d))
+
+rtems_status_code rtems_rate_monotonic_create(rtems_name name, rtems_id *id);
+rtems_status_code rtems_rate_monotonic_period(rtems_id id,
+					      rtems_interval length);
+rtems_status_code rtems_task_create(rtems_name name, int priority,
+				    int stack_size, int modes, int attributes,
+				    rtems_id *id);
+rtems_status_code rtems_clock_get(int option, void *time_buffer);
+rtems_status_code rtems_semaphore_create(rtems_name name, unsigned int count,
+					 rtems_attribute attribute_set,
+					 int priority_ceiling, rtems_id *id);
+rtems_status_code rtems_semaphore_obtain(rtems_id id, rtems_option option_set,
+					 rtems_interval timeout);
+rtems_status_code rtems_semaphore_release(rtems_id id);
+rtems_status_code rtems_task_wake_after(rtems_interval ticks);
+rtems_status_code rtems_task_mode(rtems_mode mode_set, rtems_mode mask,
+				  rtems_mode *previous_mode_set);
+rtems_status_code rtems_task_start(rtems_id id,
+				   rtems_task (*entry)(rtems_task_argument),
+				   rtems_task_argument arg);
+
+#endif /* _BENCH_BSP_H */
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Host versions of the few robot functions the math code calls.
+ */
+
+#include <bsp.h>
+#include "motor.h"
+#include "gyro.h"
+#include "accel.h"
+#include "control.h"
+
+/* Timestamps trace entries. */
+uint32
+mot_get_ticks(void)
+{
+  return 0;
+}
+
+/* kalman.c's task reads these; bench_kalman feeds the filters directly
+   instead. */
+int
+gyro_read(int gyro)
+{
+  return 0;
+}
+
+int
+accel_read(void)
+{
+  return 0;
+}
+
+rtems_status_code
+rtems_rate_monotonic_create(rtems_name name, rtems_id *id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_rate_monotonic_period(rtems_id id, rtems_interval length)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_clock_get(int option, void *time_buffer)
+{
+  *(rtems_interval *)time_buffer = 0;
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_create(rtems_name name, int priority, int stack_size, int modes,
+		  int attributes, rtems_id *id)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_start(rtems_id id, rtems_task (*entry)(rtems_task_argument),
+		 rtems_task_argument arg)
+{
+  return RTEMS_SUCCESSFUL;
+}
+
+rtems_status_code
+rtems_task_mode(rtems_mode mode_set, rtems_mode mask,
+		rtems_mode *previous_mode_set)
+{
+  *previous_mode_set = 0;
+  return RTEMS_SUCCESSFUL;
+}
+
+int
+control_register(control_stage_t stage, const char *name, control_step_fn fn)
+{
+  return 0;
+}
+
+void
+control_mark_estimate(void)
+{
+}
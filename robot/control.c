@@ -0,0 +1,444 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Control chain
+ *
+ * One rate monotonic task runs every registered step, in stage order,
+ * at the start of each period; or with CONTROL_TIMER_ISR, a TPU
+ * channel interrupt starts each period.  See control.h.
+ */
+
+#include <bsp.h>
+#include <stdio.h>
+#include "global.h"
+#include "control.h"
+#include "prof.h"
+#ifdef CONTROL_TIMER_ISR
+#ifdef CONTROL_SEPARATE_TASKS
+#error CONTROL_TIMER_ISR needs the control chain, not CONTROL_SEPARATE_TASKS
+#endif
+#if CONTROL_TPU_CHAN < 12 || CONTROL_TPU_CHAN > 15
+#error control_timer_init() only knows TPU channels 12 to 15
+#endif
+#include "mrm332.h"
+#include "tpu.h"
+#include "servo.h"
+#endif
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef struct control_step
+{
+  control_stage_t stage;
+  const char *name;
+  control_step_fn fn;
+} control_step_t;
+
+/**********************************************************************/
+/* Globals */
+/**********************************************************************/
+
+#ifndef CONTROL_SEPARATE_TASKS
+static const char *control_stage_names[CONTROL_NUM_STAGES] = {
+  "sense", "estimate", "act", "deferred"
+};
+#endif
+
+static control_step_t control_steps[CONTROL_MAX_STEPS];
+static int control_num_steps = 0;
+static int control_started = 0;
+
+int control_timeouts = 0;
+
+/* Clock tick the latest sample was taken at, and the tick of the
+   sample the latest estimate was made from. */
+static volatile rtems_interval control_sample_tick;
+static volatile rtems_interval control_estimate_tick;
+
+/* Sample to output latencies, in clock ticks. */
+static volatile unsigned int control_lat_hist[CONTROL_LAT_BUCKETS];
+static volatile unsigned int control_lat_cnt;
+static volatile unsigned int control_lat_sum;
+static volatile unsigned int control_lat_max;
+
+/* Clock tick the latest period started at, how many clock ticks late
+   each period started, and how many read a tick or more short. */
+static volatile rtems_interval control_period_tick;
+static volatile int control_period_started = 0;
+static volatile unsigned int control_missed_hist[CONTROL_MISSED_BUCKETS];
+static volatile unsigned int control_period_cnt;
+static volatile unsigned int control_period_short;
+
+#ifdef CONTROL_TIMER_ISR
+/* The task the interrupt wakes, and whether it is still running the
+   last period's sense and deferred steps. */
+static rtems_id control_task_id;
+static volatile int control_task_busy = 0;
+#endif
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static inline rtems_interval
+control_now(void)
+{
+  rtems_interval now;
+
+  rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &now);
+  return now;
+}
+
+/* Add a step to the chain, after any others in the same stage. */
+int
+control_register(control_stage_t stage, const char *name, control_step_fn fn)
+{
+  int i;
+
+  if (control_started || control_num_steps >= CONTROL_MAX_STEPS ||
+      stage < 0 || stage >= CONTROL_NUM_STAGES)
+    {
+      printf ("control_register: can't add step '%s'\n", name);
+      return -1;
+    }
+
+  for (i = control_num_steps; i > 0 && control_steps[i-1].stage > stage; i--)
+    control_steps[i] = control_steps[i-1];
+  control_steps[i].stage = stage;
+  control_steps[i].name = name;
+  control_steps[i].fn = fn;
+  control_num_steps++;
+
+  return 0;
+}
+
+/* Note the start of a period, and how many clock ticks late it is. */
+static void
+control_mark_period(void)
+{
+  rtems_interval now = control_now();
+  unsigned int len = now - control_period_tick;
+  unsigned int period = ticks_per_sec / CONTROL_HZ;
+  unsigned int missed;
+
+  control_period_tick = now;
+  if (!control_period_started)
+    {
+      control_period_started = 1;
+      return;
+    }
+
+  control_period_cnt++;
+  if (len < period)
+    {
+      control_period_short++;
+      return;
+    }
+  missed = len - period;
+  control_missed_hist[missed < CONTROL_MISSED_BUCKETS ?
+		      missed : CONTROL_MISSED_BUCKETS-1]++;
+}
+
+/* Run the steps in stages 'first' through 'last'. */
+static void
+control_run(control_stage_t first, control_stage_t last)
+{
+  int i;
+
+  for (i = 0; i < control_num_steps; i++)
+    if (control_steps[i].stage >= first && control_steps[i].stage <= last)
+      control_steps[i].fn();
+}
+
+#ifdef CONTROL_TIMER_ISR
+/* Start of a period: act on the latest sample, then wake the task to
+   take the next one. */
+static rtems_isr
+control_isr(rtems_vector_number vector)
+{
+  struct tpu_Def *Tpu = (struct tpu_Def *)TPU_BASE;
+  PROF_DECL(t);
+
+  /* Clear interrupt pending bit. */
+  Tpu->CISR &= ~(1 << CONTROL_TPU_CHAN);
+
+  PROF_START(t);
+  control_mark_period();
+
+  /* The task didn't finish with the last period in time, so this one
+     runs on an old sample. */
+  if (control_task_busy)
+    control_timeouts++;
+
+  control_run(CONTROL_ESTIMATE, CONTROL_ACT);
+  PROF_SINCE(PROF_CONTROL, t);
+  rtems_event_send(control_task_id, RTEMS_EVENT_0);
+}
+
+/* Program CONTROL_TPU_CHAN to interrupt every period: QOM in
+   continuous mode with a single offset of one period, so every match
+   is the end of its table.  The offset is 15 bits of TCR1 counts, so
+   this is good down to about 128 Hz. */
+static void
+control_timer_init(void)
+{
+  struct tpu_Def *Tpu;
+  struct tpu_qom_ram *Tpu_pram;
+  int ch = CONTROL_TPU_CHAN;
+  int vector;
+  rtems_isr_entry old_vector;
+  int period; /* TCR1 counts per period. */
+
+  period = SYS_CLOCK / 4 / CONTROL_HZ; /* Assumes TCR1 runs in
+					  divide-by-4 mode. */
+
+  Tpu = (struct tpu_Def *)TPU_BASE;
+  Tpu_pram = (struct tpu_qom_ram *)(TPU_RAM + (ch << 4));
+
+  /* Disable interrupts from this channel, and clear any outstanding
+     one. */
+  Tpu->CIER &= ~(1 << ch);
+  Tpu->CISR &= ~(1 << ch);
+
+  /* Set up to catch the interrupt. */
+  vector = (Tpu->TICR & 0x00F0) | ch;
+  rtems_interrupt_catch (control_isr, vector, &old_vector);
+
+  while((short int)0x0000 != (short int)(Tpu->HSRR0))
+    {
+    }
+
+  /* step one: disable the channel by clearing the two channel priority
+     bits */
+  Tpu->CPR0 &= (short int) ~(0x3 << ((ch - 8) * 2));
+
+  /* Enable interrupts from this channel. */
+  Tpu->CIER |= (1 << ch);
+
+  /* step two: select the QOM function. */
+  Tpu->CFSR0 &= (short int) ~(0xF << ((ch - 12) * 4));
+  Tpu->CFSR0 |= (short int) (QOM_FUNCT << ((ch - 12) * 4));
+
+  /* step three: initialize parameter ram - one offset, pin kept
+     low. */
+  Tpu_pram->ref_addr_b = 0;
+  Tpu_pram->last_off_addr_a = (ch << 4) | 0x4; /* 0x4 is ptr to
+						  offset_1 */
+  Tpu_pram->off_ptr_c = 0;
+  Tpu_pram->offset_1 = period << 1 | 0;
+
+  /* step four: set to continuous mode via HSQ bits. */
+  Tpu->HSQR0 &= (short int) ~(0x3 << ((ch - 8) * 2));
+  Tpu->HSQR0 |= (short int) (QOM_HSQ_CONTINUOUS << ((ch - 8) * 2));
+
+  /* step five: Issue an HSR to the channel to initialize the pin
+     low. */
+  Tpu->HSRR0 &= (short int) ~(0x3 << ((ch - 8) * 2));
+  Tpu->HSRR0 |= (short int) (QOM_HSR_INIT_PINLOW << ((ch - 8) * 2));
+
+  /* step six: Enable servicing at high priority. */
+  Tpu->CPR0 |= (short int) (0x3 << ((ch - 8) * 2));
+
+  while((short int)0x0000 !=
+	(short int)(Tpu->HSRR0 & (short int)(0x3 << ((ch - 8) * 2))))
+    {
+      /* pause here and do nothing until after the tpu function is
+	 serviced. */
+    }
+}
+
+/* Runs the sense and deferred steps each time the interrupt wakes
+   it. */
+rtems_task
+control_task(rtems_task_argument ignored)
+{
+  rtems_event_set events;
+
+  control_timer_init();
+
+  while (1)
+    {
+      control_task_busy = 0;
+      rtems_event_receive(RTEMS_EVENT_0, RTEMS_EVENT_ANY | RTEMS_WAIT,
+			  RTEMS_NO_TIMEOUT, &events);
+      control_task_busy = 1;
+
+      control_run(CONTROL_SENSE, CONTROL_SENSE);
+      control_run(CONTROL_DEFERRED, CONTROL_DEFERRED);
+    }
+}
+#else
+/* Runs the chain. */
+rtems_task
+control_task(rtems_task_argument ignored)
+{
+  rtems_name period_name;
+  rtems_id period;
+  rtems_status_code status;
+  PROF_DECL(t);
+
+  period_name = rtems_build_name ('C', 'T', 'P', 'D');
+  status = rtems_rate_monotonic_create (period_name, &period);
+  if (status != RTEMS_SUCCESSFUL)
+    {
+      printf ("control_task: rate_monotonic_create failed with status %d\n",
+	      status);
+      return;
+    }
+
+  while (1)
+    {
+      if (rtems_rate_monotonic_period (period, ticks_per_sec/CONTROL_HZ) ==
+	  RTEMS_TIMEOUT)
+	{
+	  /* I'd like to do a printf here, but that would make us miss
+	     our next timeout, until the end of time... */
+	  control_timeouts++;
+	}
+      control_mark_period();
+      PROF_START(t);
+
+      control_run(CONTROL_SENSE, CONTROL_DEFERRED);
+      PROF_SINCE(PROF_CONTROL, t);
+    }
+}
+#endif
+
+/* Spawn the task that runs the chain. */
+void
+control_start(void)
+{
+#ifndef CONTROL_SEPARATE_TASKS
+  rtems_status_code code;
+  Objects_Id t1;
+
+  control_started = 1;
+
+  /* Same priority the motor task used to have. */
+  printf ("Spawning control chain task:\n");
+  code = rtems_task_create(rtems_build_name('C', 'T', 'R', 'L'),
+			   5, RTEMS_MINIMUM_STACK_SIZE * 2,
+			   RTEMS_DEFAULT_MODES,
+			   RTEMS_DEFAULT_ATTRIBUTES,
+			   &t1);
+  printf ("  rtems_task_create returned %d; t1 = 0x%08x\n", code, t1);
+#ifdef CONTROL_TIMER_ISR
+  control_task_id = t1;
+#endif
+  code = rtems_task_start(t1, control_task, 0);
+  printf ("Done. (rtems_task_start returned %d)\n\n", code);
+#endif
+}
+
+void
+control_mark_sample(void)
+{
+  control_sample_tick = control_now();
+}
+
+void
+control_mark_estimate(void)
+{
+  control_estimate_tick = control_sample_tick;
+}
+
+void
+control_mark_output(void)
+{
+  unsigned int lat = control_now() - control_estimate_tick;
+
+  control_lat_hist[lat < CONTROL_LAT_BUCKETS ? lat : CONTROL_LAT_BUCKETS-1]++;
+  control_lat_cnt++;
+  control_lat_sum += lat;
+  if (lat > control_lat_max)
+    control_lat_max = lat;
+}
+
+/* Print the steps, the sample to output latencies and the missed
+   ticks seen so far. */
+void
+control_report(int reset)
+{
+  int i;
+  unsigned int cnt = control_lat_cnt;
+  unsigned int us_per_tick = 1000000 / ticks_per_sec;
+
+#ifdef CONTROL_SEPARATE_TASKS
+  printf ("Separate gyro, kalman and motor tasks.\n");
+#elif defined(CONTROL_TIMER_ISR)
+  printf ("Control chain at %d Hz from TPU channel %d, %d late periods:\n",
+	  CONTROL_HZ, CONTROL_TPU_CHAN, control_timeouts);
+  for (i = 0; i < control_num_steps; i++)
+    printf ("  %d: %-8s %s (%s)\n", i,
+	    control_stage_names[control_steps[i].stage],
+	    control_steps[i].name,
+	    (control_steps[i].stage == CONTROL_ESTIMATE ||
+	     control_steps[i].stage == CONTROL_ACT) ? "interrupt" : "task");
+#else
+  printf ("Control chain at %d Hz, %d period overruns:\n", CONTROL_HZ,
+	  control_timeouts);
+  for (i = 0; i < control_num_steps; i++)
+    printf ("  %d: %-8s %s\n", i, control_stage_names[control_steps[i].stage],
+	    control_steps[i].name);
+#endif
+
+  printf ("Sample to output latency (%u us clock ticks), %u outputs:\n",
+	  us_per_tick, cnt);
+  if (cnt != 0)
+    printf ("  avg %u us, max %u us\n",
+	    (unsigned int)((unsigned long long)control_lat_sum * us_per_tick
+			   / cnt),
+	    control_lat_max * us_per_tick);
+  for (i = 0; i < CONTROL_LAT_BUCKETS; i++)
+    if (control_lat_hist[i] != 0)
+      printf ("  %s%d ticks: %u\n", i == CONTROL_LAT_BUCKETS-1 ? ">=" : "",
+	      i, control_lat_hist[i]);
+
+#ifndef CONTROL_SEPARATE_TASKS
+  {
+    unsigned int pcnt = control_period_cnt;
+
+    /* Only whole clock ticks can be seen, so this is missed ticks, not
+       jitter; see CONTROL_MISSED_BUCKETS. */
+    printf ("Missed clock ticks per %d tick period, %u periods:\n",
+	    ticks_per_sec / CONTROL_HZ, pcnt);
+    for (i = 0; i < CONTROL_MISSED_BUCKETS; i++)
+      if (control_missed_hist[i] != 0)
+	printf ("  %s%d late: %u\n", i == CONTROL_MISSED_BUCKETS-1 ? ">=" : "",
+		i, control_missed_hist[i]);
+    if (control_period_short != 0)
+      printf ("  short: %u\n", control_period_short);
+  }
+#endif
+
+  if (reset)
+    {
+      for (i = 0; i < CONTROL_LAT_BUCKETS; i++)
+	control_lat_hist[i] = 0;
+      control_lat_cnt = control_lat_sum = control_lat_max = 0;
+      for (i = 0; i < CONTROL_MISSED_BUCKETS; i++)
+	control_missed_hist[i] = 0;
+      control_period_cnt = control_period_short = 0;
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Control chain
+ *
+ * Runs the 250 Hz sense -> estimate -> act steps (gyro, kalman
+ * filter, motor control) one after the other from a single periodic
+ * task, so the motors always act on the gyro sample taken at the
+ * start of the same period.  Build with CONTROL_SEPARATE_TASKS to get
+ * the old separate gyro, kalman and motor tasks back.
+ *
+ * Build with CONTROL_TIMER_ISR to take the period from a TPU channel
+ * instead of the clock tick: its interrupt runs the estimate and act
+ * steps, then wakes the task to run the sense and deferred steps
+ * (the gyro's SPI reads sleep, so they can't be done in an ISR).  The
+ * motors then act on the sample taken one period earlier.
+ */
+
+#ifndef _CONTROL_H
+#define _CONTROL_H
+
+/**********************************************************************/
+/* Constants */
+/**********************************************************************/
+
+/* How often the chain runs.  Should match GYRO_HZ in gyro.c,
+   UPDATE_HZ in kalman.c and MOTOR_HZ in motor.c. */
+#define CONTROL_HZ		250
+
+/* Most steps that can be registered. */
+#define CONTROL_MAX_STEPS	8
+
+/* Latencies are kept in a histogram of this many clock ticks; longer
+   ones go in the last bucket. */
+#define CONTROL_LAT_BUCKETS	8
+
+/* How many clock ticks each period started late by is kept in a
+   histogram this long; more go in the last bucket.  The clock tick is
+   the finest time the CPU can read (the TPU's TCR1 can't be read
+   directly), so these are whole missed ticks, not jitter: without
+   CONTROL_TIMER_ISR the period is released on a tick and is always
+   exactly ticks_per_sec / CONTROL_HZ unless one is lost.  With
+   CONTROL_TIMER_ISR the TPU and the tick aren't in phase, so a period
+   can also read a tick short, with the next one a tick late. */
+#define CONTROL_MISSED_BUCKETS	4
+
+/* TPU channel that times the chain with CONTROL_TIMER_ISR. */
+#define CONTROL_TPU_CHAN	12
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+/* The stages of the chain, in the order they run each period. */
+typedef enum control_stage
+{
+  CONTROL_SENSE,		/* read the sensors */
+  CONTROL_ESTIMATE,		/* filter the readings */
+  CONTROL_ACT,			/* control loops, set the motors */
+  CONTROL_DEFERRED,		/* work that can wait, e.g. recording */
+  CONTROL_NUM_STAGES
+} control_stage_t;
+
+typedef void (*control_step_fn)(void);
+
+/* Keeps the chain from running while a task updates data the steps
+   use: with CONTROL_TIMER_ISR that means masking interrupts, otherwise
+   turning off preemption is enough.  Keep these sections short. */
+#ifdef CONTROL_TIMER_ISR
+typedef rtems_interrupt_level control_lock_t;
+#define control_lock(l)		rtems_interrupt_disable(l)
+#define control_unlock(l)	rtems_interrupt_enable(l)
+#else
+typedef rtems_mode control_lock_t;
+#define control_lock(l)		\
+	rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &(l))
+#define control_unlock(l)	\
+	do { \
+		rtems_mode _dummy; \
+		rtems_task_mode((l), RTEMS_PREEMPT_MASK, &_dummy); \
+	} while (0)
+#endif
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+/* Add a step to the chain.  Steps run in stage order, and in the
+   order they were registered within a stage.  Must be called before
+   control_start().  Returns 0 on success, non-zero on error. */
+int control_register(control_stage_t stage, const char *name,
+		     control_step_fn fn);
+
+/* Spawn the task that runs the chain.  Does nothing if built with
+   CONTROL_SEPARATE_TASKS. */
+void control_start(void);
+
+/* Latency tracking: the sense step calls control_mark_sample() when
+   it takes the gyro sample, the estimate step calls
+   control_mark_estimate() when it uses the latest sample, and the act
+   step calls control_mark_output() after setting the motors from the
+   latest estimate.  The time from sample to output is recorded. */
+void control_mark_sample(void);
+void control_mark_estimate(void);
+void control_mark_output(void);
+
+/* Print the steps, the sample to output latencies and the missed
+   ticks seen so far ('ctl' command).  If 'reset' is non-zero, clears
+   them. */
+void control_report(int reset);
+
+#endif /* _CONTROL_H */
@@ -204,8 +204,9 @@ do_heading_update(void)
 {
   int lf, lr, avgl;
   int rf, rr, avgr;
-  int al, ar;
-  int angle;
+  int have_l, have_r;
+  bam32 al = 0, ar = 0;
+  bam32 angle;
 
   if (!mot_balancing())
     return;
@@ -215,28 +216,26 @@ do_heading_update(void)
   rf = dist_tbl2[dist_raw[2]];
   rr = dist_tbl4[dist_raw[4]];
 
-  if ((lf > 0) && (lr > 0))
-    al = fixup_angle (fastatan2 (lf-lr, DIST_SENSOR_SEPARATION));
-  else
-    al = -1;
+  have_l = (lf > 0) && (lr > 0);
+  if (have_l)
+    al = bam32_from_24_8 (fastatan2_24_8 (lf-lr, DIST_SENSOR_SEPARATION));
 
-  if ((rf > 0) && (rr > 0))
-    ar = fixup_angle (fastatan2 (rr-rf, DIST_SENSOR_SEPARATION));
-  else
-    ar = -1;
+  have_r = (rf > 0) && (rr > 0);
+  if (have_r)
+    ar = bam32_from_24_8 (fastatan2_24_8 (rr-rf, DIST_SENSOR_SEPARATION));
 
-  if ((ar >= 0) && (al >= 0)) {
+  if (have_l && have_r) {
     /* We can see walls with all four sensors, so we have two possible
        headings.  If they are close (within 10 degrees of each other),
        then average them and call that the update.  Otherwise, pick
        the one where the wall is closest & use that.  This should
        avoid cases where we are going around a corner and see two
        different walls. */
-    if (abs_dir_diff (ar,al) <= 10) {
-      /* Note the funky calculation to average two angles.  This
-	 handles the case where one angle is just above 0 & the other
-	 is just below 360. */
-      angle = fixup_angle (leftmost_angle(al, ar) + (abs_dir_diff(ar,al) / 2));
+    if (bam32_abs_diff (ar, al) <= BAM32_DEG(10)) {
+      /* Half the signed difference, added to one of them, is the
+	 average - even when one angle is just above 0 & the other is
+	 just below 360. */
+      angle = al + (bam32)((int)(ar - al) / 2);
     } else {
       avgl = (lf+lr+1) / 2;
       avgr = (rf+rr+1) / 2;
@@ -245,24 +244,23 @@ do_heading_update(void)
       else
 	angle = ar;
     }
-  } else if (al >= 0) {
+  } else if (have_l) {
     /* We can only get a heading from the left side - use that. */
     angle = al;
-  } else if (ar >= 0) {
+  } else if (have_r) {
     /* We can only get a heading from the right side - use that. */
     angle = ar;
   } else {
     /* We can't get a heading update this time. */
-    angle = -1;
+    return;
   }
 
 #if 0
   /* This fills up the log quick and should probably be commented out. */
-  TRACE_LOG5 (ROBOT, HEADING_UPDATE, lf, lr, rf, rr, angle);
+  TRACE_LOG5 (ROBOT, HEADING_UPDATE, lf, lr, rf, rr, bam32_deg(angle));
 #endif
 
-  if (angle > 0)
-    mot_heading_update(angle);
+  mot_heading_update(angle);
 }
 
 /* The task that reads the sensors and updates the global
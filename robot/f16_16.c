@@ -27,33 +27,8 @@
 #include "f16_16.h"
 #include "robot_trace.h"
 
-f16_16
-mult_f16_16(f16_16 a, f16_16 b)
-{
-  int a_frac;
-  int a_int;
-  int b_frac;
-  int b_int;
-  int sign = 1;
-
-  if (a < 0) {
-    sign = -sign;
-    a = -a;
-  }
-  if (b < 0) {
-    sign = -sign;
-    b = -b;
-  }
-  a_frac = a & 0x0000ffff;
-  a_int  = (a & 0xffff0000) / 65536;
-  b_frac = b & 0x0000ffff;
-  b_int  = (b & 0xffff0000) / 65536;
-
-  return (((unsigned)(a_frac * b_frac) >> 16) +
-	  (a_frac * b_int) +
-	  (a_int * b_frac) +
-	  ((a_int * b_int) << 16)) * sign;
-}
+/* The definitions below must not pick up the FIXED_CHECK wrappers. */
+#undef div_f16_16
 
 /* Loses some precision in the fractional part of the divide, but may
    be good enough. */
@@ -71,6 +46,83 @@ div_f16_16(f16_16 a, f16_16 b)
   }
 }
 
+/* Seeds for the reciprocal: entry i is 1/m at the middle of
+   m = [0.5 + i/256, 0.5 + (i+1)/256), as a 1.15 number.  That's good
+   to about 8 bits, and each Newton-Raphson step doubles that. */
+static const unsigned short recip_seed[128] = {
+  65281, 64777, 64281, 63792, 63310, 62836, 62369, 61909,
+  61455, 61008, 60568, 60133, 59705, 59283, 58867, 58457,
+  58053, 57654, 57260, 56872, 56489, 56111, 55738, 55370,
+  55007, 54649, 54295, 53946, 53601, 53261, 52925, 52593,
+  52265, 51942, 51622, 51306, 50995, 50686, 50382, 50081,
+  49784, 49490, 49200, 48913, 48630, 48349, 48072, 47798,
+  47528, 47260, 46995, 46733, 46474, 46218, 45965, 45714,
+  45467, 45222, 44979, 44739, 44502, 44267, 44035, 43805,
+  43577, 43352, 43129, 42908, 42690, 42474, 42260, 42048,
+  41838, 41631, 41425, 41222, 41020, 40820, 40623, 40427,
+  40233, 40041, 39851, 39662, 39476, 39291, 39108, 38926,
+  38746, 38568, 38392, 38217, 38044, 37872, 37702, 37533,
+  37366, 37200, 37036, 36873, 36712, 36552, 36393, 36236,
+  36080, 35926, 35772, 35620, 35470, 35320, 35172, 35026,
+  34880, 34735, 34592, 34450, 34309, 34169, 34031, 33893,
+  33757, 33622, 33487, 33354, 33222, 33091, 32961, 32832,
+};
+
+void
+f16_16_divisor_init(f16_16_divisor *d, f16_16 b)
+{
+  unsigned long m = (unsigned long)(b < 0 ? -(long long)b : b);
+  unsigned long r, e;
+  int n = 0;
+
+  d->neg = (b < 0);
+  if (m == 0) {
+    /* Anything but 0 divided by this saturates. */
+    TRACE_LOG2(ROBOT, F16_16_DIV_ZERO, 0, b);
+    d->recip = 0xffffffff;
+    d->shift = 0;
+    return;
+  }
+
+  /* Normalize m to [0.5,1) as a 0.32 number.  No bfffo on the CPU32,
+     so do it in 5 steps. */
+  if (!(m & 0xffff0000)) { m <<= 16; n += 16; }
+  if (!(m & 0xff000000)) { m <<= 8; n += 8; }
+  if (!(m & 0xf0000000)) { m <<= 4; n += 4; }
+  if (!(m & 0xc0000000)) { m <<= 2; n += 2; }
+  if (!(m & 0x80000000)) { m <<= 1; n += 1; }
+
+  /* r = r * (2 - m * r), twice.  r is a 2.30 number. */
+  r = (unsigned long)recip_seed[(m >> 24) & 127] << 15;
+  e = 0x80000000UL - (unsigned long)(((unsigned long long)m * r) >> 32);
+  r = (unsigned long)(((unsigned long long)r * e) >> 30);
+  e = 0x80000000UL - (unsigned long)(((unsigned long long)m * r) >> 32);
+  r = (unsigned long)(((unsigned long long)r * e) >> 30);
+
+  /* b = m * 2^(16-n), so a/b = a * r * 2^(n-46). */
+  d->recip = r;
+  d->shift = 46 - n;
+}
+
+f16_16
+div_f16_16_fast(f16_16 a, f16_16 b)
+{
+  f16_16_divisor d;
+
+  if (b == 0) {
+    TRACE_LOG2(ROBOT, F16_16_DIV_ZERO, a, b);
+    return (0x7fffffff);
+  }
+  f16_16_divisor_init(&d, b);
+  return div_f16_16_by(a, &d);
+}
+
+f16_16
+recip_f16_16(f16_16 b)
+{
+  return div_f16_16_fast(65536, b);
+}
+
 void
 print_f16_16(f16_16 a)
 {
@@ -32,12 +32,26 @@
 
 #define		F16_16_PI	  205887	/* 3.14159 as a 16.16 fixed */
 
+#define		F16_16_MAX	  0x7fffffffL	/* largest 16.16 value */
+#define		F16_16_MIN	  (-F16_16_MAX - 1) /* smallest 16.16 value */
+
 /**********************************************************************/
 /* Types */
 /**********************************************************************/
 
 typedef long f16_16;
 
+/* A divisor with its reciprocal worked out ahead of time, for code that
+   divides by the same value over and over.  Set one up with
+   f16_16_divisor_init(), then divide by it with div_f16_16_by(). */
+typedef struct f16_16_divisor
+{
+  unsigned long recip;	/* 1/m as a 2.30 number, where m is the
+			   divisor's magnitude normalized to [0.5,1) */
+  int shift;		/* how far to shift a * recip to get a 16.16 */
+  int neg;		/* non-zero if the divisor is negative */
+} f16_16_divisor;
+
 /**********************************************************************/
 /* Macros */
 /**********************************************************************/
@@ -51,15 +65,137 @@ typedef long f16_16;
 /* Functions */
 /**********************************************************************/
 
-f16_16 mult_f16_16(f16_16 a, f16_16 b);
+/* Multiply two 16.16 numbers, rounding to the nearest 16.16 value.
+   The product is formed in one 32x32->64 multiply (a single muls.l on
+   the CPU32), so this is cheap enough to inline into the control
+   loops.  The result is only meaningful if it fits in a 16.16 -
+   callers that might overflow should use mult_f16_16_sat(). */
+static inline f16_16
+mult_f16_16(f16_16 a, f16_16 b)
+{
+  return (f16_16)(((long long)a * b + 32768) >> 16);
+}
+
+/* Same as mult_f16_16(), but clamps the result to F16_16_MIN and
+   F16_16_MAX instead of overflowing. */
+static inline f16_16
+mult_f16_16_sat(f16_16 a, f16_16 b)
+{
+  long long p = ((long long)a * b + 32768) >> 16;
+
+  if (p > F16_16_MAX)
+    return F16_16_MAX;
+  if (p < F16_16_MIN)
+    return F16_16_MIN;
+  return (f16_16)p;
+}
+
+/* Same as mult_f16_16(), but the result is defined to wrap around
+   modulo 2^32 on overflow.  Useful for quantities that are supposed
+   to wrap, like angles. */
+static inline f16_16
+mult_f16_16_wrap(f16_16 a, f16_16 b)
+{
+  return (f16_16)(int)(((long long)a * b + 32768) >> 16);
+}
 
 /* Loses some precision in the fractional part of the divide, but should
    be good enough. */
 f16_16 div_f16_16(f16_16 a, f16_16 b);
 
+/* Work out the reciprocal of 'b' for div_f16_16_by().  There's no
+   divide in here - the reciprocal comes from a small table and two
+   Newton-Raphson steps. */
+void f16_16_divisor_init(f16_16_divisor *d, f16_16 b);
+
+/* Divide 'a' by a divisor set up with f16_16_divisor_init().  This is
+   one 32x32->64 multiply and a shift.  The result is within half an
+   LSB plus |q| * 2^-29 of the exact quotient q, so within 1 LSB for
+   quotients under 4096.0 (div_f16_16() itself is off by up to 1.5
+   LSBs when the signs differ).  Results that don't fit in a 16.16
+   saturate, as does dividing anything but 0 by zero. */
+static inline f16_16
+div_f16_16_by(f16_16 a, const f16_16_divisor *d)
+{
+  unsigned long ua = (unsigned long)(a < 0 ? -(long long)a : a);
+  unsigned long long q;
+  int neg = d->neg ^ (a < 0);
+
+  q = ((unsigned long long)ua * d->recip +
+       ((1ULL << d->shift) >> 1)) >> d->shift;
+  if (q > (unsigned long long)F16_16_MAX + neg)
+    q = (unsigned long long)F16_16_MAX + neg;
+
+  return neg ? (f16_16)-(long long)q : (f16_16)q;
+}
+
+/* Same as div_f16_16(), but built on div_f16_16_by() instead of a 64
+   bit divide, which the CPU32 has to do in software.  See
+   div_f16_16_by() for how accurate it is. */
+f16_16 div_f16_16_fast(f16_16 a, f16_16 b);
+
+/* 1/b, done the same way as div_f16_16_fast(). */
+f16_16 recip_f16_16(f16_16 b);
+
 void print_f16_16(f16_16 a);
 
 double double_from_f16_16(f16_16 a);
 f16_16 f16_16_from_double(double a);
 
+#ifdef FIXED_CHECK
+
+/**********************************************************************/
+/* Checked versions (see fixcheck.h) */
+/**********************************************************************/
+
+#include "fixcheck.h"
+
+static inline f16_16
+fixcheck_mult_f16_16(f16_16 a, f16_16 b, fixcheck_site_t *s)
+{
+  long long p = ((long long)a * b + 32768) >> 16;
+
+  fixcheck_count(s, p > F16_16_MAX || p < F16_16_MIN, 0);
+  return (mult_f16_16)(a, b);
+}
+
+static inline f16_16
+fixcheck_mult_f16_16_sat(f16_16 a, f16_16 b, fixcheck_site_t *s)
+{
+  long long p = ((long long)a * b + 32768) >> 16;
+
+  fixcheck_count(s, 0, p > F16_16_MAX || p < F16_16_MIN);
+  return (mult_f16_16_sat)(a, b);
+}
+
+static inline f16_16
+fixcheck_div_f16_16(f16_16 a, f16_16 b, fixcheck_site_t *s)
+{
+  long long q = b ? ((long long)a << 16) / b : 0;
+
+  fixcheck_count(s, q > F16_16_MAX || q < F16_16_MIN, b == 0);
+  return (div_f16_16)(a, b);
+}
+
+static inline f16_16
+fixcheck_div_f16_16_by(f16_16 a, const f16_16_divisor *d,
+		       fixcheck_site_t *s)
+{
+  f16_16 q = (div_f16_16_by)(a, d);
+
+  fixcheck_count(s, 0, q == F16_16_MAX || q == F16_16_MIN);
+  return q;
+}
+
+#define mult_f16_16(a,b)						\
+  fixcheck_mult_f16_16((a), (b), FIXCHECK_SITE("mult_f16_16"))
+#define mult_f16_16_sat(a,b)						\
+  fixcheck_mult_f16_16_sat((a), (b), FIXCHECK_SITE("mult_f16_16_sat"))
+#define div_f16_16(a,b)							\
+  fixcheck_div_f16_16((a), (b), FIXCHECK_SITE("div_f16_16"))
+#define div_f16_16_by(a,d)						\
+  fixcheck_div_f16_16_by((a), (d), FIXCHECK_SITE("div_f16_16_by"))
+
+#endif /* FIXED_CHECK */
+
 #endif /* _F16_16_H */
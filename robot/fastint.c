@@ -15,7 +15,7 @@
 // 4/9/2003
 // Cleaned up, removed asm, and made .c by Matt Cross.
 
-#include <math.h>
+#include <stdlib.h>
 #include "fastint.h"
 
 /**************************************************************/
@@ -28,224 +28,580 @@ int htanhashtable[1025];
 //
 
 
-int isinof[360],icosof[360]; //sin&cos <<14
-int tanhashtable[129];
-
-
-void init_trig(void)
+/* sin & cos of each whole degree, << 14.  Generated by
+   gentriglookup.c. */
+const int isinof[360] =
+{
+  /*   0 */ 0, 285, 571, 857, 1142, 1427, 1712, 1996,
+  /*   8 */ 2280, 2563, 2845, 3126, 3406, 3685, 3963, 4240,
+  /*  16 */ 4516, 4790, 5062, 5334, 5603, 5871, 6137, 6401,
+  /*  24 */ 6663, 6924, 7182, 7438, 7691, 7943, 8191, 8438,
+  /*  32 */ 8682, 8923, 9161, 9397, 9630, 9860, 10086, 10310,
+  /*  40 */ 10531, 10748, 10963, 11173, 11381, 11585, 11785, 11982,
+  /*  48 */ 12175, 12365, 12550, 12732, 12910, 13084, 13254, 13420,
+  /*  56 */ 13582, 13740, 13894, 14043, 14188, 14329, 14466, 14598,
+  /*  64 */ 14725, 14848, 14967, 15081, 15190, 15295, 15395, 15491,
+  /*  72 */ 15582, 15668, 15749, 15825, 15897, 15964, 16025, 16082,
+  /*  80 */ 16135, 16182, 16224, 16261, 16294, 16321, 16344, 16361,
+  /*  88 */ 16374, 16381, 16384, 16381, 16374, 16361, 16344, 16321,
+  /*  96 */ 16294, 16261, 16224, 16182, 16135, 16082, 16025, 15964,
+  /* 104 */ 15897, 15825, 15749, 15668, 15582, 15491, 15395, 15295,
+  /* 112 */ 15190, 15081, 14967, 14848, 14725, 14598, 14466, 14329,
+  /* 120 */ 14188, 14043, 13894, 13740, 13582, 13420, 13254, 13084,
+  /* 128 */ 12910, 12732, 12550, 12365, 12175, 11982, 11785, 11585,
+  /* 136 */ 11381, 11173, 10963, 10748, 10531, 10310, 10086, 9860,
+  /* 144 */ 9630, 9397, 9161, 8923, 8682, 8438, 8191, 7943,
+  /* 152 */ 7691, 7438, 7182, 6924, 6663, 6401, 6137, 5871,
+  /* 160 */ 5603, 5334, 5062, 4790, 4516, 4240, 3963, 3685,
+  /* 168 */ 3406, 3126, 2845, 2563, 2280, 1996, 1712, 1427,
+  /* 176 */ 1142, 857, 571, 285, 0, -285, -571, -857,
+  /* 184 */ -1142, -1427, -1712, -1996, -2280, -2563, -2845, -3126,
+  /* 192 */ -3406, -3685, -3963, -4240, -4516, -4790, -5062, -5334,
+  /* 200 */ -5603, -5871, -6137, -6401, -6663, -6924, -7182, -7438,
+  /* 208 */ -7691, -7943, -8192, -8438, -8682, -8923, -9161, -9397,
+  /* 216 */ -9630, -9860, -10086, -10310, -10531, -10748, -10963, -11173,
+  /* 224 */ -11381, -11585, -11785, -11982, -12175, -12365, -12550, -12732,
+  /* 232 */ -12910, -13084, -13254, -13420, -13582, -13740, -13894, -14043,
+  /* 240 */ -14188, -14329, -14466, -14598, -14725, -14848, -14967, -15081,
+  /* 248 */ -15190, -15295, -15395, -15491, -15582, -15668, -15749, -15825,
+  /* 256 */ -15897, -15964, -16025, -16082, -16135, -16182, -16224, -16261,
+  /* 264 */ -16294, -16321, -16344, -16361, -16374, -16381, -16384, -16381,
+  /* 272 */ -16374, -16361, -16344, -16321, -16294, -16261, -16224, -16182,
+  /* 280 */ -16135, -16082, -16025, -15964, -15897, -15825, -15749, -15668,
+  /* 288 */ -15582, -15491, -15395, -15295, -15190, -15081, -14967, -14848,
+  /* 296 */ -14725, -14598, -14466, -14329, -14188, -14043, -13894, -13740,
+  /* 304 */ -13582, -13420, -13254, -13084, -12910, -12732, -12550, -12365,
+  /* 312 */ -12175, -11982, -11785, -11585, -11381, -11173, -10963, -10748,
+  /* 320 */ -10531, -10310, -10086, -9860, -9630, -9397, -9161, -8923,
+  /* 328 */ -8682, -8438, -8192, -7943, -7691, -7438, -7182, -6924,
+  /* 336 */ -6663, -6401, -6137, -5871, -5603, -5334, -5062, -4790,
+  /* 344 */ -4516, -4240, -3963, -3685, -3406, -3126, -2845, -2563,
+  /* 352 */ -2280, -1996, -1712, -1427, -1142, -857, -571, -285,
+};
+
+const int icosof[360] =
 {
-  double t;int i;
+  /*   0 */ 16384, 16381, 16374, 16361, 16344, 16321, 16294, 16261,
+  /*   8 */ 16224, 16182, 16135, 16082, 16025, 15964, 15897, 15825,
+  /*  16 */ 15749, 15668, 15582, 15491, 15395, 15295, 15190, 15081,
+  /*  24 */ 14967, 14848, 14725, 14598, 14466, 14329, 14188, 14043,
+  /*  32 */ 13894, 13740, 13582, 13420, 13254, 13084, 12910, 12732,
+  /*  40 */ 12550, 12365, 12175, 11982, 11785, 11585, 11381, 11173,
+  /*  48 */ 10963, 10748, 10531, 10310, 10086, 9860, 9630, 9397,
+  /*  56 */ 9161, 8923, 8682, 8438, 8192, 7943, 7691, 7438,
+  /*  64 */ 7182, 6924, 6663, 6401, 6137, 5871, 5603, 5334,
+  /*  72 */ 5062, 4790, 4516, 4240, 3963, 3685, 3406, 3126,
+  /*  80 */ 2845, 2563, 2280, 1996, 1712, 1427, 1142, 857,
+  /*  88 */ 571, 285, 0, -285, -571, -857, -1142, -1427,
+  /*  96 */ -1712, -1996, -2280, -2563, -2845, -3126, -3406, -3685,
+  /* 104 */ -3963, -4240, -4516, -4790, -5062, -5334, -5603, -5871,
+  /* 112 */ -6137, -6401, -6663, -6924, -7182, -7438, -7691, -7943,
+  /* 120 */ -8191, -8438, -8682, -8923, -9161, -9397, -9630, -9860,
+  /* 128 */ -10086, -10310, -10531, -10748, -10963, -11173, -11381, -11585,
+  /* 136 */ -11785, -11982, -12175, -12365, -12550, -12732, -12910, -13084,
+  /* 144 */ -13254, -13420, -13582, -13740, -13894, -14043, -14188, -14329,
+  /* 152 */ -14466, -14598, -14725, -14848, -14967, -15081, -15190, -15295,
+  /* 160 */ -15395, -15491, -15582, -15668, -15749, -15825, -15897, -15964,
+  /* 168 */ -16025, -16082, -16135, -16182, -16224, -16261, -16294, -16321,
+  /* 176 */ -16344, -16361, -16374, -16381, -16384, -16381, -16374, -16361,
+  /* 184 */ -16344, -16321, -16294, -16261, -16224, -16182, -16135, -16082,
+  /* 192 */ -16025, -15964, -15897, -15825, -15749, -15668, -15582, -15491,
+  /* 200 */ -15395, -15295, -15190, -15081, -14967, -14848, -14725, -14598,
+  /* 208 */ -14466, -14329, -14188, -14043, -13894, -13740, -13582, -13420,
+  /* 216 */ -13254, -13084, -12910, -12732, -12550, -12365, -12175, -11982,
+  /* 224 */ -11785, -11585, -11381, -11173, -10963, -10748, -10531, -10310,
+  /* 232 */ -10086, -9860, -9630, -9397, -9161, -8923, -8682, -8438,
+  /* 240 */ -8192, -7943, -7691, -7438, -7182, -6924, -6663, -6401,
+  /* 248 */ -6137, -5871, -5603, -5334, -5062, -4790, -4516, -4240,
+  /* 256 */ -3963, -3685, -3406, -3126, -2845, -2563, -2280, -1996,
+  /* 264 */ -1712, -1427, -1142, -857, -571, -285, 0, 285,
+  /* 272 */ 571, 857, 1142, 1427, 1712, 1996, 2280, 2563,
+  /* 280 */ 2845, 3126, 3406, 3685, 3963, 4240, 4516, 4790,
+  /* 288 */ 5062, 5334, 5603, 5871, 6137, 6401, 6663, 6924,
+  /* 296 */ 7182, 7438, 7691, 7943, 8192, 8438, 8682, 8923,
+  /* 304 */ 9161, 9397, 9630, 9860, 10086, 10310, 10531, 10748,
+  /* 312 */ 10963, 11173, 11381, 11585, 11785, 11982, 12175, 12365,
+  /* 320 */ 12550, 12732, 12910, 13084, 13254, 13420, 13582, 13740,
+  /* 328 */ 13894, 14043, 14188, 14329, 14466, 14598, 14725, 14848,
+  /* 336 */ 14967, 15081, 15190, 15295, 15395, 15491, 15582, 15668,
+  /* 344 */ 15749, 15825, 15897, 15964, 16025, 16082, 16135, 16182,
+  /* 352 */ 16224, 16261, 16294, 16321, 16344, 16361, 16374, 16381,
+};
+
+
+/* atan(i/128) in degrees as a 16.16 number, for fastatan2_24_8(). */
+static const f16_16 atan_table[129] = {
+  0, 29335, 58666, 87990, 117304, 146603, 175884,
+  205144, 234379, 263585, 292760, 321899, 350999, 380058,
+  409070, 438034, 466945, 495801, 524598, 553333, 582003,
+  610605, 639135, 667591, 695970, 724268, 752484, 780613,
+  808654, 836604, 864460, 892219, 919879, 947438, 974893,
+  1002241, 1029481, 1056611, 1083627, 1110529, 1137313, 1163979,
+  1190524, 1216947, 1243245, 1269417, 1295461, 1321376, 1347161,
+  1372813, 1398332, 1423717, 1448965, 1474076, 1499049, 1523882,
+  1548575, 1573127, 1597536, 1621803, 1645926, 1669904, 1693738,
+  1717426, 1740967, 1764362, 1787610, 1810710, 1833663, 1856467,
+  1879123, 1901631, 1923990, 1946200, 1968261, 1990173, 2011937,
+  2033552, 2055018, 2076336, 2097505, 2118526, 2139399, 2160125,
+  2180703, 2201134, 2221419, 2241558, 2261551, 2281398, 2301101,
+  2320659, 2340074, 2359345, 2378474, 2397460, 2416306, 2435010,
+  2453574, 2471999, 2490285, 2508433, 2526443, 2544317, 2562055,
+  2579658, 2597126, 2614461, 2631664, 2648734, 2665673, 2682482,
+  2699161, 2715711, 2732134, 2748430, 2764600, 2780644, 2796564,
+  2812361, 2828035, 2843587, 2859019, 2874330, 2889523, 2904597,
+  2919554, 2934395, 2949120,
+};
+
+int
+fastatan2_24_8(long y, long x)
+{
+  unsigned long ax, ay, mn, mx, r;
+  f16_16 a;
+  int i;
 
-  for (i = 0;i<=128;i++)
-   {
-     t= i;
-     tanhashtable[i] = atan(t/128)*180/M_PI;
-   }
+  if (x == 0 && y == 0)
+    return 0;
 
-#if 0
-  for (i = 0;i<=1025;i++)
-   {
-     t= i;
-     htanhashtable[i] = atan(t/1024)*32768/M_PI;
-   }
-#endif
+  ax = labs(x);
+  ay = labs(y);
+  if (ax > ay)
+    {
+      mx = ax;
+      mn = ay;
+    }
+  else
+    {
+      mx = ay;
+      mn = ax;
+    }
 
-  for (i=0;i<360;i++)
-   {
-     t=M_PI/180*i;
-     isinof[i] = sin(t)*(1<<14);
-     icosof[i] = cos(t)*(1<<14);
-   }
+  /* r = min/max as a 0.16 number.  mn << 16 (plus rounding) has to
+     fit in 32 bits, so mn must be below 2^15. */
+  while (mn >= 0x8000)
+    {
+      mx >>= 1;
+      mn >>= 1;
+    }
+  r = ((mn << 16) + (mx >> 1)) / mx;
+
+  /* atan(r), 0 to 45 degrees, interpolated from the table. */
+  i = r >> 9;
+  a = atan_table[i];
+  if (r & 511)
+    a += ((atan_table[i + 1] - a) * (long)(r & 511) + 256) >> 9;
+
+  /* Unfold that into the right octant. */
+  if (ay > ax)
+    a = 90 * 65536 - a;
+  if (x < 0)
+    a = 180 * 65536 - a;
+  if (y < 0)
+    a = 360 * 65536 - a;
+
+  a = (a + 128) >> 8;
+  if (a >= 360 * 256)
+    a -= 360 * 256;
+  return (int)a;
+}
 
-#if 0
-  for (i=0;i<1025;i++)
-   {
-     t =M_PI/2048L*i;
-     hsinof[i] = sin(t)*65536L;
-   }
-#endif
+int fastatan2(long y, long x)
+{
+  int t = (fastatan2_24_8(y, x) + 128) >> 8;
+
+  if (t == 360)
+    t = 0;
+  return t;
 }
 
 
-int fastatan2(long y, long x)
+/* Tables for fastasin_f16_16(), generated by genasinlookup.c (which
+   describes how they are laid out).  asin_table has entry i as
+   asin(i/256) in degrees, for sin values from 0 to 0.5. */
+static const f16_16 asin_table[129] =
 {
-  int t,d,a;
-  long tan;
+  /*   0 */ 0, 14668, 29336, 44004, 58673, 73343,
+  /*   6 */ 88014, 102687, 117361, 132037, 146715, 161395,
+  /*  12 */ 176077, 190762, 205451, 220142, 234837, 249535,
+  /*  18 */ 264237, 278943, 293654, 308369, 323088, 337813,
+  /*  24 */ 352543, 367278, 382019, 396766, 411519, 426279,
+  /*  30 */ 441045, 455818, 470598, 485385, 500180, 514983,
+  /*  36 */ 529794, 544613, 559441, 574277, 589123, 603978,
+  /*  42 */ 618842, 633716, 648600, 663495, 678400, 693316,
+  /*  48 */ 708242, 723181, 738131, 753092, 768066, 783052,
+  /*  54 */ 798051, 813063, 828088, 843127, 858179, 873246,
+  /*  60 */ 888326, 903422, 918532, 933657, 948798, 963955,
+  /*  66 */ 979128, 994317, 1009523, 1024745, 1039986, 1055243,
+  /*  72 */ 1070519, 1085813, 1101125, 1116457, 1131807, 1147177,
+  /*  78 */ 1162567, 1177977, 1193408, 1208859, 1224332, 1239826,
+  /*  84 */ 1255343, 1270881, 1286443, 1302027, 1317635, 1333266,
+  /*  90 */ 1348922, 1364602, 1380307, 1396038, 1411794, 1427576,
+  /*  96 */ 1443385, 1459221, 1475085, 1490976, 1506895, 1522843,
+  /* 102 */ 1538820, 1554827, 1570864, 1586931, 1603030, 1619159,
+  /* 108 */ 1635321, 1651515, 1667742, 1684003, 1700297, 1716626,
+  /* 114 */ 1732990, 1749390, 1765825, 1782298, 1798807, 1815354,
+  /* 120 */ 1831940, 1848565, 1865229, 1881933, 1898678, 1915465,
+  /* 126 */ 1932294, 1949165, 1966080,
+};
+
+/* asin_tail_table covers sin values from 0.5 to 1, indexed by how far
+   below 1 the value is, with entries closer together as it gets near
+   1 (where asin is steepest). */
+static const f16_16 asin_tail_table[353] =
+{
+  /*   0 */ 5898240, 5877497, 5868904, 5862311, 5856753, 5851856,
+  /*   6 */ 5847429, 5843358, 5839569, 5836009, 5832643, 5829441,
+  /*  12 */ 5826382, 5823448, 5820624, 5817900, 5815265, 5812711,
+  /*  18 */ 5810232, 5807820, 5805471, 5803180, 5800943, 5798756,
+  /*  24 */ 5796616, 5794520, 5792466, 5790451, 5788473, 5786530,
+  /*  30 */ 5784620, 5782742, 5780893, 5779074, 5777282, 5775516,
+  /*  36 */ 5773775, 5772058, 5770364, 5768692, 5767041, 5765411,
+  /*  42 */ 5763801, 5762210, 5760637, 5759082, 5757544, 5756023,
+  /*  48 */ 5754518, 5753028, 5751553, 5750094, 5748648, 5747216,
+  /*  54 */ 5745798, 5744393, 5743000, 5741620, 5740252, 5738896,
+  /*  60 */ 5737551, 5736217, 5734894, 5733582, 5732280, 5729707,
+  /*  66 */ 5727172, 5724674, 5722211, 5719783, 5717387, 5715022,
+  /*  72 */ 5712688, 5710382, 5708104, 5705854, 5703629, 5701429,
+  /*  78 */ 5699254, 5697102, 5694973, 5692866, 5690781, 5688716,
+  /*  84 */ 5686671, 5684646, 5682640, 5680652, 5678682, 5676730,
+  /*  90 */ 5674795, 5672876, 5670974, 5669087, 5667216, 5665360,
+  /*  96 */ 5663518, 5659878, 5656292, 5652758, 5649275, 5645839,
+  /* 102 */ 5642450, 5639105, 5635802, 5632541, 5629319, 5626135,
+  /* 108 */ 5622988, 5619876, 5616798, 5613754, 5610742, 5607762,
+  /* 114 */ 5604811, 5601890, 5598997, 5596132, 5593293, 5590481,
+  /* 120 */ 5587694, 5584932, 5582194, 5579480, 5576788, 5574119,
+  /* 126 */ 5571471, 5568845, 5566239, 5561088, 5556014, 5551015,
+  /* 132 */ 5546086, 5541225, 5536428, 5531695, 5527022, 5522406,
+  /* 138 */ 5517847, 5513341, 5508887, 5504483, 5500128, 5495820,
+  /* 144 */ 5491557, 5487339, 5483163, 5479028, 5474934, 5470879,
+  /* 150 */ 5466862, 5462881, 5458937, 5455027, 5451152, 5447310,
+  /* 156 */ 5443499, 5439721, 5435973, 5432255, 5428567, 5421275,
+  /* 162 */ 5414092, 5407014, 5400036, 5393153, 5386363, 5379661,
+  /* 168 */ 5373044, 5366508, 5360052, 5353672, 5347364, 5341128,
+  /* 174 */ 5334961, 5328859, 5322822, 5316847, 5310933, 5305077,
+  /* 180 */ 5299277, 5293533, 5287842, 5282204, 5276616, 5271078,
+  /* 186 */ 5265587, 5260144, 5254746, 5249392, 5244082, 5238814,
+  /* 192 */ 5233587, 5223254, 5213076, 5203044, 5193154, 5183399,
+  /* 198 */ 5173774, 5164273, 5154892, 5145627, 5136473, 5127426,
+  /* 204 */ 5118483, 5109639, 5100892, 5092239, 5083676, 5075201,
+  /* 210 */ 5066811, 5058503, 5050276, 5042126, 5034052, 5026051,
+  /* 216 */ 5018121, 5010261, 5002469, 4994743, 4987081, 4979481,
+  /* 222 */ 4971943, 4964464, 4957044, 4942372, 4927918, 4913670,
+  /* 228 */ 4899622, 4885764, 4872088, 4858588, 4845257, 4832088,
+  /* 234 */ 4819075, 4806213, 4793497, 4780921, 4768481, 4756172,
+  /* 240 */ 4743991, 4731933, 4719995, 4708172, 4696461, 4684860,
+  /* 246 */ 4673365, 4661973, 4650681, 4639487, 4628388, 4617381,
+  /* 252 */ 4606465, 4595636, 4584893, 4574234, 4563656, 4542738,
+  /* 258 */ 4522124, 4501800, 4481755, 4461976, 4442453, 4423176,
+  /* 264 */ 4404134, 4385319, 4366723, 4348338, 4330156, 4312170,
+  /* 270 */ 4294374, 4276762, 4259327, 4242063, 4224967, 4208031,
+  /* 276 */ 4191252, 4174626, 4158147, 4141811, 4125615, 4109555,
+  /* 282 */ 4093626, 4077826, 4062152, 4046599, 4031166, 4015848,
+  /* 288 */ 4000644, 3970563, 3940905, 3911649, 3882777, 3854274,
+  /* 294 */ 3826124, 3798313, 3770827, 3743654, 3716781, 3690199,
+  /* 300 */ 3663896, 3637862, 3612088, 3586566, 3561286, 3536242,
+  /* 306 */ 3511425, 3486828, 3462445, 3438269, 3414294, 3390514,
+  /* 312 */ 3366923, 3343516, 3320289, 3297235, 3274351, 3251631,
+  /* 318 */ 3229072, 3206669, 3184419, 3140360, 3096866, 3053911,
+  /* 324 */ 3011469, 2969518, 2928035, 2887000, 2846395, 2806201,
+  /* 330 */ 2766402, 2726982, 2687926, 2649221, 2610852, 2572808,
+  /* 336 */ 2535076, 2497645, 2460505, 2423645, 2387055, 2350727,
+  /* 342 */ 2314651, 2278819, 2243223, 2207855, 2172708, 2137774,
+  /* 348 */ 2103047, 2068520, 2034188, 2000043, 1966080,
+};
+
+/* asin(x) for x from 0 to 0.5, interpolating in asin_table. */
+static f16_16
+asin_small(f16_16 x)
+{
+  int i = x >> 8;
+  int frac = x & 0xff;
+  f16_16 a = asin_table[i];
+
+  if (frac)
+    a += ((asin_table[i + 1] - a) * frac + 128) >> 8;
+  return a;
+}
 
-  if (x == 0 && y == 0) return 0;//bulletproof
+/* asin(1 - u) for u from 0 to 0.5, interpolating in asin_tail_table.
+   The octave of u is found in a fixed four steps, without branching,
+   so this takes the same time whatever u is. */
+static f16_16
+asin_tail(f16_16 u)
+{
+  int i, j, frac;
+  f16_16 a;
+
+  j = (u >= (32 << 8)) << 3;
+  j += (u >= (32L << (j + 4))) << 2;
+  j += (u >= (32L << (j + 2))) << 1;
+  j += (u >= (32L << (j + 1)));
+
+  i = (j << 5) + (u >> j);
+  frac = u & ((1 << j) - 1);
+  a = asin_tail_table[i];
+  return a + (((asin_tail_table[i + 1] - a) * frac + ((1 << j) >> 1)) >> j);
+}
 
-  if (x >= 0)
-    {
-      if (y >= 0)
-	{
-	  /* X & Y are positive */
-	  if (x>y)
-	    {
-	      tan = (y<<7)/x;
-	      d = 1;
-	      a = 0;
-	    }
-	  else
-	    {
-	      tan = (x<<7)/y;
-	      d = 0;
-	      a = 90;
-	    }
-	}
-      else
-	{
-	  /* X positive, Y negative. */
-	  if (x>-y)
-	    {
-	      tan = -(y<<7)/x;
-	      d = 0;
-	      a = 360;
-	    }
-	  else
-	    {
-	      tan = (x<<7)/-y;
-	      d = 1;
-	      a = 270;
-	    }
-	}
-    }
-  else
+f16_16
+fastasin_f16_16(f16_16 x)
+{
+  f16_16 a;
+  int neg = 0;
+
+  /* Clamp before folding the sign, so -x can't overflow. */
+  if (x > 65536)
+    x = 65536;
+  if (x < -65536)
+    x = -65536;
+  if (x < 0)
     {
-      if (y >= 0)
-	{
-	  /* X negative, Y posative. */
-	  if (-x>y)
-	    {
-	      tan = (y<<7)/-x;
-	      d = 0;
-	      a = 180;
-	    }
-	  else
-	    {
-	      tan = (-x<<7)/y;
-	      d = 1;
-	      a = 90;
-	    }
-	}
-      else
-	{
-	  /* Both X & Y are negative. */
-	  if (-x>-y)
-	    {
-	      tan = (y<<7)/x;
-	      d = 1;
-	      a = 180;
-	    }
-	  else
-	    {
-	      tan = (x<<7)/y;
-	      d = 0;
-	      a = 270;
-	    }
-	}
+      neg = 1;
+      x = -x;
     }
-  t = tanhashtable[(int)tan];
-  if(d)
-    t = a+t;
+
+  if (x <= 32768)
+    a = asin_small(x);
   else
-    t = a-t;
-  if (t==360)
-    t=0;
-  return t;
+    a = asin_tail(65536 - x);
+
+  return neg ? -a : a;
 }
 
+f16_16
+fastacos_f16_16(f16_16 x)
+{
+  return 90 * 65536 - fastasin_f16_16(x);
+}
 
+/* The whole degree versions round the 16.16 ones; fastasin() keeps
+   returning negative angles as 270 to 359. */
 int fastasin(int x)
 {
-  int a,b,i;
+  int a = round_f16_16(fastasin_f16_16(x * 4));
 
-  if (x<0)
-    {
-      a=270;
-      b=359;
-    }
-  else
+  return a < 0 ? a + 360 : a;
+}
+
+int fastacos(int x)
+{
+  return round_f16_16(fastacos_f16_16(x * 4));
+}
+
+
+/* Shift-and-subtract square root: one result bit per iteration, from
+   the top, with no divides.  'm' is -1 when the trial subtraction
+   fits and 0 when it doesn't, so each iteration is the same
+   instructions whatever x is.  At the end rem is x - root^2, and x is
+   closer to (root + 1)^2 than root^2 exactly when rem > root. */
+unsigned
+sqrti(unsigned long x)
+{
+  unsigned long rem = x & 0xffffffffUL;
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+  unsigned long t, m;
+  int i;
+
+  for (i = 0; i < 16; i++)
     {
-      a=0;
-      b=90;
+      t = root + bit;
+      m = -(unsigned long)(rem >= t);
+      rem -= t & m;
+      root = (root >> 1) | (bit & m);
+      bit >>= 2;
     }
 
-  while(a < b-1)      //binary search
+  return (unsigned)(root + (rem > root));
+}
+
+unsigned long
+sqrti64(unsigned long long x)
+{
+  unsigned long long rem = x;
+  unsigned long long root = 0;
+  unsigned long long bit = 1ULL << 62;
+  unsigned long long t, m;
+  int i;
+
+  for (i = 0; i < 32; i++)
     {
-      i= (a+b)>>1;
-      if (isinof[i]<x)
-	a=i;
-      else
-	b=i;
+      t = root + bit;
+      m = -(unsigned long long)(rem >= t);
+      rem -= t & m;
+      root = (root >> 1) | (bit & m);
+      bit >>= 2;
     }
-  if (x-isinof[a] > isinof[b]-x)
-    return b;
-  else
-    return a;
+
+  /* sqrt(2^64 - 1) rounds up to 2^32, which doesn't fit. */
+  if (rem > root && root != 0xffffffffULL)
+    root++;
+  return (unsigned long)root;
 }
 
-int fastacos(int x) // 90-fastasin(x)
+/* CORDIC.  Each iteration rotates (x, y) by +/- atan(2^-i), so after
+   n iterations the angle is known to about atan(2^-(n-1)) degrees. */
+
+/* atan(2^-i) in degrees, as a 16.16 number. */
+static const f16_16 cordic_atan[CORDIC_MAX_ITERS] = {
+  2949120, 1740967, 919879, 466945, 234379, 117304, 58666, 29335,
+  14668, 7334, 3667, 1833, 917, 458, 229, 115, 57, 29, 14, 7,
+};
+
+/* Every iteration stretches the vector a little; entry n is the
+   product of 1/sqrt(1 + 2^-2i) for i < n, as a 2.30 number, to undo
+   that after n iterations. */
+static const long cordic_gain[CORDIC_MAX_ITERS + 1] = {
+  1073741824, 759250125, 679093957, 658817909, 653730436, 652457347,
+  652138997, 652059405, 652039507, 652034532, 652033289, 652032978,
+  652032900, 652032881, 652032876, 652032874, 652032874, 652032874,
+  652032874, 652032874, 652032874,
+};
+
+/* Scale x and y so the bigger one is just under 2^28, which leaves
+   room for the CORDIC gain without overflowing.  Returns how many
+   bits they were shifted left (negative means right). */
+static int
+cordic_prescale(long *x, long *y)
 {
-  int a,b,i;
-  
-  a=0;
- b=180;
-  while(a < b-1)      //binary search
+  unsigned long m = labs(*x) | labs(*y);
+  int s = 0;
+
+  if (m == 0)
+    return 0;
+
+  while (m >= (1UL << 28))
     {
-      i= (a+b)>>1;
-      if (icosof[i]>x)
-	a=i;
-      else
-	b=i;
+      m >>= 1;
+      s--;
+    }
+  if (s < 0)
+    {
+      *x >>= -s;
+      *y >>= -s;
+      return s;
     }
-  if (icosof[a]-x > x-icosof[b])
-    return b; //interpolation would go here for
-  else
-    return a; //higher precision angles
-}
 
+  if (!(m & 0x0fffc000)) { m <<= 14; s += 14; }
+  if (!(m & 0x0ff00000)) { m <<= 8; s += 8; }
+  if (!(m & 0x0f000000)) { m <<= 4; s += 4; }
+  if (!(m & 0x0c000000)) { m <<= 2; s += 2; }
+  if (!(m & 0x08000000)) { m <<= 1; s += 1; }
+  *x <<= s;
+  *y <<= s;
+  return s;
+}
 
-unsigned sqrti(unsigned long x)//{float f=x;unsigned i=sqrt(f);return i;}
+/* Undo the CORDIC gain and the prescale shift. */
+static long
+cordic_unscale(long v, int iters, int s)
 {
-  unsigned long rt;
-  long i;
+  v = (long)(((long long)v * cordic_gain[iters] + (1L << 29)) >> 30);
+  if (s > 0)
+    return (v + (1L << (s - 1))) >> s;
+  return v << -s;
+}
 
-  if (x==0)
-    return 0;
-  if (x<4)
+static int
+cordic_clamp_iters(int iters)
+{
+  if (iters < 1)
     return 1;
+  if (iters > CORDIC_MAX_ITERS)
+    return CORDIC_MAX_ITERS;
+  return iters;
+}
 
-  for(i=2;(x>>i)>0;i+=2)  // find top bit
-    continue;
-
-  rt = x>>(i>>1);
-  if (rt == 0xFFFF)
-    return (unsigned)rt;
-
-  while (x >= rt*rt+(rt<<1)+1)
-   {
-     i = (x/rt-rt)>>1;          //(a+b)=a+2ab+b; c-a=2ab+b
-     rt += i;                                //   (b ~= c-a)/2a
-     while(x<=rt*rt-(rt<<1)+1)
-      {
-	i = (rt-x/rt)>>1;
-        rt -= i;
-      }
-   }
+void
+cordic_vector(long x, long y, int iters, unsigned long *magp, f16_16 *anglep)
+{
+  f16_16 z = 0;
+  long t, m;
+  int i, s;
 
-  if (rt*rt < x)
+  iters = cordic_clamp_iters(iters);
+
+  /* The iterations only converge for angles within about 99 degrees
+     of 0, so flip the left half plane over first. */
+  if (x < 0)
     {
-      if ((x - rt*rt) > (rt*rt + (rt<<1) + 1 - x))
-	rt++;
+      x = -x;
+      y = -y;
+      z = 180 * 65536;
     }
-  else
+
+  s = cordic_prescale(&x, &y);
+
+  /* Rotate (x, y) down onto the x axis, adding up how far we went.
+     'm' is 0 to rotate clockwise and -1 to go the other way; (v ^ m) -
+     m is then v or -v, which saves a branch per iteration. */
+  for (i = 0; i < iters; i++)
+    {
+      m = -(long)(y <= 0);
+      t = x;
+      x += ((y >> i) ^ m) - m;
+      y -= ((t >> i) ^ m) - m;
+      z += (cordic_atan[i] ^ m) - m;
+    }
+
+  if (z < 0)
+    z += 360 * 65536;
+  if (z >= 360 * 65536)
+    z -= 360 * 65536;
+
+  if (magp != NULL)
+    *magp = (unsigned long)cordic_unscale(x, iters, s);
+  if (anglep != NULL)
+    *anglep = z;
+}
+
+void
+cordic_rotate(long *xp, long *yp, f16_16 angle, int iters)
+{
+  long x = *xp, y = *yp, t, m;
+  int i, s;
+
+  iters = cordic_clamp_iters(iters);
+
+  /* Get the angle into -90 to 90, rotating by 180 first if need be. */
+  angle %= 360 * 65536;
+  if (angle < 0)
+    angle += 360 * 65536;
+  if (angle > 270 * 65536)
+    angle -= 360 * 65536;
+  else if (angle > 90 * 65536)
     {
-      if
-	((rt*rt - x) > (x - (rt*rt - (rt<<1) + 1)))
-	rt--;
+      angle -= 180 * 65536;
+      x = -x;
+      y = -y;
     }
 
-  return (unsigned)rt;
+  s = cordic_prescale(&x, &y);
+
+  /* Rotate (x, y) by whatever's left of the angle, driving it to 0.
+     'm' works the same as in cordic_vector(). */
+  for (i = 0; i < iters; i++)
+    {
+      m = -(long)(angle <= 0);
+      t = x;
+      x -= ((y >> i) ^ m) - m;
+      y += ((t >> i) ^ m) - m;
+      angle -= (cordic_atan[i] ^ m) - m;
+    }
+
+  *xp = cordic_unscale(x, iters, s);
+  *yp = cordic_unscale(y, iters, s);
+}
+
+void
+cordic_sincos(f16_16 angle, int iters, f16_16 *sinp, f16_16 *cosp)
+{
+  long x = 65536, y = 0;
+
+  cordic_rotate(&x, &y, angle, iters);
+  if (sinp != NULL)
+    *sinp = y;
+  if (cosp != NULL)
+    *cosp = x;
 }
 
 #if 0
@@ -21,21 +21,71 @@
 
 /* Include file for fast trig routines. */
 
-/* These arrays are indexed by the angle in degrees, and return the
-   sin & cos value in a fixed 18.14 format. */
-extern int isinof[360],icosof[360];
+#include "f16_16.h"
 
-/* Must be called at boot time to fill in trig tables. */
-extern void init_trig(void);
+/* These arrays are indexed by the angle in degrees, and return the
+   sin & cos value in a fixed 18.14 format.  They are constant, so
+   they stay in ROM. */
+extern const int isinof[360],icosof[360];
 
-/* Returns angle in degrees. */
+/* Returns the angle of (x, y) in degrees, 0 to 359. */
 extern int fastatan2(long y, long x);
 
-/* Expects sin value in 18.14 format, returns angle in degrees. */
+/* Returns the angle of (x, y) in degrees as a 24.8 number, from 0 to
+   360 (not including 360).  Interpolates in a table; good to 0.7 of
+   a 24.8 LSB while x and y are below 32768, and about 1 LSB (1/256
+   degree) past that.  One divide, same as fastatan2(). */
+extern int fastatan2_24_8(long y, long x);
+
+/* Expects sin value in 18.14 format, returns angle in degrees, 0 to
+   90 or 270 to 359.  Rounds fastasin_f16_16(). */
 extern int fastasin(int x);
 
-/* Expects cos value in 18.14 format, returns angle in degrees. */
+/* Expects sin value in 16.16 format, returns angle in degrees as a
+   16.16 number, from -90 to 90.  Interpolates in a table, no floating
+   point, and no search - the cost doesn't depend on the input.  Within 0.0012
+   degrees of the exact asin of the value passed in, checked for every
+   input.  Values outside -1 to 1 are clamped. */
+extern f16_16 fastasin_f16_16(f16_16 x);
+
+/* Expects cos value in 18.14 format, returns angle in degrees, 0 to
+   180.  Rounds fastacos_f16_16(). */
 extern int fastacos(int x);
 
-/* Returns the sqrt of x. */
+/* Expects cos value in 16.16 format, returns angle in degrees as a
+   16.16 number, from 0 to 180.  Same accuracy and cost as
+   fastasin_f16_16(). */
+extern f16_16 fastacos_f16_16(f16_16 x);
+
+/* Returns the sqrt of x (a 32 bit value), rounded to the nearest
+   integer.  Shift-and-subtract, so no divides, and always 16
+   iterations. */
 extern unsigned sqrti(unsigned long x);
+
+/* sqrti() for a 64 bit x, e.g. a sum of squares that would overflow
+   32 bits.  Always 32 iterations.  The result saturates at
+   0xffffffff. */
+extern unsigned long sqrti64(unsigned long long x);
+
+/* Most CORDIC iterations worth doing - past this the angles are below
+   16.16 resolution. */
+#define CORDIC_MAX_ITERS 20
+
+/* CORDIC vectoring: the magnitude and angle of (x, y) in one pass of
+   'iters' shift-and-add iterations, with no multiplies or divides
+   until the final gain correction.  The angle is in degrees as a 16.16
+   number from 0 to 360, measured the same way as fastatan2(y, x), and
+   is good to about atan(2^-(iters-1)) - e.g. 0.03 degrees for 12
+   iterations.  The magnitude is sqrt(x*x + y*y) rounded, without
+   x*x + y*y ever being formed.  Either pointer may be NULL. */
+extern void cordic_vector(long x, long y, int iters,
+			  unsigned long *magp, f16_16 *anglep);
+
+/* CORDIC rotation: rotates (*xp, *yp) by 'angle' degrees (16.16)
+   counterclockwise, in 'iters' iterations. */
+extern void cordic_rotate(long *xp, long *yp, f16_16 angle, int iters);
+
+/* sin and cos of 'angle' degrees (16.16) as 16.16 numbers, by CORDIC
+   rotation of (1, 0).  Either pointer may be NULL. */
+extern void cordic_sincos(f16_16 angle, int iters,
+			  f16_16 *sinp, f16_16 *cosp);
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Reporting for the fixed point overflow counters (see fixcheck.h).
+ */
+
+#include <stdio.h>
+#include "fixcheck.h"
+
+#ifdef FIXED_CHECK
+
+fixcheck_site_t *fixcheck_sites;
+
+void
+fixcheck_report(void)
+{
+  fixcheck_site_t *s;
+
+  printf ("%-16s %-20s %10s %10s %10s\n",
+	  "op", "where", "calls", "overflows", "saturated");
+  for (s = fixcheck_sites; s != NULL; s = s->next) {
+    char where[32];
+
+    snprintf(where, sizeof(where), "%s:%d", s->file, s->line);
+    printf ("%-16s %-20s %10lu %10lu %10lu%s\n", s->op, where,
+	    s->calls, s->overflows, s->saturations,
+	    s->overflows ? "  <--" : "");
+  }
+}
+
+void
+fixcheck_reset(void)
+{
+  fixcheck_site_t *s;
+
+  for (s = fixcheck_sites; s != NULL; s = s->next)
+    s->calls = s->overflows = s->saturations = 0;
+}
+
+#else /* FIXED_CHECK */
+
+void
+fixcheck_report(void)
+{
+  printf ("Fixed point checks not built in - build with -DFIXED_CHECK.\n");
+}
+
+void
+fixcheck_reset(void)
+{
+}
+
+#endif /* FIXED_CHECK */
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Fixed point overflow and saturation counters, for tuning.
+ *
+ * Build with -DFIXED_CHECK (see the Makefile) and every mult_f16_16(),
+ * mult_f16_16_sat(), div_f16_16(), div_f16_16_by() and mult_24_8()
+ * call, plus the integrators and output clamps in the motor task,
+ * keeps a count of how often it ran, how often the result didn't fit
+ * (and so wrapped), and how often it hit a limit.  There is one set of
+ * counts per call site, so a report says which line is running out of
+ * headroom.  The 'ovf' UI command prints them.
+ *
+ * Without FIXED_CHECK all of this compiles away to the plain
+ * operations.
+ */
+
+#ifndef _FIXCHECK_H
+#define _FIXCHECK_H
+
+#ifdef FIXED_CHECK
+
+#include <bsp.h>
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef struct fixcheck_site
+{
+  const char *op;
+  const char *file;
+  int line;
+  unsigned long calls;
+  unsigned long overflows;	/* result didn't fit, and wrapped */
+  unsigned long saturations;	/* result was clamped to a limit */
+  int listed;			/* on the fixcheck_sites list yet? */
+  struct fixcheck_site *next;
+} fixcheck_site_t;
+
+/**********************************************************************/
+/* Globals */
+/**********************************************************************/
+
+/* Every site that has run at least once. */
+extern fixcheck_site_t *fixcheck_sites;
+
+/**********************************************************************/
+/* Macros */
+/**********************************************************************/
+
+/* The counters for the call site this appears at. */
+#define FIXCHECK_SITE(_op)						\
+  ({ static fixcheck_site_t _fixcheck_site = { _op, __FILE__, __LINE__ }; \
+     &_fixcheck_site; })
+
+/* a + b for ints, counting it if the sum overflows. */
+#define FIXCHECK_ADD(a,b)						\
+  ({ int _fa = (a), _fb = (b);						\
+     int _fr = (int)((unsigned)_fa + (unsigned)_fb);			\
+     fixcheck_count(FIXCHECK_SITE("add"),				\
+		    ((_fa ^ _fr) & (_fb ^ _fr)) < 0, 0);		\
+     _fr; })
+
+/* Count a value being clamped to a limit. */
+#define FIXCHECK_SATURATED(_what)					\
+  fixcheck_count(FIXCHECK_SITE(_what), 0, 1)
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static inline void
+fixcheck_count(fixcheck_site_t *s, int overflowed, int saturated)
+{
+  rtems_interrupt_level level;
+
+  if (!s->listed) {
+    rtems_interrupt_disable(level);
+    if (!s->listed) {
+      s->next = fixcheck_sites;
+      fixcheck_sites = s;
+      s->listed = 1;
+    }
+    rtems_interrupt_enable(level);
+  }
+
+  s->calls++;
+  if (overflowed)
+    s->overflows++;
+  if (saturated)
+    s->saturations++;
+}
+
+#else /* FIXED_CHECK */
+
+#define FIXCHECK_ADD(a,b)		((a) + (b))
+#define FIXCHECK_SATURATED(_what)	do { } while (0)
+
+#endif /* FIXED_CHECK */
+
+/* Print the counts for every site that has run (or say the counters
+   aren't built in). */
+void fixcheck_report(void);
+
+/* Zero all the counts. */
+void fixcheck_reset(void);
+
+#endif /* _FIXCHECK_H */
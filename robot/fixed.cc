@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Compile-time checks that the C conversion macros in fixed.h agree
+ * with the fixed<> template, and that the template's constants match
+ * the ones the C code uses.  There's no code in here; if it builds,
+ * the checks passed.
+ */
+
+#include "fixed.h"
+
+/* Check each C conversion macro against the template at a value. */
+#define CHECK_CONV(from_t, to_t, c_macro, val)				\
+  static_assert(to_t(from_t::from_raw(val)).raw() == c_macro(val),	\
+		#c_macro " disagrees with fixed<>")
+
+#define CHECK_ALL_CONV(val)						\
+  CHECK_CONV(q24_8, q16_16, f16_16_from_f24_8, val);			\
+  CHECK_CONV(q18_14, q16_16, f16_16_from_f18_14, val);			\
+  CHECK_CONV(q16_16, q24_8, f24_8_from_f16_16, val);			\
+  CHECK_CONV(q18_14, q24_8, f24_8_from_f18_14, val);			\
+  CHECK_CONV(q16_16, q18_14, f18_14_from_f16_16, val);			\
+  CHECK_CONV(q24_8, q18_14, f18_14_from_f24_8, val)
+
+CHECK_ALL_CONV(0);
+CHECK_ALL_CONV(1);
+CHECK_ALL_CONV(-1);
+CHECK_ALL_CONV(127);
+CHECK_ALL_CONV(128);
+CHECK_ALL_CONV(-128);
+CHECK_ALL_CONV(16384);
+CHECK_ALL_CONV(-16383);
+CHECK_ALL_CONV(65535);
+CHECK_ALL_CONV(-65536);
+CHECK_ALL_CONV(1234567);
+CHECK_ALL_CONV(-7654321);
+
+/* The constants. */
+static_assert(q16_16::from_double(3.14159265358979).raw() == F16_16_PI,
+	      "F16_16_PI");
+static_assert(q16_16::one == 65536 && q24_8::one == 256 &&
+	      q18_14::one == 16384, "one");
+
+/* Arithmetic matches the C routines. */
+static_assert((q16_16::from_double(1.5) * q16_16::from_double(-2.25)).raw()
+	      == -3 * 65536 - 24576, "operator*");
+static_assert((q16_16::from_int(1) / q16_16::from_int(3)).raw() == 21845,
+	      "operator/");
+static_assert(q16_16(q18_14::from_int(1)) == q16_16::from_int(1),
+	      "conversion keeps the value");
@@ -0,0 +1,192 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * The fixed point formats used around the robot, and conversions
+ * between them.  All of them are 32 bits wide:
+ *
+ *   16.16 (f16_16) - angles, the kalman filter; see f16_16.h
+ *   24.8  (f24_8)  - motor velocities, accelerations, PID constants
+ *   18.14 (f18_14) - the isinof/icosof trig tables
+ *
+ * C code uses the conversion macros below.  C++ code gets the fixed<>
+ * template as well, which keeps each format a separate type so mixing
+ * them up is a compile error, and does every conversion at compile
+ * time.  fixed.cc checks the C macros against the template.
+ */
+
+#ifndef _FIXED_H
+#define _FIXED_H
+
+#include "f16_16.h"
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef long f24_8;
+typedef long f18_14;
+
+/**********************************************************************/
+/* Macros */
+/**********************************************************************/
+
+/* Conversions.  Going to more fraction bits is exact; going to fewer
+   rounds to the nearest value. */
+#define f16_16_from_f24_8(a)	((f16_16)(a) * 256)
+#define f16_16_from_f18_14(a)	((f16_16)(a) * 4)
+#define f24_8_from_f16_16(a)	(((f24_8)(a) + 128) >> 8)
+#define f24_8_from_f18_14(a)	(((f24_8)(a) + 32) >> 6)
+#define f18_14_from_f16_16(a)	(((f18_14)(a) + 2) >> 2)
+#define f18_14_from_f24_8(a)	((f18_14)(a) * 64)
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+/* Multiply two 24.8 numbers.  Rounds toward minus infinity, the same
+   as the long multiplication this used to be done with. */
+static inline f24_8
+mult_24_8(f24_8 a, f24_8 b)
+{
+  return (f24_8)(((long long)a * b) >> 8);
+}
+
+#ifdef FIXED_CHECK
+
+/* Checked mult_24_8() (see fixcheck.h). */
+static inline f24_8
+fixcheck_mult_24_8(f24_8 a, f24_8 b, fixcheck_site_t *s)
+{
+  long long p = ((long long)a * b) >> 8;
+
+  fixcheck_count(s, p != (long long)(int)p, 0);
+  return (mult_24_8)(a, b);
+}
+
+#define mult_24_8(a,b)							\
+  fixcheck_mult_24_8((a), (b), FIXCHECK_SITE("mult_24_8"))
+
+#endif /* FIXED_CHECK */
+
+#ifdef __cplusplus
+
+/**********************************************************************/
+/* C++ */
+/**********************************************************************/
+
+/* A fixed point number with IntBits integer bits (including the sign)
+   and FracBits fraction bits.  Everything is constexpr and inline, so
+   it compiles down to the same code as the C macros. */
+template <int IntBits, int FracBits>
+class fixed
+{
+  static_assert(IntBits + FracBits == 32, "fixed<> numbers are 32 bits");
+  static_assert(FracBits > 0 && FracBits < 31, "fixed<> needs fraction bits");
+
+public:
+  static constexpr int int_bits = IntBits;
+  static constexpr int frac_bits = FracBits;
+
+  /* 1.0 in this format. */
+  static constexpr long one = 1L << FracBits;
+
+  constexpr fixed() : v(0) {}
+
+  static constexpr fixed from_raw(long raw) { return fixed(raw, raw_tag()); }
+  static constexpr fixed from_int(long i) { return from_raw(i * one); }
+
+  /* Only for constants - on the robot this is soft float otherwise. */
+  static constexpr fixed
+  from_double(double d)
+  {
+    return from_raw((long)(d >= 0 ? d * one + 0.5 : d * one - 0.5));
+  }
+
+  /* Converting between formats has to be asked for; the shift is
+     worked out at compile time. */
+  template <int I2, int F2>
+  explicit constexpr fixed(fixed<I2, F2> a)
+    : v(F2 > FracBits ? shift_down(a.raw(), F2 - FracBits)
+			: shift_up(a.raw(), FracBits - F2)) {}
+
+  constexpr long raw() const { return v; }
+
+  /* Rounded to the nearest integer. */
+  constexpr long to_int() const { return (v + one / 2) >> FracBits; }
+
+  constexpr fixed operator-() const { return from_raw(-v); }
+  constexpr fixed operator+(fixed a) const { return from_raw(v + a.v); }
+  constexpr fixed operator-(fixed a) const { return from_raw(v - a.v); }
+
+  /* Same as mult_f16_16(): one widening multiply, rounded. */
+  constexpr fixed
+  operator*(fixed a) const
+  {
+    return from_raw((long)(((long long)v * a.v + one / 2) >> FracBits));
+  }
+
+  /* Same as div_f16_16(). */
+  constexpr fixed
+  operator/(fixed a) const
+  {
+    return from_raw((long)((((long long)v << FracBits) + a.v / 2) / a.v));
+  }
+
+  /* Scaling by a plain integer doesn't need any shifting. */
+  constexpr fixed operator*(long i) const { return from_raw(v * i); }
+  constexpr fixed operator/(long i) const { return from_raw(v / i); }
+
+  fixed &operator+=(fixed a) { v += a.v; return *this; }
+  fixed &operator-=(fixed a) { v -= a.v; return *this; }
+  fixed &operator*=(fixed a) { return *this = *this * a; }
+  fixed &operator/=(fixed a) { return *this = *this / a; }
+
+  constexpr bool operator==(fixed a) const { return v == a.v; }
+  constexpr bool operator!=(fixed a) const { return v != a.v; }
+  constexpr bool operator<(fixed a) const { return v < a.v; }
+  constexpr bool operator<=(fixed a) const { return v <= a.v; }
+  constexpr bool operator>(fixed a) const { return v > a.v; }
+  constexpr bool operator>=(fixed a) const { return v >= a.v; }
+
+private:
+  struct raw_tag {};
+
+  constexpr fixed(long raw, raw_tag) : v(raw) {}
+
+  static constexpr long
+  shift_down(long raw, int s)
+  {
+    return (raw + (1L << (s - 1))) >> s;
+  }
+
+  static constexpr long shift_up(long raw, int s) { return raw * (1L << s); }
+
+  long v;
+};
+
+typedef fixed<16, 16> q16_16;
+typedef fixed<24, 8> q24_8;
+typedef fixed<18, 14> q18_14;
+
+#endif /* __cplusplus */
+
+#endif /* _FIXED_H */
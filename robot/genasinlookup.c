@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/* Generates the lookup tables fastasin_f16_16() (in fastint.c) uses.
+ *
+ * asin_table: entry i is asin(i/256) in degrees, as a 16.16 number,
+ * for i from 0 to 128 - so the table covers sin values from 0 to 0.5,
+ * evenly spaced.
+ *
+ * asin_tail_table: covers sin values from 0.5 to 1, where asin gets
+ * steep.  It is indexed by u = 1 - x (as a 16.16 number), in octaves
+ * of u: u from 0 to 63 gets an entry per LSB, and each octave past
+ * that, [32 << j, 64 << j) for j from 1 to 9, gets 32 entries 2^j LSBs
+ * apart.  Entry (j << 5) + (u >> j) is asin(1 - u) for the u at the
+ * start of its step, so the routine only needs j to find its place.
+ *
+ * The routine interpolates between entries in both tables.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+#define ASIN_TABLE_STEPS	128
+#define ASIN_TAIL_ENTRIES	353
+
+static long
+deg_f16_16(double x)
+{
+  return (long) floor(asin(x) * 180 / M_PI * 65536 + 0.5);
+}
+
+/* The u (in 16.16 LSBs) that entry 'n' of asin_tail_table is for. */
+static long
+tail_u(int n)
+{
+  int j;
+
+  if (n < 64)
+    return n;
+  j = (n >> 5) - 1;
+  return (long)(n - (j << 5)) << j;
+}
+
+int
+main(void)
+{
+  int i;
+
+  printf ("static const f16_16 asin_table[%d] =\n{\n", ASIN_TABLE_STEPS + 1);
+  for (i = 0; i <= ASIN_TABLE_STEPS; i++)
+    {
+      if (i % 6 == 0)
+	printf ("  /* %3d */", i);
+      printf (" %ld,", deg_f16_16((double)i / (2 * ASIN_TABLE_STEPS)));
+      if (i % 6 == 5 || i == ASIN_TABLE_STEPS)
+	printf ("\n");
+    }
+  printf ("};\n\n");
+
+  printf ("static const f16_16 asin_tail_table[%d] =\n{\n", ASIN_TAIL_ENTRIES);
+  for (i = 0; i < ASIN_TAIL_ENTRIES; i++)
+    {
+      if (i % 6 == 0)
+	printf ("  /* %3d */", i);
+      printf (" %ld,", deg_f16_16(1.0 - tail_u(i) / 65536.0));
+      if (i % 6 == 5 || i == ASIN_TAIL_ENTRIES - 1)
+	printf ("\n");
+    }
+  printf ("};\n");
+
+  return 0;
+}
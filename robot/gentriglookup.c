@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/* Generates the isinof and icosof tables in fastint.c: the sin and
+ * cos of each whole degree from 0 to 359, in 18.14 format.  The
+ * values are truncated towards zero, the same as the robot used to
+ * do when it filled the tables in at boot.
+ */
+
+#include <stdio.h>
+#include <math.h>
+
+static void
+print_table(const char *name, double (*fn)(double))
+{
+  int i;
+  double t;
+
+  printf ("const int %s[360] =\n{\n", name);
+  for (i = 0; i < 360; i++)
+    {
+      t = M_PI / 180 * i;
+
+      if (i % 8 == 0)
+	printf ("  /* %3d */", i);
+      printf (" %d,", (int) (fn(t) * (1 << 14)));
+      if (i % 8 == 7)
+	printf ("\n");
+    }
+  printf ("};\n");
+}
+
+int
+main(void)
+{
+  print_table ("isinof", sin);
+  printf ("\n");
+  print_table ("icosof", cos);
+
+  return 0;
+}
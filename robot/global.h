@@ -28,6 +28,7 @@
 
 #include <bsp.h>
 #include "f16_16.h"
+#include "bam.h"
 
 /**********************************************************************/
 /* Constants */
@@ -108,24 +109,8 @@ rtems_interval ticks_per_sec;
 /* Functions */
 /**********************************************************************/
 
-static inline int
-fixup_angle_f16_16(f16_16 angle)
-{
-  if (angle < 0)
-    return ((360*65536) - ((-angle) % (360*65536)));
-  else
-    return (angle % (360*65536));
-}
-
-static inline int
-fixup_angle_24_8(int angle)
-{
-  if (angle < 0)
-    return ((360*256) - ((-angle) % (360*256)));
-  else
-    return (angle % (360*256));
-}
-
+/* Headings are bam32s (see bam.h), which wrap around by themselves.
+   This is only for the whole degree angles the IR arrays give. */
 static inline int
 fixup_angle(int angle)
 {
@@ -135,67 +120,5 @@ fixup_angle(int angle)
     return (angle % 360);
 }
 
-/* Returns the absolute difference between two headings in degress. */
-static inline int
-abs_dir_diff(int dir1, int dir2)
-{
-  int diff1, diff2;
-
-  diff1 = fixup_angle(dir1 - dir2);
-  diff2 = fixup_angle(dir2 - dir1);
-
-  if (diff1 < diff2)
-    return diff1;
-  else
-    return diff2;
-}
-
-/* Returns the absolute difference between two headings in degress. */
-static inline int
-abs_dir_diff_24_8(int dir1, int dir2)
-{
-  int diff1, diff2;
-
-  diff1 = fixup_angle_24_8(dir1 - dir2);
-  diff2 = fixup_angle_24_8(dir2 - dir1);
-
-  if (diff1 < diff2)
-    return diff1;
-  else
-    return diff2;
-}
-
-/* Returns the absolute difference between two headings in degress. */
-static inline int
-abs_dir_diff_f16_16(f16_16 dir1, f16_16 dir2)
-{
-  f16_16 diff1, diff2;
-
-  diff1 = fixup_angle_f16_16(dir1 - dir2);
-  diff2 = fixup_angle_f16_16(dir2 - dir1);
-
-  if (diff1 < diff2)
-    return diff1;
-  else
-    return diff2;
-}
-
-static inline int
-leftmost_angle(int a1, int a2)
-{
-  int diff1, diff2;
-
-  diff1 = fixup_angle(a1 - a2);
-  diff2 = fixup_angle(a2 - a1);
-
-  /* diff1 is how many degrees we would have to add to a2 to get a1,
-     diff2 is how many degrees we would have to add to a1 to get a2.
-     If diff1 is smaller, then a2 is to the left of a1. */
-  if (diff1 < diff2)
-    return a2;
-  else
-    return a1;
-}
-
 
 #endif /* _GLOBAL_H */
@@ -30,10 +30,11 @@
 #include <sim.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
 #include "global.h"
 #include "gyro.h"
 #include "f16_16.h"
+#include "control.h"
+#include "prof.h"
 
 /**********************************************************************/
 /* Constants */
@@ -118,12 +119,31 @@ read_atod(int channel)
   return in;
 }
 
+/* Take one reading of each gyro: the sense step of the control
+   chain. */
+void
+gyro_sample(void)
+{
+  gyro_last_x = read_atod(GYRO_X_ATOD);
+  gyro_last_z = read_atod(GYRO_Z_ATOD);
+  control_mark_sample();
+
+  if (gyro_calibrating) {
+    gyro_x_vals[gyro_cal_cnt] = gyro_last_x;
+    gyro_z_vals[gyro_cal_cnt] = gyro_last_z;
+    if (++gyro_cal_cnt >= GYRO_HZ*gyro_calibrate_seconds)
+      gyro_calibrating = 0;
+  }
+}
+
+#ifdef CONTROL_SEPARATE_TASKS
 rtems_task
 gyro_task(rtems_task_argument ignored)
 {
   rtems_name period_name;
   rtems_id period;
   rtems_status_code status;
+  PROF_DECL(t);
 
   period_name = rtems_build_name ('G', 'Y', 'P', 'D');
   status = rtems_rate_monotonic_create (period_name, &period);
@@ -143,30 +163,30 @@ gyro_task(rtems_task_argument ignored)
 	     our next timeout, until the end of time... */
 	  gyro_timeouts++;
 	}
+      PROF_START(t);
 
-      gyro_last_x = read_atod(GYRO_X_ATOD);
-      gyro_last_z = read_atod(GYRO_Z_ATOD);
-
-      if (gyro_calibrating) {
-	gyro_x_vals[gyro_cal_cnt] = gyro_last_x;
-	gyro_z_vals[gyro_cal_cnt] = gyro_last_z;
-	if (++gyro_cal_cnt >= GYRO_HZ*gyro_calibrate_seconds)
-	  gyro_calibrating = 0;
-      }
+      gyro_sample();
+      PROF_SINCE(PROF_GYRO, t);
     }
 }
+#endif
 
 /* Initialize the gyro library.  Returns 0 on success, non-zero on
    error. */
 int
 gyro_init(void)
 {
+#ifdef CONTROL_SEPARATE_TASKS
   rtems_status_code code;
   Objects_Id t1;
+#endif
 
   gyro_x_neutral = GYRO_X_NEUTRAL_DEFAULT;
   gyro_z_neutral = GYRO_Z_NEUTRAL_DEFAULT;
 
+#ifndef CONTROL_SEPARATE_TASKS
+  control_register(CONTROL_SENSE, "gyro", gyro_sample);
+#else
   printf ("Spawning gyro task:\n");
   code = rtems_task_create(rtems_build_name('G', 'Y', 'R', 'O'),
 			   10, RTEMS_MINIMUM_STACK_SIZE * 2,
@@ -176,6 +196,7 @@ gyro_init(void)
   printf ("  rtems_task_create returned %d; t1 = 0x%08x\n", code, t1);
   code = rtems_task_start(t1, gyro_task, 0);
   printf ("Done. (rtems_task_start returned %d)\n\n", code);
+#endif
 
   return 0;
 }
@@ -37,14 +37,25 @@
 #include <time.h>
 #include <math.h>
 
+/* imu_compare.c builds this file with IMU_NO_MAIN, sets dt and Q
+   itself, and may work out theta_m in other units. */
+#ifdef IMU_NO_MAIN
+#define IMU_CONST
+#else
+#define IMU_CONST	const
+#endif
+#ifndef IMU_THETA_M
+#define IMU_THETA_M(ax, ay)	atan2( -(ay), (ax) )
+#endif
+
 typedef long f16_16;
 
 #define		pi		  205887	/* 3.14159 as a 16.16 fixed */
-const f16_16	dt		= 2185;		/* 1/30 as a 16.16 fixed
+IMU_CONST f16_16 dt		= 2185;		/* 1/30 as a 16.16 fixed
 						   (30 Hz sensor update) */
 const f16_16	omega		= 32768;	/* 0.5 as a 16.16 fixed
 						   (Max roll rate) */
-const f16_16	Q		= 66;		/* 0.001 as a 16.16 fixed
+IMU_CONST f16_16 Q		= 66;		/* 0.001 as a 16.16 fixed
 						   (Noise weighting matrix) */
 const f16_16	max_angle	= 34315;	/* 30*pi/180.0 as a 16.16 fixed
 						   (Maximum pitch angle) */
@@ -80,10 +91,13 @@ mult_f16_16(f16_16 a, f16_16 b)
   b_frac = b & 0x0000ffff;
   b_int  = (b & 0xffff0000) / 65536;
 
-  return (((unsigned)(a_frac * b_frac) >> 16) +
-	  (a_frac * b_int) +
-	  (a_int * b_frac) +
-	  ((a_int * b_int) << 16)) * sign;
+  /* The sum is unsigned; make it an int before the sign goes on, or
+     a negative product turns into a huge positive one wherever longs
+     are 64 bits. */
+  return (int)(((unsigned)(a_frac * b_frac) >> 16) +
+	       (a_frac * b_int) +
+	       (a_int * b_frac) +
+	       ((a_int * b_int) << 16)) * sign;
 #else
 	int a_frac = a & 0x0000ffff;
 	int a_int  = (int) (a & 0xffff0000) / 65536;
@@ -113,7 +127,7 @@ print_f16_16(f16_16 a)
 		printf ("-");
 		a = -a;
 	}
-	printf("%d.%04d", a / 65536, ((a % 65536) * 10000) / 65536);
+	printf("%d.%04d", (int)(a / 65536), (int)(((a % 65536) * 10000) / 65536));
 }
 
 double
@@ -154,7 +168,7 @@ kalman(
 		return theta;
 
 	/* Compute our measured state from the accelerometers */
-	theta_m = f16_16_from_double(atan2( -ay, ax ));
+	theta_m = f16_16_from_double(IMU_THETA_M( ax, ay ));
 
 	E = add_f16_16 (P, R);				/* E = CPC' + R */
 	K = div_f16_16 (P, E);				/* K = PC'inv(E) */
@@ -177,6 +191,7 @@ noise( void )
 }
 
 
+#ifndef IMU_NO_MAIN
 int main( void )
 {
 	f16_16 t;
@@ -254,3 +269,4 @@ int main( void )
 
 	return 0;
 }
+#endif
@@ -37,10 +37,21 @@
 #include <time.h>
 #include <math.h>
 
+/* imu_compare.c builds this file with IMU_NO_MAIN, sets dt and Q
+   itself, and may work out theta_m in other units. */
+#ifdef IMU_NO_MAIN
+#define IMU_CONST
+#else
+#define IMU_CONST	const
+#endif
+#ifndef IMU_THETA_M
+#define IMU_THETA_M(ax, ay)	atan2( -(ay), (ax) )
+#endif
+
 #define		pi		  3.14159
-const double	dt		= 1.0 / 30.0;	/* 30 Hz sensor update */
+IMU_CONST double dt		= 1.0 / 30.0;	/* 30 Hz sensor update */
 const double	omega		= 0.5;		/* Max roll rate */
-const double	Q		= 0.001;	/* Noise weighting matrix */
+IMU_CONST double Q		= 0.001;	/* Noise weighting matrix */
 const double	max_angle	= 30*pi/180.0;	/* Maximum pitch angle */
 static double	theta		= 4*pi/180;	/* Our initial state estimate */
 static double	R		= 1;		/* Measurement error weight */
@@ -73,7 +84,7 @@ kalman(
 		return theta;
 
 	/* Compute our measured state from the accelerometers */
-	theta_m = atan2( -ay, ax );
+	theta_m = IMU_THETA_M( ax, ay );
 
 	E = P + R;				/* E = CPC' + R */
 	K = P / E;				/* K = PC'inv(E) */
@@ -95,6 +106,7 @@ noise( void )
 }
 
 
+#ifndef IMU_NO_MAIN
 int main( void )
 {
 	double			t;
@@ -135,3 +147,4 @@ int main( void )
 
 	return 0;
 }
+#endif
@@ -0,0 +1,396 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Runs the robot's kalman() (../kalman.c) and the two reference
+ * filters in this directory - imu-1d.c in floating point and
+ * imu-1d-fixed.c, the first fixed point port - over the same
+ * gyro/accelerometer data, with kalman.c's Q, R, update rates and
+ * starting covariance, and reports for each:
+ *
+ *   ns/update - host time per gyro reading.
+ *   max/rms diff - how far, per sample, it strays from the floating
+ *		point filter, in degrees.
+ *   rms/mean err - steady state error against the real tilt, in
+ *		degrees, after the first few seconds (made up data only).
+ *
+ * The floating point filter is the same math with no rounding, so
+ * kalman.c's diff is what the fixed point (and whatever speedups are
+ * turned on: KALMAN_STEADY_GAIN, KALMAN_FAST_DIV, fastasin_f16_16())
+ * costs.  Exits non-zero if that's more than MAX_RMS_DIFF, or if
+ * kalman.c tracks the real tilt noticeably worse than the floating
+ * point filter, so it can be run after changing kalman.c's math.
+ *
+ * usage: imu_compare [-l log] [file...]
+ *
+ * Files are recordings from the robot's 'krec' command.  With none,
+ * makes up three sets of data (still, rocking and fast).  -l writes
+ * every sample, for plotting:
+ *   time truth float fixed kalman.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+#include "f16_16.h"
+#include "fastint.h"
+#include "kalman.h"
+#include "imu_ref.h"
+
+/**********************************************************************/
+/* Constants */
+/**********************************************************************/
+
+/* These match kalman.c. */
+#define UPDATE_HZ	250
+#define KALMAN_HZ	10
+#define P_INIT		6553600		/* 100 */
+
+#define MAX_SETS	16
+#define MAX_SAMPLES	(600 * UPDATE_HZ)
+#define SYNTH_SECONDS	60
+#define SETTLE_SECONDS	5
+#define TIMING_REPS	20
+
+/* How far kalman.c may stray from the floating point filter (rms,
+   degrees), and how much worse than it (as a fraction, plus a
+   constant in degrees) it may track the real tilt.  kalman.c starts
+   out about 0.08 degrees rms away: rounding in its 16.16 covariance
+   update leaves the gain settled at 0.1017 rather than 0.0951, so it
+   pulls a biased gyro back a little harder than the exact math. */
+#define MAX_RMS_DIFF	0.15
+#define MAX_ERR_RATIO	1.10
+#define MAX_ERR_SLACK	0.01
+
+enum { IMPL_FLOAT, IMPL_FIXED, IMPL_KALMAN, NUM_IMPLS };
+
+static const char *impl_names[NUM_IMPLS] = {
+  "imu-1d.c (float)", "imu-1d-fixed.c", "kalman.c"
+};
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef struct data_set
+{
+  char name[64];
+  f16_16 *gyro;		/* degrees/second */
+  f16_16 *accel;	/* g, along the robot */
+  double *truth;	/* degrees, made up data only */
+  int n;
+} data_set_t;
+
+typedef struct result
+{
+  double ns;
+  double max_diff, rms_diff;
+  double rms_err, mean_err;
+} result_t;
+
+/**********************************************************************/
+/* Globals */
+/**********************************************************************/
+
+/* kalman.c's constants. */
+extern const f16_16 dt, Q;
+extern f16_16 R;
+
+static data_set_t sets[MAX_SETS];
+static int num_sets;
+
+static double *out[NUM_IMPLS];
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static double
+noise(double sd)
+{
+  double sum = 0;
+  int i;
+
+  for (i = 0; i < 12; i++)
+    sum += (double)bench_rand() / 4294967296.0;
+  return (sum - 6.0) * sd;
+}
+
+static data_set_t *
+new_set(const char *name, int n, int with_truth)
+{
+  data_set_t *d;
+
+  if (num_sets >= MAX_SETS) {
+    fprintf (stderr, "%s: too many data sets\n", name);
+    exit (1);
+  }
+  d = &sets[num_sets++];
+  strncpy(d->name, name, sizeof(d->name) - 1);
+  d->gyro = malloc(n * sizeof(f16_16));
+  d->accel = malloc(n * sizeof(f16_16));
+  d->truth = with_truth ? malloc(n * sizeof(double)) : NULL;
+  d->n = 0;
+  if (d->gyro == NULL || d->accel == NULL || (with_truth && !d->truth)) {
+    fprintf (stderr, "out of memory\n");
+    exit (1);
+  }
+  return d;
+}
+
+/* A minute of tilting 'amp' degrees at 'hz' around 'offset' degrees,
+   with gyro and accelerometer noise and a gyro bias that drifts up to
+   'bias' degrees/second as the gyro warms up. */
+static void
+make_set(const char *name, double offset, double amp, double hz, double bias)
+{
+  data_set_t *d = new_set(name, SYNTH_SECONDS * UPDATE_HZ, 1);
+  double t, angle, rate, b;
+  int i;
+
+  for (i = 0; i < SYNTH_SECONDS * UPDATE_HZ; i++) {
+    t = (double)i / UPDATE_HZ;
+    angle = offset + amp * sin(2 * M_PI * hz * t);
+    rate = amp * 2 * M_PI * hz * cos(2 * M_PI * hz * t);
+    b = bias * (1.0 - exp(-t / 15.0));
+
+    d->truth[i] = angle;
+    d->gyro[i] = (f16_16)lrint((rate + b + noise(0.3)) * 65536.0);
+    d->accel[i] = (f16_16)lrint((sin(angle * M_PI / 180) + noise(0.02)) *
+				65536.0);
+  }
+  d->n = i;
+}
+
+/* Reads what kalman_dump_record() printed. */
+static int
+read_set(const char *name)
+{
+  FILE *f;
+  data_set_t *d;
+  char line[200];
+  long g, a;
+
+  f = fopen(name, "r");
+  if (f == NULL) {
+    perror(name);
+    return 0;
+  }
+  d = new_set(name, MAX_SAMPLES, 0);
+  while (fgets(line, sizeof(line), f) != NULL && d->n < MAX_SAMPLES)
+    if (line[0] != '#' && sscanf(line, "%ld %ld", &g, &a) == 2) {
+      d->gyro[d->n] = (f16_16)g;
+      d->accel[d->n] = (f16_16)a;
+      d->n++;
+    }
+  fclose(f);
+
+  if (d->n <= SETTLE_SECONDS * UPDATE_HZ) {
+    fprintf (stderr, "%s: recording too short\n", name);
+    return 0;
+  }
+  return 1;
+}
+
+static f16_16
+clamp_accel(f16_16 a)
+{
+  if (a > 65536)
+    return 65536;
+  if (a < -65536)
+    return -65536;
+  return a;
+}
+
+/* Runs one of the filters over 'd', leaving its angle for each
+   sample in 'o' (degrees). */
+static void
+run_impl(int impl, const data_set_t *d, double *o)
+{
+  kalman_state_t s;
+  f16_16 theta_m = 0;
+  double a, ax, ay;
+  int i, cnt = 0, do_kalman;
+
+  kalman_state_init(&s);
+  /* kalman.c's dt is 1/UPDATE_HZ rounded to a 16.16; give the float
+     filter the same one, so the diff is down to the arithmetic. */
+  imu_float_reset(0, P_INIT / 65536.0, Q / 65536.0, R / 65536.0,
+		  dt / 65536.0);
+  imu_fixed_reset(0, P_INIT, Q, R, dt);
+
+  for (i = 0; i < d->n; i++) {
+    do_kalman = (++cnt == UPDATE_HZ/KALMAN_HZ);
+    if (do_kalman)
+      cnt = 0;
+
+    switch (impl) {
+    case IMPL_KALMAN:
+      /* Just like kalman_step(). */
+      if (do_kalman)
+	theta_m = fastasin_f16_16(clamp_accel(d->accel[i]));
+      o[i] = kalman(&s, d->gyro[i], theta_m, do_kalman) / 65536.0;
+      break;
+
+    default:
+      /* The reference filters take the angle from two accelerometer
+	 axes; make up the other one. */
+      a = clamp_accel(d->accel[i]) / 65536.0;
+      ax = sqrt(1.0 - a * a);
+      ay = -a;
+      if (impl == IMPL_FLOAT)
+	o[i] = imu_float_step(d->gyro[i] / 65536.0, ax, ay, do_kalman);
+      else
+	o[i] = imu_fixed_step(d->gyro[i], ax, ay, do_kalman) / 65536.0;
+      break;
+    }
+  }
+}
+
+static void
+compare(const data_set_t *d, result_t *res)
+{
+  int impl, i, rep, n;
+  double t0, t1, diff, err, sum_sq, sum, max;
+
+  for (impl = 0; impl < NUM_IMPLS; impl++) {
+    result_t *r = &res[impl];
+
+    t0 = bench_now_ns();
+    for (rep = 0; rep < TIMING_REPS; rep++)
+      run_impl(impl, d, out[impl]);
+    t1 = bench_now_ns();
+    r->ns = (t1 - t0) / ((double)TIMING_REPS * d->n);
+
+    /* Every sample counts towards the divergence. */
+    sum_sq = max = 0;
+    for (i = 0; i < d->n; i++) {
+      diff = fabs(out[impl][i] - out[IMPL_FLOAT][i]);
+      sum_sq += diff * diff;
+      if (diff > max)
+	max = diff;
+    }
+    r->max_diff = max;
+    r->rms_diff = sqrt(sum_sq / d->n);
+
+    /* The error only once the filter has settled. */
+    r->rms_err = r->mean_err = 0;
+    if (d->truth != NULL) {
+      sum = sum_sq = 0;
+      n = 0;
+      for (i = SETTLE_SECONDS * UPDATE_HZ; i < d->n; i++) {
+	err = out[impl][i] - d->truth[i];
+	sum += err;
+	sum_sq += err * err;
+	n++;
+      }
+      r->rms_err = sqrt(sum_sq / n);
+      r->mean_err = sum / n;
+    }
+  }
+}
+
+static void
+write_log(FILE *f, const data_set_t *d)
+{
+  int i;
+
+  fprintf (f, "# %s\n", d->name);
+  for (i = 0; i < d->n; i++)
+    fprintf (f, "%.3f %.5f %.5f %.5f %.5f\n", (double)i / UPDATE_HZ,
+	     d->truth ? d->truth[i] : 0.0, out[IMPL_FLOAT][i],
+	     out[IMPL_FIXED][i], out[IMPL_KALMAN][i]);
+  fprintf (f, "\n\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  result_t res[NUM_IMPLS];
+  FILE *log = NULL;
+  int i, k, max_n = 0, ok = 1;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      log = fopen(argv[++i], "w");
+      if (log == NULL) {
+	perror(argv[i]);
+	return 1;
+      }
+    } else if (!read_set(argv[i]))
+      return 1;
+  }
+  if (num_sets == 0) {
+    make_set("still", 2.0, 0.2, 0.3, 1.5);
+    make_set("rocking", 0.0, 3.0, 0.7, 1.5);
+    make_set("fast", 0.0, 8.0, 2.0, 1.5);
+  }
+
+  for (k = 0; k < num_sets; k++)
+    if (sets[k].n > max_n)
+      max_n = sets[k].n;
+  for (i = 0; i < NUM_IMPLS; i++)
+    out[i] = malloc(max_n * sizeof(double));
+
+  printf ("Q %.4f  R %.4f  %d Hz gyro, %d Hz kalman\n", Q / 65536.0,
+	  R / 65536.0, UPDATE_HZ, KALMAN_HZ);
+
+  for (k = 0; k < num_sets; k++) {
+    const data_set_t *d = &sets[k];
+
+    compare(d, res);
+    if (log != NULL)
+      write_log(log, d);
+
+    printf ("\n%s: %d samples\n", d->name, d->n);
+    printf ("  %-18s %9s %9s %9s", "", "ns/update", "max diff", "rms diff");
+    if (d->truth != NULL)
+      printf (" %9s %9s", "rms err", "mean err");
+    printf ("\n");
+    for (i = 0; i < NUM_IMPLS; i++) {
+      printf ("  %-18s %9.1f %9.4f %9.4f", impl_names[i], res[i].ns,
+	      res[i].max_diff, res[i].rms_diff);
+      if (d->truth != NULL)
+	printf (" %9.4f %9.4f", res[i].rms_err, res[i].mean_err);
+      printf ("\n");
+    }
+
+    if (res[IMPL_KALMAN].rms_diff > MAX_RMS_DIFF) {
+      printf ("  kalman.c is %.4f degrees rms from the float filter "
+	      "(limit %.4f)\n", res[IMPL_KALMAN].rms_diff, MAX_RMS_DIFF);
+      ok = 0;
+    }
+    if (d->truth != NULL &&
+	res[IMPL_KALMAN].rms_err >
+	res[IMPL_FLOAT].rms_err * MAX_ERR_RATIO + MAX_ERR_SLACK) {
+      printf ("  kalman.c tracks the tilt worse than the float filter\n");
+      ok = 0;
+    }
+  }
+
+  if (log != NULL)
+    fclose(log);
+
+  printf ("\n%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
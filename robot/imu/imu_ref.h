@@ -0,0 +1,52 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * The two reference filters in this directory - imu-1d.c (floating
+ * point) and imu-1d-fixed.c (the first fixed point port) - built as
+ * functions imu_compare.c can call side by side with kalman.c.
+ *
+ * Both are set up to work in degrees, like kalman.c: the gyro rate
+ * is degrees/second and theta_m is worked out in degrees from the
+ * accelerometer.  Each call is one gyro reading; 'do_kalman' says
+ * whether to run the measurement update too.
+ */
+
+#ifndef _IMU_REF_H
+#define _IMU_REF_H
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+/* imu-1d.c: start over with angle 'theta' and covariance 'P', using
+   weights 'Q' and 'R' and time step 'dt' (seconds). */
+void imu_float_reset(double theta, double P, double Q, double R, double dt);
+
+/* imu-1d.c: one step.  'ax' and 'ay' are the accelerometer readings
+   (in g) along and across the robot.  Returns the angle. */
+double imu_float_step(double q, double ax, double ay, int do_kalman);
+
+/* imu-1d-fixed.c: the same, with 16.16 numbers. */
+void imu_fixed_reset(long theta, long P, long Q, long R, long dt);
+long imu_fixed_step(long q, double ax, double ay, int do_kalman);
+
+#endif /* _IMU_REF_H */
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * imu-1d-fixed.c built as a library for imu_compare.c.  Its globals
+ * and math routines are renamed so they don't collide with kalman.c
+ * and f16_16.c.
+ */
+
+#define IMU_NO_MAIN
+#define IMU_THETA_M(ax, ay)	(atan2(-(ay), (ax)) * 180.0 / M_PI)
+#define dt		imu_fixed_dt
+#define Q		imu_fixed_Q
+#define omega		imu_fixed_omega
+#define max_angle	imu_fixed_max_angle
+#define kalman		imu_fixed_kalman
+#define mult_f16_16	imu_fixed_mult_f16_16
+#define div_f16_16	imu_fixed_div_f16_16
+#define print_f16_16	imu_fixed_print_f16_16
+#define double_from_f16_16 imu_fixed_double_from_f16_16
+#define f16_16_from_double imu_fixed_f16_16_from_double
+
+#include "imu-1d-fixed.c"
+#include "imu_ref.h"
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+void
+imu_fixed_reset(long theta0, long P0, long q, long r, long step)
+{
+  theta = theta0;
+  P = P0;
+  Q = q;
+  R = r;
+  dt = step;
+}
+
+/* kalman() decides whether to run the update from the time: it runs
+   when the time is a multiple of 0.1 seconds (0.05 is 3277). */
+long
+imu_fixed_step(long q, double ax, double ay, int do_kalman)
+{
+  return kalman(do_kalman ? 0 : 3277, q, ax, ay);
+}
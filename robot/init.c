@@ -51,6 +51,9 @@
 #include "fastint.h"
 #include "robot_trace.h"
 #include "tone.h"
+#include "fixcheck.h"
+#include "prof.h"
+#include "control.h"
 
 #include <qsm.h>
 
@@ -136,6 +139,7 @@ int ir_angles[8] = { -27, -20, -12, -4, 4, 12, 20, 27 };
  * 0 -> theta_m
  * 1 -> gyro_only
  * 2 -> desired_tilt
+ * 3 -> gyro bias (two state kalman filter only)
  */
 #define KALMAN_SECOND_LINE 2
 
@@ -158,7 +162,7 @@ lcd_task (rtems_task_argument ignored)
   int num_samples;
   int retval, dist, angle;
   int hi_l, hi_r;
-  int heading;
+  bam32 heading;
   int gyro_x, gyro_z;
   int accel, accel_raw;
   unsigned int tone_raw;
@@ -167,6 +171,7 @@ lcd_task (rtems_task_argument ignored)
   int accel_raw_avg = 0;
 #endif
   int kalman;
+  kalman_snapshot_t snap;
 #if KALMAN_SECOND_LINE == 2
   extern int32 mot_desired_tilt;
 #endif
@@ -213,8 +218,8 @@ lcd_task (rtems_task_argument ignored)
 
 	case LCD_HEADING:
 	  heading = mot_get_heading();
-	  sprintf(buf, "Mot Heading: %3d.%02d    ", heading / 256,
-		  (heading % 256) * 100 / 256);
+	  sprintf(buf, "Mot Heading: %3d.%02d    ", bam32_deg(heading),
+		  bam32_hundredths(heading));
 	  if (strlen(buf) < 20)
 	    strncat(buf, spaces, 20 - strlen(buf));
 	  lcd_string(0, buf);
@@ -305,7 +310,7 @@ lcd_task (rtems_task_argument ignored)
 	case LCD_CANDLE:
 	  retval = find_candle(&dist, &angle, &hi_l, &hi_r);
 	  if (retval == 0)
-	    sprintf(buf, "%3d %3d %03x %03x", dist, angle, hi_l, hi_r);
+	    sprintf(buf, "%3d %3d %03x %03x", dist, angle / 256, hi_l, hi_r);
 	  else if (retval == 1)
 	    sprintf(buf, "far left %03x %03x", hi_l, hi_r);
 	  else if (retval == 2)
@@ -361,7 +366,8 @@ lcd_task (rtems_task_argument ignored)
 	  break;
 
 	case LCD_KALMAN:
-	  kalman = kalman_read();
+	  kalman_get_snapshot(&snap);
+	  kalman = snap.theta;
 	  sprintf(buf, "kalman: %c%d.%02d", kalman < 0 ? '-' : ' ',
 		  abs(kalman) / 65536,
 		  abs((kalman % 65536) * 100 / 65536));
@@ -369,12 +375,12 @@ lcd_task (rtems_task_argument ignored)
 	    strncat(buf, spaces, 20 - strlen(buf));
 	  lcd_string(0, buf);
 #if KALMAN_SECOND_LINE == 0
-	  kalman = kalman_read_theta_m();
+	  kalman = snap.theta_m;
 	  sprintf(buf, "theta_m: %c%d.%02d", kalman < 0 ? '-' : ' ',
 		  abs(kalman) / 65536,
 		  abs((kalman % 65536) * 100 / 65536));
 #elif KALMAN_SECOND_LINE == 1
-	  kalman = kalman_read_gyro_only();
+	  kalman = snap.gyro_only_theta;
 	  sprintf(buf, "gyro_only: %c%d.%02d", kalman < 0 ? '-' : ' ',
 		  abs(kalman) / 65536,
 		  abs((kalman % 65536) * 100 / 65536));
@@ -383,6 +389,11 @@ lcd_task (rtems_task_argument ignored)
 		  mot_desired_tilt < 0 ? '-' : ' ',
 		  abs(mot_desired_tilt) / 256,
 		  abs((mot_desired_tilt % 256) * 100 / 256));
+#elif KALMAN_SECOND_LINE == 3
+	  kalman = snap.bias;
+	  sprintf(buf, "bias: %c%d.%02d", kalman < 0 ? '-' : ' ',
+		  abs(kalman) / 65536,
+		  abs((kalman % 65536) * 100 / 65536));
 #else
 	  strcpy (buf, "problem in init.c");
 #endif
@@ -442,7 +453,7 @@ demo_task(rtems_task_argument which_demo)
   uint32 ticks;
   mot_status_t m0;
   int count = 0;
-  int heading;
+  bam32 heading;
   int i;
 
   while (1) {
@@ -473,13 +484,9 @@ demo_task(rtems_task_argument which_demo)
 	    }
 
 	  printf ("Turning left 90 degrees.\n");
-	  heading -= 90 * 256;
-	  while (heading < 0)
-	    heading += 360 * 256;
-	  if (heading > 360 * 256)
-	    heading %= 360 * 256;
-	  printf ("  to heading %d.%02d\n", heading/256,
-		  (heading % 256) * 1000 / 256);
+	  heading -= BAM32_DEG(90);
+	  printf ("  to heading %d.%02d\n", bam32_deg(heading),
+		  bam32_hundredths(heading));
 	  robot_turn_to(heading);
 
 	  printf ("Done turning.\n");
@@ -623,6 +630,7 @@ ui_help(void)
   printf ("\n");
   printf ("acc - set acceleration (steps/tick/tick)\n");
   printf ("vel - set velocity (steps/tick)\n");
+  printf ("jerk - set the S-curve acceleration ramp (ticks, 0 for trapezoids)\n");
   printf ("steps - set # of steps to move\n");
   printf ("go - tell motors to move\n");
   printf ("hvel - set heading velocity (degrees/second)\n");
@@ -636,6 +644,14 @@ ui_help(void)
   printf ("gsnz - set gyro Z neutral value.\n");
   printf ("gc - calibrate gyros.\n");
   printf ("rt - dump robot trace buffer.\n");
+  printf ("est - show tilt estimators' cost and lag (est N switches to number N).\n");
+  printf ("kc - set complementary filter gain (16.16).\n");
+  printf ("kr - set kalman filter measurement error weight R (16.16).\n");
+  printf ("krec - dump recorded kalman filter input (krec 1 starts recording).\n");
+  printf ("ctl - show control chain, sample to motor latency and missed ticks (ctl 1 also clears).\n");
+  printf ("ovf - print fixed point overflow counts (ovf 1 also clears them).\n");
+  printf ("seg - print the motion segment queue (seg 1 also flushes it).\n");
+  printf ("prof - print periodic task pass overruns (prof 1 also clears them).\n");
   printf ("There are about %d steps to an inch, 100 ticks per second\n",
 	  MOT_STEPS_PER_INCH);
   printf ("\n");
@@ -776,7 +792,7 @@ ui_task (rtems_task_argument ignored)
       else if (strcmp(cmd, "head") == 0)
 	{
 	  printf ("Turning to heading %d\n", val % 360);
-	  mot_set_heading((val % 360) * 256, heading_vel*256);
+	  mot_set_heading(BAM32_DEG(val % 360), heading_vel*256);
 	}
       else if (strcmp(cmd, "bal") == 0)
 	{
@@ -820,6 +836,18 @@ ui_task (rtems_task_argument ignored)
 	      printf ("Set vel to %d\n", vel);
 	    }
 	}
+      else if (strcmp(cmd, "jerk") == 0)
+	{
+	  if (sval == NULL || val < 0 || val > MOT_JERK_MAX)
+	    {
+	      printf ("jerk is %ld (0 to %d)\n", robot_jerk, MOT_JERK_MAX);
+	    }
+	  else
+	    {
+	      robot_jerk = val;
+	      printf ("Set jerk to %ld\n", robot_jerk);
+	    }
+	}
       else if (strcmp(cmd, "hvel") == 0)
 	{
 	  if (val == 0)
@@ -836,15 +864,15 @@ ui_task (rtems_task_argument ignored)
 	{
 	  if (steps == 0)
 	    {
-	      printf ("Calling mot_set_vel(0x%x, 0x%x, mot_get_ticks()+2)\n",
-		      acc, vel);
-	      mot_set_vel(acc, vel, mot_get_ticks()+2);
+	      printf ("Calling mot_set_vel_jerk(0x%x, 0x%x, %ld, "
+		      "mot_get_ticks()+2)\n", acc, vel, robot_jerk);
+	      mot_set_vel_jerk(acc, vel, robot_jerk, mot_get_ticks()+2);
 	    }
 	  else
 	    {
-	      printf ("Calling mot_move(0x%x, 0x%x, 0x%x, mot_get_ticks()+2)\n",
-		      steps, acc, vel);
-	      mot_move(steps, acc, vel, mot_get_ticks()+2);
+	      printf ("Calling mot_move_jerk(0x%x, 0x%x, 0x%x, %ld, "
+		      "mot_get_ticks()+2)\n", steps, acc, vel, robot_jerk);
+	      mot_move_jerk(steps, acc, vel, robot_jerk, mot_get_ticks()+2);
 	    }
 	}
       else if (strcmp(cmd, "steps") == 0)
@@ -932,6 +960,56 @@ ui_task (rtems_task_argument ignored)
 	  printf ("gyro Z neutral: %d.%02d (%d)\n", z / 65536,
 		  abs(((z % 65536) * 100) / 65536), z);
 	}
+      else if (strcmp(cmd, "est") == 0)
+	{
+	  if (val == 0)
+	    kalman_engines_report();
+	  else if (kalman_select(val - 1) != 0)
+	    printf ("No estimator %d - type est to list them.\n", val);
+	  printf ("Running %s.\n", kalman_engines[kalman_selected()].name);
+	}
+      else if (strcmp(cmd, "kc") == 0)
+	{
+	  if (val > 0 && val <= 65536)
+	    kalman_set_comp_k(val);
+	  printf ("complementary filter gain is 0x%08x\n",
+		  (int)kalman_get_comp_k());
+	}
+      else if (strcmp(cmd, "kr") == 0)
+	{
+	  if (val > 0)
+	    kalman_set_R(val);
+	  printf ("kalman R is 0x%08x\n", (int)kalman_get_R());
+	}
+      else if (strcmp(cmd, "krec") == 0)
+	{
+	  if (val)
+	    kalman_record();
+	  else
+	    kalman_dump_record();
+	}
+      else if (strcmp(cmd, "ctl") == 0)
+	{
+	  control_report(val);
+	}
+      else if (strcmp(cmd, "ovf") == 0)
+	{
+	  fixcheck_report();
+	  if (val)
+	    fixcheck_reset();
+	}
+      else if (strcmp(cmd, "seg") == 0)
+	{
+	  mot_seg_report();
+	  if (val)
+	    mot_seg_flush();
+	}
+      else if (strcmp(cmd, "prof") == 0)
+	{
+	  prof_report();
+	  if (val)
+	    prof_reset();
+	}
       else if (strcmp(cmd, "h") == 0)
 	{
 	  ui_help();
@@ -974,10 +1052,6 @@ rtems_task Init(
   rtems_clock_get(RTEMS_CLOCK_GET_TICKS_PER_SECOND, &ticks_per_sec);
   printf ("Init: %d ticks per second\n", ticks_per_sec);
 
-  printf ("Initializing fast trig functions:\n");
-  init_trig();
-  printf ("Done.\n\n");
-
   printf ("Initializing tpu:\n");
   init_tpu();
   printf ("Done.\n\n");
@@ -1030,6 +1104,11 @@ rtems_task Init(
   kalman_init();
   printf ("Done.\n\n");
 
+  /* Has to be running before the gyro can be calibrated. */
+  printf ("Calling control_start():\n");
+  control_start();
+  printf ("Done.\n\n");
+
   printf ("Calibrating gyro:\n");
   gyro_calibrate();
   printf ("Done.\n\n");
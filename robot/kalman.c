@@ -33,72 +33,841 @@
  */
 
 #include <bsp.h>
-#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "global.h"
 #include "kalman.h"
 #include "gyro.h"
 #include "accel.h"
+#include "motor.h"
 #include "f16_16.h"
+#include "fastint.h"
+#include "control.h"
+#include "prof.h"
+#include "seqlock.h"
+
+/* Built with KALMAN_ACCEL_EVENTS, the filter runs an update for every
+   single accelerometer reading as it arrives, rather than on the
+   averaged reading every UPDATE_HZ/KALMAN_HZ gyro readings, with R
+   worked out for each reading from how noisy the accelerometer has
+   been and how hard the wheels are accelerating. */
+#if defined(KALMAN_ACCEL_EVENTS) && defined(KALMAN_STEADY_GAIN)
+#error "KALMAN_STEADY_GAIN needs a fixed R and update rate, and KALMAN_ACCEL_EVENTS changes both"
+#endif
 
 /* Types. */
 
+/* One step of the gain schedule for kalman(): the gain, and the
+   covariance after the update that used it. */
+typedef struct kalman_gain
+{
+  f16_16 K;
+  f16_16 P;
+} kalman_gain_t;
+
+/* Same, for kalman2(). */
+typedef struct kalman2_gain
+{
+  f16_16 K_0, K_1;
+  f16_16 P_00, P_01, P_11;
+} kalman2_gain_t;
+
 /* Constants */
 #define KALMAN_HZ 10
 #define UPDATE_HZ 250
 
+/* Starting covariances. */
+#define P_INIT		6553600		/* 100 */
+#define P_11_INIT	65536		/* 1 */
+
+/* Longest gain schedule kalman_gain_init() will work out.  Both
+   filters settle well before this with the constants below. */
+#define KALMAN_GAIN_LEN	128
+
+/* util/kalman_tune builds this file with KALMAN_TUNABLE, so that each
+   of its threads can try its own Q, R and update rate. */
+#ifdef KALMAN_TUNABLE
+#define KALMAN_CONST	__thread
+#define KALMAN_VAR	__thread
+#else
+#define KALMAN_CONST	const
+#define KALMAN_VAR
+#endif
+
 const f16_16	dt		= (65536 + UPDATE_HZ/2) / UPDATE_HZ;
-const f16_16	Q		= 655;		/* 0.01 as a 16.16 fixed
+KALMAN_CONST f16_16 Q		= 655;		/* 0.01 as a 16.16 fixed
 						   (Noise weighting matrix) */
 
+/* Constants for the two state (angle and gyro bias) filter.  Its
+   covariance is only carried forward when a measurement comes in, so
+   the process noise is scaled by the time between measurements
+   rather than by dt - Q_bias * dt would be too small to show up in a
+   16.16.  Q_angle and Q_bias are per second, so changing KALMAN_HZ
+   keeps the same process noise. */
+#define Q_ANGLE		655		/* 0.01 */
+#define Q_BIAS		197		/* 0.003 */
+KALMAN_CONST f16_16 kalman_dt	= (65536 + KALMAN_HZ/2) / KALMAN_HZ;
+KALMAN_CONST f16_16 Q_angle_dt	= (Q_ANGLE + KALMAN_HZ/2) / KALMAN_HZ;
+KALMAN_CONST f16_16 Q_bias_dt	= (Q_BIAS + KALMAN_HZ/2) / KALMAN_HZ;
+
+/* Measurement noise for KALMAN_ACCEL_EVENTS.  mult_f16_16() of a raw
+   accelerometer variance (counts squared) and KALMAN_ACCEL_VAR_DEG2 is
+   the variance in degrees squared as a 16.16:
+   (180/pi / ACCEL_1G)^2 * 2^32.  A wheel acceleration (steps/tick/tick
+   as a 24.8) times KALMAN_WHEEL_DEG is roughly the error it puts in the
+   accelerometer's angle, in degrees as a 16.16: one step/tick/tick is
+   about 2.6 G at 62.5 steps an inch. */
+#define KALMAN_ACCEL_VAR_DEG2	535760
+#define KALMAN_ACCEL_VAR_MAX	8000000		/* ~1000 degrees^2 */
+#define KALMAN_WHEEL_DEG	37997
+#define KALMAN_WHEEL_MAX	(90 * 65536 / KALMAN_WHEEL_DEG)
+
+/* How many clock ticks kalman_engines_report() times each engine
+   over, and how long it runs each one to measure its lag. */
+#define KALMAN_COST_TICKS	16
+#define KALMAN_LAG_TICKS	(10 * UPDATE_HZ)
+
+/* How many gyro/accelerometer samples 'krec' can record (10 seconds
+   worth). */
+#define KALMAN_REC_LEN	(10 * UPDATE_HZ)
+
 /* Globals. */
-f16_16	theta		= 0;		/*  (Our initial state estimate) */
-f16_16	gyro_only_theta = 0;
-f16_16	R		= 6554;	/* 0.1 as a 16.16 fixed
+
+/* The live estimate, which kalman_step() updates and kalman_read()
+   returns. */
+kalman_state_t kalman_state = {
+  0,		/* theta (Our initial state estimate) */
+  0,		/* gyro_only_theta */
+  P_INIT,	/* P: 100 as a 16.16 fixed (Covariance matrix) */
+  0,		/* bias */
+  P_INIT, 0, P_11_INIT, /* P_00, P_01, P_11 */
+  0,		/* updates */
+  0,		/* R_extra */
+  0		/* ticks */
+};
+
+KALMAN_VAR f16_16 R		= 6554;	/* 0.1 as a 16.16 fixed
 					   (Measurement error weight) */
-f16_16	P		= 6553600;	/* 100 as a 16.16 fixed
-					   (Covariance matrix) */
+f16_16	comp_k		= 6554;	/* 0.1 - complementary filter gain */
 f16_16  last_theta_m;
+
+/* What the read functions return.  kalman_step() copies the outputs
+   here after every update, under the sequence lock, so a reader in
+   another task gets them all from the same update.  The functions
+   that read just one of them don't need the lock: a long is read in
+   one go. */
+static kalman_snapshot_t kalman_snap;
+static seqlock_t kalman_snap_lock = SEQLOCK_INIT;
 int kalman_timeouts = 0;
 
+#ifdef KALMAN_ACCEL_EVENTS
+/* The last accelerometer reading used, how many updates have been run
+   and how many readings got skipped because two came in between gyro
+   readings, and the last R used. */
+static unsigned int kalman_accel_seq;
+static unsigned int kalman_accel_updates, kalman_accel_skipped;
+static f16_16 kalman_accel_R;
+#endif
+
+/* With Q, R and dt all fixed, P and K go through the same sequence
+   after every reset, settling to a steady state.  Built with
+   KALMAN_STEADY_GAIN, the filters look K and P up in these tables
+   instead of working them out - no divides and no covariance math.
+   While R is anything other than the R the tables were made for, the
+   filters fall back to the full update. */
+typedef struct kalman_gain_tables
+{
+  f16_16 R;			/* the R these were made for */
+  int n, n2;			/* steps in each schedule */
+  int steady, steady2;		/* whether each one settled */
+  kalman_gain_t g[KALMAN_GAIN_LEN];	/* kalman() */
+  kalman2_gain_t g2[KALMAN_GAIN_LEN];	/* kalman2() */
+} kalman_gain_tables_t;
+
+/* kalman_gain_init() works a new set out in whichever of these the
+   filters aren't using, then points kalman_gain_cur at it under
+   control_lock(), so a filter running in the control interrupt or
+   task never sees a half built set.  NULL until the first one. */
+static kalman_gain_tables_t kalman_gain_sets[2];
+kalman_gain_tables_t *volatile kalman_gain_cur = NULL;
+
+/* One step's raw filter inputs, as kalman_step() got them. */
+typedef struct kalman_rec_entry {
+  f16_16 gyro;
+  f16_16 accel;
+#ifdef KALMAN_ACCEL_EVENTS
+  char update;			/* the filter ran an update this tick */
+#endif
+} kalman_rec_entry_t;
+
+/* Raw filter inputs recorded by kalman_record(). */
+static kalman_rec_entry_t kalman_rec[KALMAN_REC_LEN];
+static volatile int kalman_rec_cnt = KALMAN_REC_LEN;
+
+/* The latest kalman_step()'s inputs, published with the outputs under
+   kalman_snap_lock for kalman_record_step() to copy out.  With
+   CONTROL_TIMER_ISR the recorder runs after the next sense step, so
+   reading the sensors itself would record the wrong sample. */
+static kalman_rec_entry_t kalman_rec_in;
+
+/* Which step of gain tables 't' to use for this update (kalman2()'s if
+   'two_state' is set), or -1 to do the full update. */
+static inline int
+kalman_gain_index(kalman_state_t *s, const kalman_gain_tables_t *t,
+		  int two_state)
+{
+  int i = s->updates;
+  int n, steady;
+
+  if (i < KALMAN_GAIN_LEN)
+    s->updates++;
+
+  if (t == NULL || R != t->R)
+    return -1;
+  n = two_state ? t->n2 : t->n;
+  steady = two_state ? t->steady2 : t->steady;
+  if (i < n)
+    return i;
+  return steady ? n - 1 : -1;
+}
+
+/* The covariance half of a kalman() update: works out the gain for
+   the (already carried forward) covariance *p, and updates *p. */
+static inline f16_16
+kalman_gain(f16_16 *p, f16_16 r)
+{
+  f16_16 E; /* Innovation covariance */
+  f16_16 K;
+
+  E = add_f16_16 (*p, r);			/* E = CPC' + R */
+#ifdef KALMAN_FAST_DIV
+  K = div_f16_16_fast (*p, E);			/* K = PC'inv(E) */
+#else
+  K = div_f16_16 (*p, E);			/* K = PC'inv(E) */
+#endif
+
+  /* Covariance update */
+  *p = add_f16_16 (mult_f16_16 (*p, mult_f16_16 (sub_f16_16 (1 * 65536, K),
+						 sub_f16_16 (1 * 65536, K))),
+		   mult_f16_16 (r, mult_f16_16 (K, K)));
+
+  return K;
+}
+
+/* The covariance half of a kalman2() update: carries the covariance
+   *g forward to this measurement, works out the gains, and updates
+   the covariance. */
+static inline void
+kalman2_gain(kalman2_gain_t *g, f16_16 r, f16_16 k_dt, f16_16 q_angle_dt,
+	     f16_16 q_bias_dt)
+{
+  f16_16 P_11_dt; /* P_11 * kalman_dt */
+  f16_16 E; /* Innovation covariance */
+#ifdef KALMAN_FAST_DIV
+  f16_16_divisor E_div;
+#endif
+
+  /* Carry the covariance forward over the k_dt since the last
+     measurement: P = A*P*A' + Q, with A = [1 -k_dt; 0 1]. */
+  P_11_dt = mult_f16_16 (g->P_11, k_dt);
+  g->P_00 = add_f16_16 (g->P_00,
+			add_f16_16 (mult_f16_16 (k_dt,
+						 sub_f16_16 (P_11_dt,
+							     2 * g->P_01)),
+				    q_angle_dt));
+  g->P_01 = sub_f16_16 (g->P_01, P_11_dt);
+  g->P_11 = add_f16_16 (g->P_11, q_bias_dt);
+
+  E = add_f16_16 (g->P_00, r);			/* E = CPC' + R */
+#ifdef KALMAN_FAST_DIV
+  f16_16_divisor_init (&E_div, E);
+  g->K_0 = div_f16_16_by (g->P_00, &E_div);	/* K = PC'inv(E) */
+  g->K_1 = div_f16_16_by (g->P_01, &E_div);
+#else
+  g->K_0 = div_f16_16 (g->P_00, E);		/* K = PC'inv(E) */
+  g->K_1 = div_f16_16 (g->P_01, E);
+#endif
+
+  /* Covariance update: P = (I - KC)P.  P_11 has to use the old P_01. */
+  g->P_11 = sub_f16_16 (g->P_11, mult_f16_16 (g->K_1, g->P_01));
+  g->P_01 = sub_f16_16 (g->P_01, mult_f16_16 (g->K_0, g->P_01));
+  g->P_00 = sub_f16_16 (g->P_00, mult_f16_16 (g->K_0, g->P_00));
+}
+
 /* Kalman filter routine. */
 
 f16_16
-kalman(f16_16 q, /* Pitching gyro reading */
+kalman(kalman_state_t *s,
+       f16_16 q, /* Pitching gyro reading */
        f16_16 theta_m, /* Measured angle from accelerometer. */
        int do_kalman) /* whether to run the filter or just update
 			 based on gyro reading. */
 {
   f16_16 Pdot; /* Derivative of P */
-  f16_16 E; /* ? */
-  f16_16 K; /* ? */
+  f16_16 K; /* Kalman gain */
+#ifdef KALMAN_STEADY_GAIN
+  const kalman_gain_tables_t *t = kalman_gain_cur;
+  int i;
+#endif
 
   /* A = 0 */
   Pdot = Q; /* Pdot = A*P + P*A' + Q */
-  P = add_f16_16 (P, mult_f16_16 (Pdot, dt));
+  s->P = add_f16_16 (s->P, mult_f16_16 (Pdot, dt));
 
   /* Update our state estimate from the rate gyro */
-  theta = add_f16_16 (theta, mult_f16_16 (q, dt));
+  s->theta = add_f16_16 (s->theta, mult_f16_16 (q, dt));
 
-  gyro_only_theta = add_f16_16 (gyro_only_theta, mult_f16_16 (q, dt));
+  s->gyro_only_theta = add_f16_16 (s->gyro_only_theta, mult_f16_16 (q, dt));
 
   if (!do_kalman)
-    return theta;
+    return s->theta;
 
-  E = add_f16_16 (P, R);				/* E = CPC' + R */
-  K = div_f16_16 (P, E);				/* K = PC'inv(E) */
+#ifdef KALMAN_STEADY_GAIN
+  i = kalman_gain_index (s, t, 0);
+  if (i >= 0) {
+    K = t->g[i].K;
+    s->P = t->g[i].P;
+  } else
+#endif
+    K = kalman_gain (&s->P, add_f16_16 (R, s->R_extra));
 
   /* Update the state */
-  theta = add_f16_16 (theta, mult_f16_16 (K, sub_f16_16(theta_m, theta )));
+  s->theta = add_f16_16 (s->theta,
+			 mult_f16_16 (K, sub_f16_16(theta_m, s->theta )));
 
-  /* Covariance update */
-  P = add_f16_16 (mult_f16_16 (P, mult_f16_16 (sub_f16_16 (1 * 65536, K),
-					       sub_f16_16 (1 * 65536, K))),
-		  mult_f16_16 (R, mult_f16_16 (K, K)));
+  return s->theta;
+}
+
+/* Two state kalman filter: estimates the gyro's bias along with the
+   angle, so the boot-time gyro_calibrate() doesn't have to be
+   perfect and drift gets tracked as the gyro warms up.  The state is
+   [theta bias]', the gyro drives theta through
+   theta' = q - bias, and the accelerometer measures theta.  The 2x2
+   matrix math is written out longhand. */
+f16_16
+kalman2(kalman_state_t *s,
+	f16_16 q, /* Pitching gyro reading */
+	f16_16 theta_m, /* Measured angle from accelerometer. */
+	int do_kalman) /* whether to run the filter or just update
+			  based on gyro reading. */
+{
+  kalman2_gain_t g;
+  const kalman2_gain_t *gp = &g;
+  f16_16 err;
+#ifdef KALMAN_STEADY_GAIN
+  const kalman_gain_tables_t *t = kalman_gain_cur;
+  int i;
+#endif
+
+  /* Update our state estimate from the rate gyro */
+  s->theta = add_f16_16 (s->theta, mult_f16_16 (sub_f16_16 (q, s->bias), dt));
+
+  s->gyro_only_theta = add_f16_16 (s->gyro_only_theta, mult_f16_16 (q, dt));
+#ifdef KALMAN_ACCEL_EVENTS
+  s->ticks++;
+#endif
+
+  if (!do_kalman)
+    return s->theta;
+
+#ifdef KALMAN_STEADY_GAIN
+  i = kalman_gain_index (s, t, 1);
+  if (i >= 0)
+    gp = &t->g2[i];
+  else
+#endif
+  {
+    g.P_00 = s->P_00;
+    g.P_01 = s->P_01;
+    g.P_11 = s->P_11;
+#ifdef KALMAN_ACCEL_EVENTS
+    /* The time since the last update varies, so scale the process
+       noise to it. */
+    kalman2_gain (&g, add_f16_16 (R, s->R_extra), dt * s->ticks,
+		  (Q_angle_dt * s->ticks + UPDATE_HZ/KALMAN_HZ/2) /
+		  (UPDATE_HZ/KALMAN_HZ),
+		  (Q_bias_dt * s->ticks + UPDATE_HZ/KALMAN_HZ/2) /
+		  (UPDATE_HZ/KALMAN_HZ));
+    s->ticks = 0;
+#else
+    kalman2_gain (&g, R, kalman_dt, Q_angle_dt, Q_bias_dt);
+#endif
+  }
+  s->P_00 = gp->P_00;
+  s->P_01 = gp->P_01;
+  s->P_11 = gp->P_11;
+
+  /* Update the state */
+  err = sub_f16_16 (theta_m, s->theta);
+  s->theta = add_f16_16 (s->theta, mult_f16_16 (gp->K_0, err));
+  s->bias = add_f16_16 (s->bias, mult_f16_16 (gp->K_1, err));
+
+  return s->theta;
+}
+
+/* Complementary filter: integrates the gyro, and pulls the angle a
+   fixed fraction comp_k of the way towards the accelerometer's
+   angle on each update.  That's what the kalman filters settle to
+   anyway, at a fraction of the cost.  It uses whatever gyro bias
+   kalman2() last worked out, but doesn't update it. */
+f16_16
+comp_filter(kalman_state_t *s,
+	    f16_16 q, /* Pitching gyro reading */
+	    f16_16 theta_m, /* Measured angle from accelerometer. */
+	    int do_kalman) /* whether to correct the angle with
+			      theta_m */
+{
+  s->theta = add_f16_16 (s->theta, mult_f16_16 (sub_f16_16 (q, s->bias), dt));
+
+  s->gyro_only_theta = add_f16_16 (s->gyro_only_theta, mult_f16_16 (q, dt));
+
+  if (!do_kalman)
+    return s->theta;
+
+  s->theta = add_f16_16 (s->theta,
+			 mult_f16_16 (comp_k, sub_f16_16 (theta_m, s->theta)));
+
+  return s->theta;
+}
+
+/* Run kalman()'s covariance until it settles, so switching to it
+   doesn't start it off trusting the accelerometer completely. */
+static void
+kalman_settle(kalman_state_t *s)
+{
+  f16_16 p = s->P;
+  int i, j;
+
+  for (i = 0; i < KALMAN_GAIN_LEN; i++) {
+    for (j = 0; j < UPDATE_HZ/KALMAN_HZ; j++)
+      p = add_f16_16 (p, mult_f16_16 (Q, dt));
+    kalman_gain (&p, R);
+  }
+  s->P = p;
+}
+
+/* Same for kalman2(). */
+static void
+kalman2_settle(kalman_state_t *s)
+{
+  kalman2_gain_t g;
+  int i;
+
+  g.P_00 = s->P_00;
+  g.P_01 = s->P_01;
+  g.P_11 = s->P_11;
+  for (i = 0; i < KALMAN_GAIN_LEN; i++)
+    kalman2_gain (&g, R, kalman_dt, Q_angle_dt, Q_bias_dt);
+  s->P_00 = g.P_00;
+  s->P_01 = g.P_01;
+  s->P_11 = g.P_11;
+}
+
+/* The tilt estimators kalman_step() can run. */
+const kalman_engine_t kalman_engines[] = {
+  { "kalman",	kalman,		kalman_settle },
+  { "kalman2",	kalman2,	kalman2_settle },
+  { "comp",	comp_filter,	0 },
+};
+
+const int kalman_num_engines = sizeof(kalman_engines) / sizeof(kalman_engines[0]);
+
+/* Which of kalman_engines[] is running. */
+#ifdef KALMAN_ONE_STATE
+static volatile int kalman_engine = 0;
+#else
+static volatile int kalman_engine = 1;
+#endif
+
+/* Switch to running kalman_engines[n].  The angle (and gyro bias)
+   carry over from the engine that was running. */
+int
+kalman_select(int n)
+{
+  if (n < 0 || n >= kalman_num_engines)
+    return -1;
+  if (n == kalman_engine)
+    return 0;
+
+  /* The running engine doesn't touch the new one's covariance, so
+     this is safe to do while kalman_step() is going. */
+  if (kalman_engines[n].settle)
+    kalman_engines[n].settle(&kalman_state);
+  kalman_state.updates = KALMAN_GAIN_LEN;
+  kalman_engine = n;
+
+  return 0;
+}
+
+/* Which engine is running. */
+int
+kalman_selected(void)
+{
+  return kalman_engine;
+}
+
+/* Set up a filter state as it is at startup. */
+void
+kalman_state_init(kalman_state_t *s)
+{
+  s->theta = 0;
+  s->gyro_only_theta = 0;
+  s->P = P_INIT;
+  s->bias = 0;
+  s->P_00 = P_INIT;
+  s->P_01 = 0;
+  s->P_11 = P_11_INIT;
+  s->updates = 0;
+  s->R_extra = 0;
+  s->ticks = 0;
+}
+
+static f16_16
+kalman_null(kalman_state_t *s, f16_16 q, f16_16 theta_m, int do_kalman)
+{
+  return s->theta;
+}
+
+static inline rtems_interval
+kalman_now(void)
+{
+  rtems_interval now;
 
-  return theta;
+  rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &now);
+  return now;
 }
 
+/* How many times 'fn' can run in one clock tick.  The clock is too
+   coarse to time one call, so this counts calls between two ticks,
+   and takes the best of KALMAN_COST_TICKS ticks to leave out the
+   ticks where other tasks ran. */
+static unsigned int
+kalman_calls_per_tick(kalman_fn fn, kalman_state_t *s, int do_kalman)
+{
+  rtems_interval start, now;
+  unsigned int n, best = 0;
+  int t;
+
+  for (t = 0; t < KALMAN_COST_TICKS; t++) {
+    start = kalman_now();
+    do
+      now = kalman_now();
+    while (now == start);
+
+    start = now;
+    n = 0;
+    do {
+      fn(s, 65536, s->theta, do_kalman);
+      n++;
+      now = kalman_now();
+    } while (now == start);
+
+    if (n > best)
+      best = n;
+  }
+
+  return best;
+}
+
+/* Nanoseconds per call of 'fn', less the cost of the timing loop. */
+static unsigned int
+kalman_cost_ns(kalman_fn fn, kalman_state_t *s, int do_kalman,
+	       unsigned int null_calls)
+{
+  unsigned int tick_ns = 1000000000 / ticks_per_sec;
+  unsigned int calls = kalman_calls_per_tick(fn, s, do_kalman);
+
+  if (calls == 0 || tick_ns / calls < tick_ns / null_calls)
+    return 0;
+  return tick_ns / calls - tick_ns / null_calls;
+}
+
+/* How long (in milliseconds) 'fn' takes to move 63% of the way to a
+   1 degree step in the accelerometer's angle, with the gyro still.
+   Runs it on a copy of the live state with its angle settled at 0
+   first. */
+static int
+kalman_lag_ms(const kalman_engine_t *e)
+{
+  kalman_state_t s;
+  int i, cnt = 0;
+
+  s = kalman_state;
+  s.theta = 0;
+  s.bias = 0;
+  s.updates = KALMAN_GAIN_LEN;
+  if (e->settle)
+    e->settle(&s);
+
+  for (i = 0; i < KALMAN_LAG_TICKS; i++) {
+    if (++cnt == UPDATE_HZ/KALMAN_HZ)
+      cnt = 0;
+    e->fn(&s, 0, 0, cnt == 0);
+  }
+
+  for (i = 0; i < KALMAN_LAG_TICKS; i++) {
+    if (++cnt == UPDATE_HZ/KALMAN_HZ)
+      cnt = 0;
+    if (e->fn(&s, 0, 65536, cnt == 0) >= 41419)	/* 0.632 */
+      return (i + 1) * 1000 / UPDATE_HZ;
+  }
+
+  return -1;
+}
+
+/* Print each engine's cost and lag ('est' command).  Takes about a
+   second. */
+void
+kalman_engines_report(void)
+{
+  kalman_state_t s;
+  unsigned int null_calls, tick_ns, update_ns;
+  int i, lag;
+
+  s = kalman_state;
+  null_calls = kalman_calls_per_tick(kalman_null, &s, 0);
+
+  printf ("Tilt estimators (cost from calls per clock tick, lag is time "
+	  "to 63%% of a step):\n");
+  for (i = 0; i < kalman_num_engines; i++) {
+    s = kalman_state;
+    s.updates = KALMAN_GAIN_LEN;
+    tick_ns = kalman_cost_ns(kalman_engines[i].fn, &s, 0, null_calls);
+    update_ns = kalman_cost_ns(kalman_engines[i].fn, &s, 1, null_calls);
+    lag = kalman_lag_ms(&kalman_engines[i]);
+
+    printf ("%c %d: %-8s gyro only %u.%u us (%u cycles), update %u.%u us "
+	    "(%u cycles), lag ",
+	    i == kalman_engine ? '*' : ' ', i + 1, kalman_engines[i].name,
+	    tick_ns / 1000, tick_ns % 1000 / 100,
+	    tick_ns * (SYS_CLOCK / 1000000) / 1000,
+	    update_ns / 1000, update_ns % 1000 / 100,
+	    update_ns * (SYS_CLOCK / 1000000) / 1000);
+    if (lag < 0)
+      printf ("> %d ms\n", KALMAN_LAG_TICKS * 1000 / UPDATE_HZ);
+    else
+      printf ("%d ms\n", lag);
+  }
+
+#ifdef KALMAN_ACCEL_EVENTS
+  printf ("Accelerometer updates: %u, %u readings skipped, last R %ld.%04ld\n",
+	  kalman_accel_updates, kalman_accel_skipped,
+	  (long)(kalman_accel_R / 65536),
+	  (long)((kalman_accel_R % 65536) * 10000 / 65536));
+#endif
+}
+
+/* Set/get the complementary filter's gain. */
+void
+kalman_set_comp_k(f16_16 k)
+{
+  comp_k = k;
+}
+
+f16_16
+kalman_get_comp_k(void)
+{
+  return comp_k;
+}
+
+/* Work out the gain schedules for both filters with the current R,
+   stopping when the gains and covariances stop changing, and switch
+   the filters over to them. */
+void
+kalman_gain_init(void)
+{
+  kalman_gain_t g1 = { 0, P_INIT };
+  kalman2_gain_t g2 = { 0, 0, P_INIT, 0, P_11_INIT };
+  kalman_gain_tables_t *t;
+  control_lock_t lock;
+  int i, j;
+
+  t = (kalman_gain_cur == &kalman_gain_sets[0]) ?
+    &kalman_gain_sets[1] : &kalman_gain_sets[0];
+  t->R = R;
+
+  t->n = KALMAN_GAIN_LEN;
+  t->steady = 0;
+  for (i = 0; i < KALMAN_GAIN_LEN; i++) {
+    /* The same P += Q*dt per gyro reading kalman() does. */
+    for (j = 0; j < UPDATE_HZ/KALMAN_HZ; j++)
+      g1.P = add_f16_16 (g1.P, mult_f16_16 (Q, dt));
+    g1.K = kalman_gain (&g1.P, t->R);
+    t->g[i] = g1;
+    if (i > 0 && g1.K == t->g[i-1].K && g1.P == t->g[i-1].P) {
+      t->n = i;
+      t->steady = 1;
+      break;
+    }
+  }
+
+  t->n2 = KALMAN_GAIN_LEN;
+  t->steady2 = 0;
+  for (i = 0; i < KALMAN_GAIN_LEN; i++) {
+    kalman2_gain (&g2, t->R, kalman_dt, Q_angle_dt, Q_bias_dt);
+    t->g2[i] = g2;
+    if (i > 0 &&
+	g2.K_0 == t->g2[i-1].K_0 && g2.K_1 == t->g2[i-1].K_1 &&
+	g2.P_00 == t->g2[i-1].P_00 &&
+	g2.P_01 == t->g2[i-1].P_01 &&
+	g2.P_11 == t->g2[i-1].P_11) {
+      t->n2 = i;
+      t->steady2 = 1;
+      break;
+    }
+  }
+
+  control_lock(lock);
+  kalman_gain_cur = t;
+  control_unlock(lock);
+}
+
+/* Change the measurement error weight.  The filters do the full
+   update until the gain tables have been worked out again, then go
+   straight to the steady state gains - they've been running long
+   enough for the start of the schedule not to apply. */
+void
+kalman_set_R(f16_16 r)
+{
+#ifdef KALMAN_STEADY_GAIN
+  control_lock_t lock;
+
+  control_lock(lock);
+  R = r;
+  kalman_state.updates = KALMAN_GAIN_LEN;
+  control_unlock(lock);
+  kalman_gain_init();
+#else
+  R = r;
+#endif
+}
+
+/* Get the measurement error weight. */
+f16_16
+kalman_get_R(void)
+{
+  return R;
+}
+
+#ifdef KALMAN_ACCEL_EVENTS
+/* The measurement noise to add to R for one accelerometer reading:
+   the variance of the recent raw readings, plus the square of the
+   error the wheels' acceleration puts in the angle. */
+static f16_16
+kalman_accel_noise(unsigned int var)
+{
+  mot_accel_t a = abs(mot_get_wheel_accel());
+  f16_16 err;
+
+  if (var > KALMAN_ACCEL_VAR_MAX)
+    var = KALMAN_ACCEL_VAR_MAX;
+  if (a > KALMAN_WHEEL_MAX)
+    a = KALMAN_WHEEL_MAX;
+  err = a * KALMAN_WHEEL_DEG;
+
+  return add_f16_16 (mult_f16_16 ((f16_16)var, KALMAN_ACCEL_VAR_DEG2),
+		     mult_f16_16 (err, err));
+}
+#endif
+
+/* One update: reads the gyro (and the accelerometer when it's time
+   to) and runs the kalman filter.  This is the estimate step of the
+   control chain. */
+void
+kalman_step(void)
+{
+#ifdef KALMAN_ACCEL_EVENTS
+  accel_sample_t sample;
+#else
+  static int kalman_cnt = 0;
+#endif
+  f16_16 gyro_reading;
+  f16_16 accel_reading, rec_accel;
+  f16_16 theta_m = 0;
+  int do_kalman;
+
+#ifdef KALMAN_ACCEL_EVENTS
+  /* Run the filter whenever the accelerometer has a new reading. */
+  accel_get_sample(&sample);
+  do_kalman = (sample.seq != kalman_accel_seq);
+  if (do_kalman) {
+    kalman_accel_skipped += sample.seq - kalman_accel_seq - 1;
+    kalman_accel_seq = sample.seq;
+    kalman_accel_updates++;
+    kalman_state.R_extra = kalman_accel_noise(sample.var);
+    kalman_accel_R = add_f16_16 (R, kalman_state.R_extra);
+  }
+#else
+  /* We update our angle at UPDATE_HZ, but only run the kalman
+     filter at KALMAN_HZ.  These should be a multiple of each
+     other, so that we run the kalman filter every
+     UPDATE_HZ/KALMAN_HZ updates. */
+  do_kalman = (++kalman_cnt == (UPDATE_HZ/KALMAN_HZ));
+  if (do_kalman)
+    kalman_cnt = 0;
+#endif
+
+  /* Read the gyro. */
+  gyro_reading = gyro_read(GYRO_X);
+  control_mark_estimate();
+
+  /* Only deal with the accelerometer reading if we're going to
+     run the filter, or 'krec' is recording every reading. */
+#ifdef KALMAN_ACCEL_EVENTS
+  accel_reading = sample.accel;
+#else
+  accel_reading = (do_kalman || kalman_rec_cnt < KALMAN_REC_LEN) ?
+    accel_read() : 0;
+#endif
+  rec_accel = accel_reading;
+
+  if (do_kalman) {
+    if (accel_reading > 65536)
+      accel_reading = 65536;
+    if (accel_reading < -65536)
+      accel_reading = -65536;
+
+    /* Convert the accelerometer reading to an angle. */
+    theta_m = fastasin_f16_16(accel_reading);
+    last_theta_m = theta_m;
+  }
+
+  /* Run the filter. */
+  kalman_engines[kalman_engine].fn(&kalman_state, gyro_reading, theta_m,
+				   do_kalman);
+
+  /* Publish the outputs. */
+  seqlock_write_begin(&kalman_snap_lock);
+  kalman_snap.theta = kalman_state.theta;
+  kalman_snap.theta_m = last_theta_m;
+  kalman_snap.gyro_only_theta = kalman_state.gyro_only_theta;
+  kalman_snap.bias = kalman_state.bias;
+  kalman_rec_in.gyro = gyro_reading;
+  kalman_rec_in.accel = rec_accel;
+#ifdef KALMAN_ACCEL_EVENTS
+  kalman_rec_in.update = do_kalman;
+#endif
+  seqlock_write_end(&kalman_snap_lock);
+}
+
+/* Record the inputs the latest kalman_step() ran on if 'krec' asked
+   for them, once per period.  This is the deferred step of the control
+   chain, so it is kept out of the interrupt with CONTROL_TIMER_ISR. */
+static void
+kalman_record_step(void)
+{
+  unsigned int seq;
+
+  if (kalman_rec_cnt < KALMAN_REC_LEN) {
+    do {
+      seq = seqlock_read_begin(&kalman_snap_lock);
+      kalman_rec[kalman_rec_cnt] = kalman_rec_in;
+    } while (seqlock_read_retry(&kalman_snap_lock, seq));
+    kalman_rec_cnt++;
+  }
+}
+
+#ifdef CONTROL_SEPARATE_TASKS
 /* Kalman filter task.  Reads the gyro & accelerometer, and runs the
    kalman filter. */
 rtems_task
@@ -107,10 +876,7 @@ kalman_task(rtems_task_argument ignored)
   rtems_name period_name;
   rtems_id period;
   rtems_status_code status;
-  f16_16 gyro_reading;
-  f16_16 accel_reading;
-  f16_16 theta_m;
-  int kalman_cnt = 0, do_kalman;
+  PROF_DECL(t);
 
   period_name = rtems_build_name ('K', 'L', 'P', 'D');
   status = rtems_rate_monotonic_create (period_name, &period);
@@ -130,46 +896,36 @@ kalman_task(rtems_task_argument ignored)
 	     our next timeout, until the end of time... */
 	  kalman_timeouts++;
 	}
+      PROF_START(t);
 
-      /* We update our angle at UPDATE_HZ, but only run the kalman
-	 filter at KALMAN_HZ.  These should be a multiple of each
-	 other, so that we run the kalman filter every
-	 UPDATE_HZ/KALMAN_HZ updates. */
-      do_kalman = (kalman_cnt++ == (UPDATE_HZ/KALMAN_HZ));
-      if (do_kalman)
-	kalman_cnt = 0;
-
-      /* Read the gyro. */
-      gyro_reading = gyro_read(GYRO_X);
-
-      /* Only deal with the accelerometer reading if we're going to
-	 run the filter. */
-      if (do_kalman) {
-	accel_reading = accel_read();
-
-	if (accel_reading > 65536)
-	  accel_reading = 65536;
-	if (accel_reading < -65536)
-	  accel_reading = -65536;
-
-	/* Convert the accelerometer reading to an angle. */
-	theta_m = f16_16_from_double(asin(double_from_f16_16(accel_reading)) *
-				     180.0 / M_PI);
-	last_theta_m = theta_m;
-      }
-
-      /* Run the filter. */
-      theta = kalman(gyro_reading, theta_m, do_kalman);
+      kalman_step();
+      kalman_record_step();
+      PROF_SINCE(PROF_KALMAN, t);
     }
 }
+#endif
 
 /* Initialize the kalman filter task. */
 void
 kalman_init(void)
 {
+#ifdef CONTROL_SEPARATE_TASKS
   rtems_status_code code;
   Objects_Id t1;
+#endif
+
+#ifdef KALMAN_STEADY_GAIN
+  kalman_gain_init();
+  printf ("kalman gain schedule: %d steps (%s), two state %d steps (%s)\n",
+	  kalman_gain_cur->n, kalman_gain_cur->steady ? "steady" : "not steady",
+	  kalman_gain_cur->n2,
+	  kalman_gain_cur->steady2 ? "steady" : "not steady");
+#endif
 
+#ifndef CONTROL_SEPARATE_TASKS
+  control_register(CONTROL_ESTIMATE, "kalman", kalman_step);
+  control_register(CONTROL_DEFERRED, "krec", kalman_record_step);
+#else
   printf ("Spawning kalman filter task:\n");
   code = rtems_task_create(rtems_build_name('K', 'A', 'L', 'M'),
 			   10, RTEMS_MINIMUM_STACK_SIZE * 2,
@@ -179,6 +935,20 @@ kalman_init(void)
   printf ("  rtems_task_create returned %d; t1 = 0x%08x\n", code, t1);
   code = rtems_task_start(t1, kalman_task, 0);
   printf ("Done. (rtems_task_start returned %d)\n\n", code);
+#endif
+}
+
+/* Get all of the filter's outputs at once, from the same update,
+   without blocking the filter. */
+void
+kalman_get_snapshot(kalman_snapshot_t *snap)
+{
+  unsigned int seq;
+
+  do {
+    seq = seqlock_read_begin(&kalman_snap_lock);
+    *snap = kalman_snap;
+  } while (seqlock_read_retry(&kalman_snap_lock, seq));
 }
 
 /* Get the current tilt of the platform.  Output is degrees as a 16.16
@@ -187,7 +957,7 @@ kalman_init(void)
 int
 kalman_read(void)
 {
-  return (int)theta;
+  return (int)kalman_snap.theta;
 }
 
 /* Get the most recent 'theta_m' reading (which is the accelerometer
@@ -195,7 +965,7 @@ kalman_read(void)
 int
 kalman_read_theta_m(void)
 {
-  return (int)last_theta_m;
+  return (int)kalman_snap.theta_m;
 }
 
 /* Get the most recent gyro only reading (which is the integrated gyro
@@ -203,5 +973,48 @@ kalman_read_theta_m(void)
 int
 kalman_read_gyro_only(void)
 {
-  return (int)gyro_only_theta;
+  return (int)kalman_snap.gyro_only_theta;
+}
+
+/* Get the current estimate of the gyro's bias, in degrees/second as a
+   16.16 number.  This is what's left over after gyro_calibrate()'s
+   neutral value has been taken out, so it stays near zero unless the
+   gyro drifts.  Only kalman2() updates it. */
+int
+kalman_read_bias(void)
+{
+  return (int)kalman_snap.bias;
+}
+
+/* Start recording the raw gyro and accelerometer readings the filter
+   gets, one pair per update, for replaying through the filter on the
+   host (see bench/bench_kalman.c). */
+void
+kalman_record(void)
+{
+  kalman_rec_cnt = 0;
+}
+
+/* Print what kalman_record() recorded so far, one
+   "gyro accel" pair of 16.16 numbers per line.  With
+   KALMAN_ACCEL_EVENTS the filter runs whenever a new accelerometer
+   sample comes in rather than every UPDATE_HZ/KALMAN_HZ ticks, so
+   each line also gets a 1 if the filter ran an update that tick. */
+void
+kalman_dump_record(void)
+{
+  int i, n = kalman_rec_cnt;
+
+#ifdef KALMAN_ACCEL_EVENTS
+  printf ("# kalman recording: %d samples at %d Hz, kalman when marked\n",
+	  n, UPDATE_HZ);
+  for (i = 0; i < n; i++)
+    printf ("%ld %ld %d\n", (long)kalman_rec[i].gyro,
+	    (long)kalman_rec[i].accel, kalman_rec[i].update);
+#else
+  printf ("# kalman recording: %d samples at %d Hz, kalman every %d\n",
+	  n, UPDATE_HZ, UPDATE_HZ / KALMAN_HZ);
+  for (i = 0; i < n; i++)
+    printf ("%ld %ld\n", (long)kalman_rec[i].gyro, (long)kalman_rec[i].accel);
+#endif
 }
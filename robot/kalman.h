@@ -29,6 +29,57 @@
 #ifndef _KALMAN_H
 #define _KALMAN_H
 
+#include "f16_16.h"
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+/* Everything the tilt estimators keep from one step to the next.
+   Angles are degrees and rates degrees/second, as 16.16 numbers. */
+typedef struct kalman_state
+{
+  f16_16 theta;			/* the tilt estimate */
+  f16_16 gyro_only_theta;	/* integrated gyro, for comparison */
+  f16_16 P;			/* kalman(): covariance */
+  f16_16 bias;			/* kalman2(): gyro bias */
+  f16_16 P_00, P_01, P_11;	/* kalman2(): covariance (symmetric) */
+  int updates;			/* updates since reset, for the gain
+				   tables (KALMAN_STEADY_GAIN) */
+  f16_16 R_extra;		/* measurement noise on top of R for the
+				   next update (KALMAN_ACCEL_EVENTS) */
+  int ticks;			/* gyro readings since the last update
+				   (KALMAN_ACCEL_EVENTS) */
+} kalman_state_t;
+
+/* The filter's outputs, all from the same update.  See
+   kalman_get_snapshot(). */
+typedef struct kalman_snapshot
+{
+  f16_16 theta;			/* the tilt estimate */
+  f16_16 theta_m;		/* most recent accelerometer angle */
+  f16_16 gyro_only_theta;	/* integrated gyro */
+  f16_16 bias;			/* gyro bias estimate (kalman2() only) */
+} kalman_snapshot_t;
+
+/* One step of a tilt estimator: 'q' is the gyro rate and 'theta_m' the
+   accelerometer angle, which is only used when 'do_kalman' is set.
+   Returns the new s->theta. */
+typedef f16_16 (*kalman_fn)(kalman_state_t *s, f16_16 q, f16_16 theta_m,
+			    int do_kalman);
+
+/* A tilt estimator kalman_step() can run.  'settle', if set, brings
+   the estimator's covariance to its steady state. */
+typedef struct kalman_engine
+{
+  const char *name;
+  kalman_fn fn;
+  void (*settle)(kalman_state_t *s);
+} kalman_engine_t;
+
+extern const kalman_engine_t kalman_engines[];
+extern const int kalman_num_engines;
+
 /**********************************************************************/
 /* Functions */
 /**********************************************************************/
@@ -36,6 +87,10 @@
 /* Initialize the kalman filter task. */
 void kalman_init(void);
 
+/* Get all of the filter's outputs at once, from the same update,
+   without blocking the filter. */
+void kalman_get_snapshot(kalman_snapshot_t *snap);
+
 /* Get the current tilt of the platform.  Output is degrees as a 16.16
    number.  Note that a forward tilt is a positive number, and a
    backwards tilt is a negative number. */
@@ -49,4 +104,51 @@ int kalman_read_theta_m(void);
    readings). */
 int kalman_read_gyro_only(void);
 
+/* Get the current estimate of the gyro's bias, in degrees/second as a
+   16.16 number. */
+int kalman_read_bias(void);
+
+/* Start recording the raw gyro and accelerometer readings the filter
+   gets (10 seconds worth). */
+void kalman_record(void);
+
+/* Print what kalman_record() recorded, in the format
+   bench/bench_kalman reads. */
+void kalman_dump_record(void);
+
+/* Set/get the kalman filters' measurement error weight, R, as a 16.16
+   number. */
+void kalman_set_R(f16_16 r);
+f16_16 kalman_get_R(void);
+
+/* Work out the gain schedules used when built with
+   KALMAN_STEADY_GAIN, and switch the filters over to them once they
+   are complete.  kalman_init() and kalman_set_R() call this. */
+void kalman_gain_init(void);
+
+/* The estimators: kalman() only estimates the angle, kalman2()
+   estimates the gyro's bias too, and comp_filter() is a complementary
+   filter with a fixed gain. */
+f16_16 kalman(kalman_state_t *s, f16_16 q, f16_16 theta_m, int do_kalman);
+f16_16 kalman2(kalman_state_t *s, f16_16 q, f16_16 theta_m, int do_kalman);
+f16_16 comp_filter(kalman_state_t *s, f16_16 q, f16_16 theta_m,
+		   int do_kalman);
+
+/* Set up a state as it is at startup. */
+void kalman_state_init(kalman_state_t *s);
+
+/* Switch kalman_step() to kalman_engines[n], keeping the current
+   angle.  Returns non-zero if there's no such engine. */
+int kalman_select(int n);
+
+/* Which of kalman_engines[] is running. */
+int kalman_selected(void);
+
+/* Print each engine's cost per step and lag. */
+void kalman_engines_report(void);
+
+/* Set/get the complementary filter's gain (16.16, 0 to 1). */
+void kalman_set_comp_k(f16_16 k);
+f16_16 kalman_get_comp_k(void);
+
 #endif /* _KALMAN_H */
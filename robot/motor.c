@@ -35,7 +35,14 @@
 #include "global.h"
 #include "kalman.h"
 #include "f16_16.h"
+#include "fixed.h"
+#include "bam.h"
+#include "fixcheck.h"
+#include "control.h"
+#include "seqlock.h"
 #include "robot_trace.h"
+#include "prof.h"
+#include "fastint.h"
 
 #define MOTOR_HZ		250
 #define TILT_UPDATE_INTERVAL	25
@@ -44,13 +51,60 @@
 #define HEADING_UPD_PCT		10 /* what percentage of a heading update to
 				   apply. */
 
+/* How far the heading turns (as a bam32) when one wheel gets a step
+   ahead of the other. */
+#define MOT_BAM32_PER_STEP	(BAM32_PER_RADIAN / MOT_WHEEL_BASE)
+
+/* How many commands can wait for the motor task (a power of 2). */
+#define MOT_CMD_SLOTS		8
+
 typedef struct mot_info
 {
   uint32 curpos;		/* Current position of motor. */
 } mot_info_t;
 
+typedef enum mot_cmd_type
+{
+  MOT_CMD_MOVE,			/* s, a, v, tick, jerk */
+  MOT_CMD_HEADING,		/* heading, steps per tick */
+  MOT_CMD_PID,			/* kp, kd, ki */
+  MOT_CMD_BAL_PID,		/* kp, kd, ki */
+  MOT_CMD_HD_PID,		/* kp, kd, ki */
+  MOT_CMD_SEG_MOVE,		/* queue a segment: s, a, v, tick, jerk */
+  MOT_CMD_SEG_VEL,		/* a, v, tick, jerk */
+  MOT_CMD_SEG_HEADING,		/* heading, steps per tick, wait, tick */
+  MOT_CMD_SEG_WAIT,		/* ticks */
+  MOT_CMD_SEG_FLUSH
+} mot_cmd_type_t;
+
+typedef struct mot_cmd
+{
+  mot_cmd_type_t type;
+  int32 arg[5];
+} mot_cmd_t;
+
+/* One motion segment (see mot_seg_move() and friends in motor.h). */
+typedef struct mot_seg
+{
+  mot_cmd_type_t type;		/* MOT_CMD_SEG_MOVE ... MOT_CMD_SEG_WAIT */
+  uint32 tick;			/* don't start before this (0: right
+				   after the one before) */
+  int32 s;			/* move: steps */
+  mot_accel_t a;		/* move, vel: acceleration */
+  mot_velocity_t v;		/* move, vel: velocity */
+  int jerk;			/* move, vel: ticks to ramp the
+				   acceleration over (0: trapezoid) */
+  bam32 heading;		/* heading: where to turn to */
+  bam32 steps;			/* heading: how far to turn per tick */
+  int wait;			/* heading: wait until we get there;
+				   wait: ticks to wait */
+  uint32 end;			/* wait: tick it ends at */
+} mot_seg_t;
+
 uint32 mot_curpos; /* position of center of platform. */
 int32 mot_wheel_velocity;
+mot_accel_t mot_wheel_accel;	/* Smoothed acceleration of the wheels,
+				   from the encoders. */
 
 
 uint32 mot_desired_pos;		/* Desired position of motor. */
@@ -60,6 +114,16 @@ mot_velocity_t mot_v;		/* Current velocity of motor. */
 mot_accel_t mot_a;		/* Acceleraion to apply. */
 mot_velocity_t mot_desired_v;	/* Desired velocity - when this is reached,
 				   'a' should be set to 0. */
+int mot_jerk;			/* Ticks the acceleration takes to ramp
+				   between 0 and mot_a (an S-curve); 0
+				   steps straight to mot_a (a trapezoid). */
+int32 mot_cur_a;		/* S-curve: acceleration being applied now,
+				   with 8 more fraction bits than mot_a. */
+int32 mot_v_frac;		/* S-curve: the 8 bits of velocity below
+				   mot_v's, so mot_v * 256 + mot_v_frac
+				   is the velocity as a 16.16 number. */
+int32 mot_v_frac_pos;		/* S-curve: mot_v_frac added up, until it
+				   makes 1/256 of a step. */
 
 int32 mot_preverr;		/* PID data - previous error. */
 int32 mot_interr;			/* PID data - integrated error. */
@@ -69,12 +133,16 @@ int32 mot_interr_bal;		/* PID data - integrated error (balancing) */
 
 int mot_stop_at_valid;		/* non-zero if a stopping point is defined. */
 int32 mot_stop_at;
+mot_velocity_t mot_stop_v;	/* Velocity to still have at the stopping
+				   point - non-zero when a move runs
+				   straight into the next segment. */
 
 int mot_next_cmd_valid;		/* non-zero if there is a command set up. */
 uint32 mot_next_cmd_time;	/* Time (in ticks) when next command should
 				   be applied. */
 mot_accel_t mot_next_a;		/* Acceleration of next command. */
 mot_accel_t mot_next_desired_v;	/* Velocity of next command. */
+int mot_next_jerk;		/* Jerk ramp (ticks) of next command. */
 int32 mot_next_s;		/* Number of steps to move for next command. */
 
 int mot_stopped;		/* Has the motor completed the last motion
@@ -91,9 +159,10 @@ uint32 mot_ticks;
 f16_16 mot_left_factor = 68813; /* 1.05 */
 f16_16 mot_right_factor = 65536; /* 1.0 */
 
-/* Current heading of robot, in degrees as a 16.16 number. */
-f16_16 mot_heading;
-f16_16 mot_desired_heading;
+/* Current heading of robot.  All the headings in here are binary
+   angles, so they wrap around at 360 on their own. */
+bam32 mot_heading;
+bam32 mot_desired_heading;
 
 /* tick at the last time we accepted a heading update.  Only accept a
    heading update every HEADING_UPDATE_TICKS ticks. */
@@ -103,10 +172,10 @@ uint32 mot_last_heading_update;
    just set mot_heading because the PID loop would freak out.  If we
    are in the process of turning to a specific heading, this will not
    be equal to mot_desired_heading until we get there. */
-f16_16 mot_heading_dest;
+bam32 mot_heading_dest;
 
 /* The maximum amount we will change mot_desired_heading per tick. */
-f16_16 mot_heading_steps = 15 * 65536 / MOTOR_HZ; /* 15 degrees per second. */
+bam32 mot_heading_steps = BAM32_DEG(15) / MOTOR_HZ; /* 15 degrees per second. */
 
 f16_16 mot_hd_preverr;
 f16_16 mot_hd_interr;
@@ -166,6 +235,51 @@ int mot_emergency;
 int mot_pending_emergency_cnt;
 int mot_emergency_cnt;
 
+/* What mot_get_status() returns.  mot_publish_status() copies the
+   live variables here whenever they change - at the end of every
+   mot_step(), and when balancing is turned on - and readers
+   copy it out under the sequence lock, so they get all the fields
+   from the same moment without turning off preemption. */
+static mot_status_t mot_status;
+static seqlock_t mot_status_lock = SEQLOCK_INIT;
+
+/* Commands for the motor task.  Instead of writing the motor task's
+   variables with the chain locked out, callers post commands here and
+   mot_step() applies them at the top of its next pass.  Command n
+   goes in slot n % MOT_CMD_SLOTS; the poster fills the slot before it
+   advances 'posted', so the motor task never sees half a command, and
+   the motor task acknowledges commands by advancing 'done' (which
+   also goes out in mot_status.cmd_done).  There is one consumer, and
+   mot_cmd_sem lets only one task post at a time - the motor task
+   never takes it. */
+static struct
+{
+  mot_cmd_t slot[MOT_CMD_SLOTS];
+  volatile uint32 posted;	/* advanced by the poster */
+  volatile uint32 done;		/* advanced by the motor task */
+} mot_cmds;
+static rtems_id mot_cmd_sem;
+
+/* Sequence numbers (the 'posted' count after posting) of the latest
+   motion and heading commands, so mot_get_status() doesn't report the
+   robot stopped before it has started on them. */
+static volatile uint32 mot_cmd_move_seq, mot_cmd_heading_seq;
+
+/* The motion segment queue.  Only the motor task touches it (or a
+   task holding control_lock()); segments come in through the command
+   ring.  mot_segs[mot_seg_head] is the one running, or the next one to
+   run if mot_seg_active is 0. */
+static mot_seg_t mot_segs[MOT_SEG_LEN];
+static int mot_seg_head, mot_seg_cnt, mot_seg_active;
+static uint32 mot_seg_done;	/* segments finished or flushed */
+
+/* Segments queued so far.  Only changed under mot_cmd_sem. */
+static uint32 mot_seg_posted;
+
+static const char *mot_seg_names[] = {
+  "move", "vel", "heading", "wait"
+};
+
 /* How many times the motor task failed to meet it's deadline. */
 uint32 motor_pos_task_timeouts = 0;
 
@@ -201,8 +315,10 @@ mot_log_pid_trace(int32 desired_tilt, int32 measured_tilt, uint32 desired_pos,
   mot_pid_trace[mot_pid_trace_idx].desired_pos = desired_pos;
   mot_pid_trace[mot_pid_trace_idx].measured_pos = measured_pos;
   mot_pid_trace[mot_pid_trace_idx].pid_out = pid_out;
-  mot_pid_trace[mot_pid_trace_idx].mot_heading = mot_heading;
-  mot_pid_trace[mot_pid_trace_idx].mot_desired_heading = mot_desired_heading;
+  mot_pid_trace[mot_pid_trace_idx].mot_heading =
+    f16_16_from_bam32(mot_heading);
+  mot_pid_trace[mot_pid_trace_idx].mot_desired_heading =
+    f16_16_from_bam32(mot_desired_heading);
 
   mot_pid_trace_idx++;
   if (mot_pid_trace_idx >= mot_pid_trace_size) {
@@ -267,22 +383,6 @@ mot_dump_pid_trace(void)
   mot_pid_trace_pause = 0;
 }
 
-/* Multiply two 24.8 fixed numbers.  Does the equivalent of long
-   multiplication. */
-int
-mult_24_8 (int a, int b)
-{
-  int a_frac = a & 0x000000ff;
-  int a_int  = (int) (a & 0xffffff00) / 256;
-  int b_frac = b & 0x000000ff;
-  int b_int  = (int) (b & 0xffffff00) / 256;
-
-  return ((a_frac * b_frac) >> 8) +
-    (a_frac * b_int) +
-    (a_int * b_frac) +
-    ((a_int * b_int) << 8);
-}
-
 int
 mot_do_pid (int kalman_angle, int do_tilt_update)
 {
@@ -302,12 +402,14 @@ mot_do_pid (int kalman_angle, int do_tilt_update)
 			  mult_24_8 (mot_kd, error - mot_preverr) +
 			  mult_24_8 (mot_ki, mot_interr));
 
-      if (mot_desired_tilt < min_tilt)
+      if (mot_desired_tilt < min_tilt) {
 	mot_desired_tilt = min_tilt;
-      else if (mot_desired_tilt > max_tilt)
+	FIXCHECK_SATURATED("desired_tilt");
+      } else if (mot_desired_tilt > max_tilt) {
 	mot_desired_tilt = max_tilt;
-      else
-	mot_interr += error;
+	FIXCHECK_SATURATED("desired_tilt");
+      } else
+	mot_interr = FIXCHECK_ADD(mot_interr, error);
 
       mot_preverr = error;
     }
@@ -325,12 +427,14 @@ mot_do_pid (int kalman_angle, int do_tilt_update)
     /* Accumulate integral error *OR* limit output.  Stop accumulating
        when output saturates.  Valid output values are 1 (max reverse)
        to 255 (max forward) with 128 being full stop. */
-    if (output >= 127)
+    if (output >= 127) {
       output = 127;
-    else if (output <= -127)
+      FIXCHECK_SATURATED("bal_output");
+    } else if (output <= -127) {
       output = -127;
-    else {
-      mot_interr_bal += error_bal;
+      FIXCHECK_SATURATED("bal_output");
+    } else {
+      mot_interr_bal = FIXCHECK_ADD(mot_interr_bal, error_bal);
     }
 
     mot_log_pid_trace(mot_desired_tilt, kalman_angle/256,
@@ -347,18 +451,9 @@ mot_do_heading_pid(void)
   int pid_out = 0;
 
   if (mot_bal_on) {
-    /* Calculating the error is funky because these are headings, and
-       wrap around at 360.  We want an error where a positive value
-       means we need to turn that many degrees to the right, and a
-       negative value means we need to turn that many degrees to the
-       left. */
-    error = mot_desired_heading - mot_heading;
-    if (error < 0)
-      error += 360 * 65536;
-
-    if (error > (180 * 65536)) {
-      error = error - (360 * 65536);
-    }
+    /* A positive error means we need to turn that many degrees to the
+       right, and a negative one that many degrees to the left. */
+    error = bam32_diff_f16_16(mot_desired_heading, mot_heading);
 
     pid_out = (mult_f16_16 (mot_hd_kp, error) +
 	       mult_f16_16 (mot_hd_kd, error - mot_hd_preverr) +
@@ -368,12 +463,14 @@ mot_do_heading_pid(void)
 
     /* Limit heading to only being able to affect up to 1/3 of the
        motor's pwm range. */
-    if (pid_out >= 43)
+    if (pid_out >= 43) {
       pid_out = 43;
-    else if (pid_out <= -43)
+      FIXCHECK_SATURATED("hd_output");
+    } else if (pid_out <= -43) {
       pid_out = -43;
-    else
-      mot_hd_interr += error;
+      FIXCHECK_SATURATED("hd_output");
+    } else
+      mot_hd_interr = FIXCHECK_ADD(mot_hd_interr, error);
   }
 
   /* NOTE: we do not add 128 to bring it into the 32-255 range like
@@ -402,6 +499,285 @@ mot_calc_stop_dist(mot_accel_t a, mot_velocity_t v)
   return rampdown_d;
 }
 
+/* How much an S-curve's acceleration changes per tick, with 8 more
+   fraction bits than 'a' (like mot_cur_a). */
+static int32
+mot_scurve_j(mot_accel_t a, int jerk)
+{
+  int32 j = abs(a) * 256 / jerk;
+
+  return j ? j : 1;
+}
+
+/* The S-curve is symmetric, so its average velocity is (v + v_end) / 2
+   and only its length T is needed: dv / a + jerk ticks when it gets up
+   to 'a', or 2 * sqrt(dv / j) when the two ramps meet first.  Done a
+   tick at a time, the curve is a tick shorter than that, and each
+   tick travels the velocity it ends with, which takes off one tick's
+   travel at v. */
+int
+mot_calc_scurve_dist(mot_accel_t a, int jerk, mot_velocity_t v,
+		     mot_velocity_t v_end)
+{
+  uint32 dv, j, t;
+  long long d;
+
+  if (jerk == 0)
+    return mot_calc_stop_dist(a, v) - mot_calc_stop_dist(a, v_end);
+
+  a = abs(a);
+  v = abs(v);
+  v_end = abs(v_end);
+  dv = abs(v - v_end);
+
+  if (dv == 0)
+    return 0;
+
+  /* j is rounded down, so the ramps really take a little longer. */
+  j = mot_scurve_j(a, jerk);
+  jerk = (a * 256 + j - 1) / j;
+
+  /* T, as a 24.8 number of ticks. */
+  if (dv >= (uint32)a * jerk)
+    t = (dv << 8) / a + (jerk << 8);
+  else
+    t = 2 * sqrti64(((unsigned long long)dv << 24) / j);
+
+  d = ((long long)(v + v_end) * t - ((long long)v << 9) + (1 << 16)) >> 17;
+  return (d > 0) ? d : 0;
+}
+
+/* Start using the jerk of a new move.  A trapezoid carries on from the
+   whole part of the velocity. */
+static void
+mot_set_jerk(int jerk)
+{
+  mot_jerk = jerk;
+  if (jerk == 0)
+    {
+      mot_cur_a = 0;
+      mot_v_frac = 0;
+      mot_v_frac_pos = 0;
+    }
+}
+
+/* Move the velocity one tick towards mot_desired_v along an S-curve:
+   the acceleration changes by at most mot_scurve_j() a tick, never
+   goes past mot_a, and eases off just early enough to get back to 0
+   as the velocity gets there. */
+static void
+mot_scurve_step(void)
+{
+  int32 v, dv, j, a, n, gain;
+  int dir;
+
+  v = mot_v * 256 + mot_v_frac;
+  dv = mot_desired_v * 256 - v;
+  if (dv == 0 && mot_cur_a == 0)
+    return;
+
+  j = mot_scurve_j(mot_a, mot_jerk);
+  dir = (dv < 0) ? -1 : 1;
+
+  /* Push the acceleration (further) towards the target velocity... */
+  a = mot_cur_a + dir * j;
+  if (abs(a) > mot_a * 256)
+    a = dir * mot_a * 256;
+
+  /* ...unless that would overshoot it: the velocity still changes by
+     a + (a - j) + ... + j, about a * (n + 1) / 2, while the
+     acceleration ramps back to 0. */
+  n = abs(a) / j;
+  gain = abs(a) * (n + 1) / 2;
+  if (a * dir > 0 && gain > abs(dv))
+    {
+      if (mot_cur_a * dir > j)
+	a = mot_cur_a - dir * j;
+      else
+	a = dv;			/* close enough to finish this tick */
+    }
+
+  mot_cur_a = a;
+  v += a;
+  if ((dir > 0) ? v >= mot_desired_v * 256 : v <= mot_desired_v * 256)
+    {
+      v = mot_desired_v * 256;
+      mot_cur_a = 0;
+    }
+
+  mot_v = v / 256;
+  mot_v_frac = v % 256;
+}
+
+/* How many steps the S-curve takes to get to mot_stop_v, starting
+   this tick at velocity v and acceleration a (16.16 numbers, a
+   positive when speeding up).  If it is still speeding up, it first
+   has to ease the acceleration back to 0, which takes it faster and
+   farther. */
+static int32
+mot_scurve_dist_from(int32 v, int32 a, int32 j)
+{
+  int32 n, gain;
+  long long ease;
+
+  n = 0;
+  gain = 0;
+  ease = 0;
+  if (a > 0)
+    {
+      /* Easing off takes n ticks, accelerating by a - j, a - 2j, ...
+	 a - nj, and each tick's velocity is travelled that tick. */
+      n = a / j;
+      gain = n * a - j * n * (n + 1) / 2;
+      ease = (long long)n * v + (long long)a * n * (n + 1) / 2 -
+	(long long)j * n * (n + 1) * (n + 2) / 6;
+    }
+
+  return (int32)((ease + 32768) / 65536) +
+    mot_calc_scurve_dist(mot_a, mot_jerk, (v + gain) / 256, mot_stop_v);
+}
+
+/* How many steps the S-curve takes to get from where it is now to
+   mot_stop_v, when there are 'left' steps to go.  Deceleration can
+   only start on a tick, and while speeding up the distance grows by
+   more than a tick's travel each tick, so if waiting for the next
+   tick would end farther past the stopping point than starting now
+   ends short of it, this says there's no room left. */
+static int32
+mot_scurve_rampdown(int32 left)
+{
+  int32 v, a, j, d, d_next, left_next;
+
+  v = abs(mot_v * 256 + mot_v_frac);
+  a = (mot_v < 0 || mot_v_frac < 0) ? -mot_cur_a : mot_cur_a;
+  j = mot_scurve_j(mot_a, mot_jerk);
+
+  d = mot_scurve_dist_from(v, a, j);
+  if (d >= left)
+    return d;
+
+  /* Where it would be a tick from now, still heading for the move's
+     velocity. */
+  if (v < abs(mot_desired_v) * 256)
+    a = MIN(a + j, mot_a * 256);
+  v += a;
+  left_next = left - (v + 32768) / 65536;
+  d_next = mot_scurve_dist_from(v, a, j);
+
+  return (d_next - left_next > left - d) ? left : d;
+}
+
+/* The velocity the move 'g' should still have when it gets to its
+   end, so that it runs straight into the segment after it: that
+   segment's velocity, if it is a move or velocity change the same way
+   that starts right away (but no faster than 'g' itself goes).
+   Otherwise 'g' stops. */
+static mot_velocity_t
+mot_seg_exit_v(const mot_seg_t *g)
+{
+  const mot_seg_t *next;
+
+  if (mot_seg_cnt < 2)
+    return 0;
+
+  next = &mot_segs[(mot_seg_head + 1) % MOT_SEG_LEN];
+  if ((next->type != MOT_CMD_SEG_MOVE && next->type != MOT_CMD_SEG_VEL) ||
+      next->tick != 0 ||
+      next->v == 0 || (next->v < 0) != (g->v < 0))
+    return 0;
+
+  return (abs(next->v) < abs(g->v)) ? next->v : g->v;
+}
+
+/* Start the segment 'g'. */
+static void
+mot_seg_start(mot_seg_t *g)
+{
+  switch (g->type) {
+  case MOT_CMD_SEG_MOVE:
+    mot_a = abs(g->a);
+    mot_desired_v = g->v;
+    mot_set_jerk(g->jerk);
+    if (g->v < 0)
+      mot_stop_at = mot_desired_pos - g->s;
+    else
+      mot_stop_at = mot_desired_pos + g->s;
+    mot_stop_at_valid = 1;
+    mot_stop_v = mot_seg_exit_v(g);
+    mot_stopped = 0;
+    break;
+
+  case MOT_CMD_SEG_VEL:
+    mot_a = abs(g->a);
+    mot_desired_v = g->v;
+    mot_set_jerk(g->jerk);
+    mot_stop_at_valid = 0;
+    mot_stop_v = 0;
+    mot_stopped = 0;
+    break;
+
+  case MOT_CMD_SEG_HEADING:
+    mot_heading_stopped = 0;
+    mot_heading_steps = g->steps;
+    mot_heading_dest = g->heading;
+    break;
+
+  default:
+    g->end = mot_ticks + g->wait;
+    break;
+  }
+}
+
+/* Non-zero once the running segment 'g' is done. */
+static int
+mot_seg_finished(mot_seg_t *g)
+{
+  switch (g->type) {
+  case MOT_CMD_SEG_MOVE:
+    /* Another segment may have been queued since it started. */
+    if (mot_stop_at_valid == 1)
+      mot_stop_v = mot_seg_exit_v(g);
+    return mot_stop_at_valid == 0;
+
+  case MOT_CMD_SEG_VEL:
+    return mot_v == mot_desired_v && mot_v_frac == 0;
+
+  case MOT_CMD_SEG_HEADING:
+    return !g->wait || mot_heading_stopped;
+
+  default:
+    return (int32)(mot_ticks - g->end) >= 0;
+  }
+}
+
+/* Run the motion segment queue: finish the running segment, and start
+   the ones after it as they come due.  The velocity is left alone
+   between segments, so they run back to back. */
+static void
+mot_seg_run(void)
+{
+  mot_seg_t *g;
+
+  while (mot_seg_cnt != 0) {
+    g = &mot_segs[mot_seg_head];
+
+    if (!mot_seg_active) {
+      if (g->tick != 0 && (int32)(mot_ticks - g->tick) < 0)
+	return;
+      mot_seg_start(g);
+      mot_seg_active = 1;
+    }
+
+    if (!mot_seg_finished(g))
+      return;
+
+    mot_seg_head = (mot_seg_head + 1) % MOT_SEG_LEN;
+    mot_seg_cnt--;
+    mot_seg_done++;
+    mot_seg_active = 0;
+  }
+}
+
 void
 mot_do_motion(void)
 {
@@ -411,6 +787,8 @@ mot_do_motion(void)
     {
       mot_a = abs(mot_next_a);
       mot_desired_v = mot_next_desired_v;
+      mot_set_jerk(mot_next_jerk);
+      mot_stop_v = 0;
 
       if (mot_next_s)
 	{
@@ -424,15 +802,32 @@ mot_do_motion(void)
       mot_stopped = 0;
     }
 
+  /* Then the queued path, if there is one. */
+  mot_seg_run();
+
   /* If a stopping point is set, check if we need to start decelerating. */
   if (mot_stop_at_valid == 1)
     {
       int32 rampdown_t, rampdown_d;
 
-      /* Calculate amount of time to decelerate from current v
-	 to 0 and distance traveled. */
-      rampdown_t = (abs(mot_v) - mot_a + (mot_a/2)) / mot_a;
-      rampdown_d = (sum_1ton(rampdown_t) * mot_a + 128) / 256;
+      if (mot_jerk != 0)
+	{
+	  /* S-curve: straight to mot_stop_v in closed form. */
+	  rampdown_t = mot_jerk;
+	  rampdown_d = mot_scurve_rampdown(abs(mot_desired_pos - mot_stop_at));
+	}
+      else
+	{
+	  /* Calculate amount of time to decelerate from current v
+	     to 0 and distance traveled. */
+	  rampdown_t = (abs(mot_v) - mot_a + (mot_a/2)) / mot_a;
+	  rampdown_d = (sum_1ton(rampdown_t) * mot_a + 128) / 256;
+
+	  /* If we're running into another segment, only slow down to
+	     its velocity. */
+	  if (mot_stop_v != 0)
+	    rampdown_d -= mot_calc_stop_dist(mot_a, mot_stop_v);
+	}
 
       if (rampdown_d >= abs(mot_desired_pos - mot_stop_at))
 	{
@@ -441,7 +836,7 @@ mot_do_motion(void)
 	   */
 	  TRACE_LOG6(ROBOT, START_DECEL, mot_v, mot_a, rampdown_t, rampdown_d,
 		     mot_desired_pos, mot_stop_at);
-	  mot_desired_v = 0;
+	  mot_desired_v = mot_stop_v;
 	  mot_stop_at_valid = 2;
 	}
     }
@@ -473,7 +868,9 @@ mot_do_motion(void)
     }
 
   /* Update the velocity. */
-  if (mot_v < mot_desired_v)
+  if (mot_jerk != 0)
+    mot_scurve_step();
+  else if (mot_v < mot_desired_v)
     {
       mot_v += mot_a;
       if (mot_v > mot_desired_v)
@@ -486,7 +883,7 @@ mot_do_motion(void)
 	mot_v = mot_desired_v;
     }
 
-  if ((mot_v == 0) && (mot_stop_at_valid == 2))
+  if ((mot_v == 0) && (mot_v_frac == 0) && (mot_stop_at_valid == 2))
     {
       TRACE_LOG3(ROBOT, DECEL_COMPLETE, 
 		 mot_desired_pos, mot_stop_at,
@@ -500,8 +897,19 @@ mot_do_motion(void)
   else
     {
       mot_desired_pos_frac += mot_v;
+      mot_v_frac_pos += mot_v_frac;
+      mot_desired_pos_frac += mot_v_frac_pos / 256;
+      mot_v_frac_pos %= 256;
       mot_desired_pos += mot_desired_pos_frac / 256;
       mot_desired_pos_frac %= 256;
+
+      /* A move that runs into the next segment is done when it gets
+	 to its stopping point. */
+      if (mot_stop_at_valid && mot_stop_v != 0 &&
+	  ((mot_stop_v > 0) ?
+	   (int32)(mot_desired_pos - mot_stop_at) >= 0 :
+	   (int32)(mot_desired_pos - mot_stop_at) <= 0))
+	mot_stop_at_valid = 0;
     }
 }
 
@@ -509,23 +917,14 @@ mot_do_motion(void)
 void
 mot_do_heading_motion(void)
 {
-  f16_16 delta_dir;
+  bam32 delta_dir = mot_heading_dest - mot_desired_heading;
 
-  if (abs_dir_diff_f16_16(mot_desired_heading, mot_heading_dest) >
+  if (bam32_abs_diff(mot_heading_dest, mot_desired_heading) >
       mot_heading_steps) {
-    delta_dir = mot_heading_dest - mot_desired_heading;
-    if (delta_dir < 0)
-      delta_dir += 360*65536;
-    
-    if (delta_dir < 180*65536) {
+    if ((int)delta_dir > 0)
       mot_desired_heading += mot_heading_steps;
-      if (mot_desired_heading >= 360*65536)
-	mot_desired_heading -= 360*65536;
-    } else {
+    else
       mot_desired_heading -= mot_heading_steps;
-      if (mot_desired_heading < 0)
-	mot_desired_heading += 360*65536;
-    }
   } else {
     /* If we're here, the desired_heading is within mot_heading_steps
        of mot_heading_dest.  Just make it match. */
@@ -542,8 +941,10 @@ mot_check_stopped(void)
 {
   if ((mot_bal_on == 0) ||
       ((mot_v == 0) &&
+       (mot_v_frac == 0) &&
        (mot_desired_v == 0) &&
        (mot_next_cmd_valid == 0) &&
+       (mot_seg_cnt == 0) &&
        (abs(mot_curpos - mot_desired_pos) < 100) &&
        (abs(mot_preverr) < 100) &&
        (mot_wheel_velocity == 0)))
@@ -558,7 +959,7 @@ mot_check_stopped(void)
   /* Similarly, check if we're close to the right heading. */
   if ((mot_bal_on == 0) ||
       ((mot_desired_heading == mot_heading_dest) &&
-       (abs_dir_diff_f16_16(mot_desired_heading, mot_heading) < (3 * 65536))))
+       (bam32_abs_diff(mot_desired_heading, mot_heading) < BAM32_DEG(3))))
     {
       mot_heading_stopped = 1;
     }
@@ -568,24 +969,391 @@ mot_check_stopped(void)
     }
 }
 
-rtems_task
-motor_pos_task (rtems_task_argument ignored)
+/* Encoder readings as of the last mot_step(). */
+static short prev_fqd0, prev_fqd1;
+
+/* Copy the live motor status to where mot_get_status() reads it.
+   Callers must not be preemptible by another writer: this is only
+   called from mot_step(), and under control_lock(). */
+static void
+mot_publish_status(void)
+{
+  seqlock_write_begin(&mot_status_lock);
+  mot_status.pos = mot_desired_pos /* mot_curpos */;
+  mot_status.velocity = mot_v;
+  mot_status.accel = mot_a;
+  mot_status.tick = mot_ticks;
+  mot_status.stopped = mot_stopped;
+  mot_status.heading_stopped = mot_heading_stopped;
+  mot_status.emergency = mot_emergency;
+  mot_status.cmd_done = mot_cmds.done;
+  mot_status.seg_done = mot_seg_done;
+  mot_status.seg_queued = mot_seg_cnt;
+  seqlock_write_end(&mot_status_lock);
+}
+
+/* Queue a command for the motor task.  Waits for a free slot if the
+   motor task is behind.  A segment is only posted if there's room for
+   it in the segment queue: returns 0 if the command was posted, 2 if
+   the segment queue is full. */
+static int
+mot_post_cmd(mot_cmd_type_t type, int32 a0, int32 a1, int32 a2, int32 a3,
+	     int32 a4)
 {
-  short prev_fqd0, prev_fqd1;
+  mot_cmd_t *c;
+  uint32 seq;
+  int seg = (type >= MOT_CMD_SEG_MOVE && type != MOT_CMD_SEG_FLUSH);
+
+  rtems_semaphore_obtain (mot_cmd_sem, RTEMS_WAIT, RTEMS_NO_TIMEOUT);
+
+  /* Count segments in under the semaphore, so two tasks can't both
+     take the last place in the queue. */
+  if (seg)
+    {
+      if (mot_seg_pending() >= MOT_SEG_LEN)
+	{
+	  rtems_semaphore_release (mot_cmd_sem);
+	  return 2;
+	}
+      mot_seg_posted++;
+    }
+
+  seq = mot_cmds.posted;
+  while (seq - mot_cmds.done >= MOT_CMD_SLOTS)
+    rtems_task_wake_after(1);
+
+  c = &mot_cmds.slot[seq % MOT_CMD_SLOTS];
+  c->type = type;
+  c->arg[0] = a0;
+  c->arg[1] = a1;
+  c->arg[2] = a2;
+  c->arg[3] = a3;
+  c->arg[4] = a4;
+  seq++;
+
+  /* A flush queues nothing, so it doesn't count as a move about to
+     start. */
+  if (type == MOT_CMD_MOVE || seg)
+    mot_cmd_move_seq = seq;
+  if (type == MOT_CMD_HEADING || type == MOT_CMD_SEG_HEADING)
+    mot_cmd_heading_seq = seq;
+
+  /* The slot must be written before the motor task can see it. */
+  SEQLOCK_BARRIER();
+  mot_cmds.posted = seq;
+
+  rtems_semaphore_release (mot_cmd_sem);
+
+  return 0;
+}
+
+/* Drop every queued segment, including the one running. */
+static void
+mot_seg_clear(void)
+{
+  mot_seg_done += mot_seg_cnt;
+  mot_seg_head = (mot_seg_head + mot_seg_cnt) % MOT_SEG_LEN;
+  mot_seg_cnt = 0;
+  mot_seg_active = 0;
+  mot_stop_v = 0;
+}
+
+/* Add a segment to the end of the queue.  mot_post_cmd() only posts
+   a segment when there's room for it, so the queue can't be full. */
+static void
+mot_seg_add(const mot_cmd_t *c)
+{
+  mot_seg_t *g;
+
+  g = &mot_segs[(mot_seg_head + mot_seg_cnt) % MOT_SEG_LEN];
+  g->type = c->type;
+  g->tick = 0;
+  switch (c->type) {
+  case MOT_CMD_SEG_MOVE:
+    g->s = c->arg[0];
+    g->a = c->arg[1];
+    g->v = c->arg[2];
+    g->tick = c->arg[3];
+    g->jerk = c->arg[4];
+    break;
+
+  case MOT_CMD_SEG_VEL:
+    g->a = c->arg[0];
+    g->v = c->arg[1];
+    g->tick = c->arg[2];
+    g->jerk = c->arg[3];
+    break;
+
+  case MOT_CMD_SEG_HEADING:
+    g->heading = c->arg[0];
+    g->steps = c->arg[1];
+    g->wait = c->arg[2];
+    g->tick = c->arg[3];
+    break;
+
+  default:
+    g->wait = c->arg[0];
+    break;
+  }
+  mot_seg_cnt++;
+}
+
+/* Apply one command.  Runs in mot_step(). */
+static void
+mot_apply_cmd(const mot_cmd_t *c)
+{
+  switch (c->type) {
+  case MOT_CMD_MOVE:
+    /* A move straight from mot_move() or mot_set_vel() replaces any
+       queued path. */
+    mot_seg_clear();
+    mot_stop_at_valid = 0;
+    mot_next_cmd_valid = 1;
+    mot_next_s = c->arg[0];
+    mot_next_a = c->arg[1];
+    mot_next_desired_v = c->arg[2];
+    mot_next_cmd_time = c->arg[3];
+    mot_next_jerk = c->arg[4];
+    mot_stopped = 0;
+    break;
+
+  case MOT_CMD_HEADING:
+    mot_heading_stopped = 0;
+    mot_heading_dest = c->arg[0];
+    mot_heading_steps = c->arg[1];
+    break;
+
+  case MOT_CMD_PID:
+    mot_kp = c->arg[0];
+    mot_kd = c->arg[1];
+    mot_ki = c->arg[2];
+    break;
+
+  case MOT_CMD_BAL_PID:
+    mot_bal_kp = c->arg[0];
+    mot_bal_kd = c->arg[1];
+    mot_bal_ki = c->arg[2];
+    break;
+
+  case MOT_CMD_HD_PID:
+    mot_hd_kp = c->arg[0];
+    mot_hd_kd = c->arg[1];
+    mot_hd_ki = c->arg[2];
+    break;
+
+  case MOT_CMD_SEG_FLUSH:
+    /* Drop the path, and come to a stop. */
+    mot_seg_clear();
+    mot_next_cmd_valid = 0;
+    mot_stop_at_valid = 0;
+    mot_desired_v = 0;
+    break;
+
+  default:
+    mot_seg_add(c);
+    break;
+  }
+}
+
+/* Apply every command posted since the last pass, in order. */
+static void
+mot_drain_cmds(void)
+{
+  uint32 done = mot_cmds.done;
+  uint32 posted = mot_cmds.posted;
+
+  /* Don't read the slots before 'posted'. */
+  SEQLOCK_BARRIER();
+
+  while (done != posted)
+    mot_apply_cmd(&mot_cmds.slot[done++ % MOT_CMD_SLOTS]);
+
+  /* Done with the slots before handing them back. */
+  SEQLOCK_BARRIER();
+  mot_cmds.done = done;
+}
+
+/* One pass of the motor control: reads the encoders, runs the motion
+   control and PID loops, and sets the motors.  This is the act step
+   of the control chain. */
+void
+mot_step(void)
+{
+  static int do_tilt_update_counter = 0;
+  static int toggle_rounding = 1;
+  static int prev_diff_sum = 0;
   short new_fqd0, new_fqd1;
   short diff;
   int diff0, diff1;
-  rtems_name period_name;
-  rtems_id period;
-  rtems_status_code status;
   int kalman_out;
   int pwm0, pwm1;
   int pwm_l, pwm_r;
-  int do_tilt_update_counter = 0, do_tilt_update;
-  f16_16 heading_update;
-  int toggle_rounding = 1;
+  int do_tilt_update;
   int bal_switch;
 
+  mot_drain_cmds();
+
+  /* Check if we should turn balancing on or off: */
+  bal_switch = (*PORTE0 & PORTE_BALANCE_ON) != 0;
+  if (mot_bal_switch != bal_switch) {
+    mot_bal_switch = bal_switch;
+    mot_balance(mot_bal_switch);
+  }
+
+  /* emergency recovery does not seem to be helpful. */
+#if 0
+  /* Check if we need to do emergency recovery, or if we can turn
+     off emergency mode. */
+  if (mot_bal_on) {
+    if (mot_emergency == 0) {
+      if ((mot_desired_tilt >= mot_max_tilt) ||
+	  (mot_desired_tilt <= mot_min_tilt) ||
+	  (abs(mot_wheel_velocity) > 5)) {
+	mot_pending_emergency_cnt++;
+      } else {
+	mot_pending_emergency_cnt = 0;
+      }
+
+      if ((mot_preverr > (MOT_STEPS_PER_INCH)*6) ||
+	  (mot_pending_emergency_cnt >= (MOTOR_HZ))) {
+	/* Emergency! */
+	TRACE_LOG2(ROBOT, EMERGENCY, mot_preverr,
+		   mot_pending_emergency_cnt);
+	mot_pending_emergency_cnt = 0;
+	mot_emergency_cnt = 0;
+	mot_emergency = 1;
+
+	/* Grant the balance PID loop emergency powers. */
+	mot_max_tilt = mot_emergency_max_tilt;
+	mot_min_tilt = mot_emergency_min_tilt;
+
+	mot_desired_tilt = 0;
+	kalman_out = kalman_read();
+
+	/* Try to come to a rest quickly - if we're tilted forward,
+	   set our desired position a little bit backward, otherwise
+	   set it a little bit forward. */
+	mot_desired_pos = mot_curpos -
+	  (kalman_out / 256 * MOT_STEPS_PER_INCH / mot_max_tilt );
+	mot_desired_pos_frac = 0;
+	mot_interr = 0;
+	mot_preverr = 0;
+
+	mot_next_cmd_valid = 0;
+	mot_stop_at_valid = 0;
+	mot_v = 0;
+	mot_v_frac = 0;
+	mot_cur_a = 0;
+	mot_desired_v = 0;
+
+	mot_desired_heading = mot_heading;
+      }
+    } else {
+      /* In emergency mode, check if we're safe to exit. */
+      mot_emergency_cnt++;
+      if ((abs(mot_curpos - mot_desired_pos) < 100) &&
+	  (abs(mot_preverr) < 100) &&
+	  (abs(kalman_read() < 65536/2))) {
+	mot_pending_emergency_cnt++;
+
+	if (mot_emergency_cnt >= MOTOR_HZ*2) {
+	  /* We're not recovering!  Set position again. */
+	  mot_desired_tilt = 0;
+
+	  mot_desired_pos = mot_curpos -
+	    (kalman_out / 256 * MOT_STEPS_PER_INCH / mot_max_tilt );
+
+	  mot_desired_pos_frac = 0;
+	  mot_interr = 0;
+	  mot_preverr = 0;
+
+	  mot_emergency_cnt = 0;
+	}
+      } else {
+	mot_pending_emergency_cnt = 0;
+      }
+
+      if (mot_pending_emergency_cnt >= MOTOR_HZ/2) {
+	TRACE_LOG0(ROBOT, EMERGENCY_CLEAR);
+	mot_emergency = 0;
+	mot_pending_emergency_cnt = 0;
+	mot_emergency_cnt = 0;
+
+	/* Revoke the balance PID loop's emergency powers. */
+	mot_max_tilt = mot_normal_max_tilt;
+	mot_min_tilt = mot_normal_min_tilt;
+      }
+    }
+  }
+#endif
+
+  if (do_tilt_update_counter++ == TILT_UPDATE_INTERVAL) {
+    do_tilt_update = 1;
+    do_tilt_update_counter = 0;
+  } else
+    do_tilt_update = 0;
+
+  /* First, get current position of each motor. */
+  new_fqd0 = read_tpu_fqd0();
+  new_fqd1 = read_tpu_fqd1();
+
+  diff = new_fqd0 - prev_fqd0;
+  diff0 = diff;
+  mot_info[0].curpos = mot_info[0].curpos + diff;
+  prev_fqd0 = new_fqd0;
+
+  diff = new_fqd1 - prev_fqd1;
+  diff1 = diff;
+  mot_info[1].curpos = mot_info[1].curpos + diff;
+  prev_fqd1 = new_fqd1;
+
+  /* Update heading. */
+  mot_heading += (bam32)((diff0 - diff1) * MOT_BAM32_PER_STEP);
+
+  /* Update current position. */
+  mot_wheel_velocity = (diff0 + diff1 + toggle_rounding)/2;
+  mot_curpos += mot_wheel_velocity;
+  toggle_rounding = -toggle_rounding;
+
+  /* Wheel acceleration, from the change in (twice) the velocity before
+     it gets rounded, smoothed over about 8 ticks. */
+  mot_wheel_accel += ((diff0 + diff1 - prev_diff_sum) * 128 -
+		      mot_wheel_accel) / 8;
+  prev_diff_sum = diff0 + diff1;
+
+  /* Get tilt of robot. */
+  kalman_out = kalman_read();
+
+  /* Do PID loops. */
+  mot_check_stopped();
+  mot_do_motion();
+  pwm0 = mot_do_pid(kalman_out, do_tilt_update);
+
+  mot_do_heading_motion();
+  pwm1 = mot_do_heading_pid();
+
+  pwm_l = (((pwm0+pwm1) * mot_left_factor + 32768)/65536) + 128;
+  pwm_r = (((pwm0-pwm1) * mot_left_factor + 32768)/65536) + 128;
+
+  set_tpu_pwm0(MIN(MAX(pwm_l, 16), 255));
+  set_tpu_pwm1(MIN(MAX(pwm_r, 16), 255));
+  control_mark_output();
+
+  /* Finally, update ticks */
+  mot_ticks++;
+
+  mot_publish_status();
+}
+
+#ifdef CONTROL_SEPARATE_TASKS
+rtems_task
+motor_pos_task (rtems_task_argument ignored)
+{
+  rtems_name period_name;
+  rtems_id period;
+  rtems_status_code status;
+  PROF_DECL(t);
+
   period_name = rtems_build_name ('M', 'T', 'P', 'D');
   status = rtems_rate_monotonic_create (period_name, &period);
   if (status != RTEMS_SUCCESSFUL)
@@ -595,8 +1363,6 @@ motor_pos_task (rtems_task_argument ignored)
       exit (1);
     }
 
-  prev_fqd0 = read_tpu_fqd0();
-  prev_fqd1 = read_tpu_fqd1();
   while (1)
     {
       if (rtems_rate_monotonic_period (period, ticks_per_sec/MOTOR_HZ) ==
@@ -606,154 +1372,13 @@ motor_pos_task (rtems_task_argument ignored)
 	     our next timeout, until the end of time... */
 	  motor_pos_task_timeouts++;
 	}
+      PROF_START(t);
 
-      /* Check if we should turn balancing on or off: */
-      bal_switch = (*PORTE0 & PORTE_BALANCE_ON) != 0;
-      if (mot_bal_switch != bal_switch) {
-	mot_bal_switch = bal_switch;
-	mot_balance(mot_bal_switch);
-      }
-
-      /* emergency recovery does not seem to be helpful. */
-#if 0
-      /* Check if we need to do emergency recovery, or if we can turn
-	 off emergency mode. */
-      if (mot_bal_on) {
-	if (mot_emergency == 0) {
-	  if ((mot_desired_tilt >= mot_max_tilt) ||
-	      (mot_desired_tilt <= mot_min_tilt) ||
-	      (abs(mot_wheel_velocity) > 5)) {
-	    mot_pending_emergency_cnt++;
-	  } else {
-	    mot_pending_emergency_cnt = 0;
-	  }
-
-	  if ((mot_preverr > (MOT_STEPS_PER_INCH)*6) ||
-	      (mot_pending_emergency_cnt >= (MOTOR_HZ))) {
-	    /* Emergency! */
-	    TRACE_LOG2(ROBOT, EMERGENCY, mot_preverr,
-		       mot_pending_emergency_cnt);
-	    mot_pending_emergency_cnt = 0;
-	    mot_emergency_cnt = 0;
-	    mot_emergency = 1;
-
-	    /* Grant the balance PID loop emergency powers. */
-	    mot_max_tilt = mot_emergency_max_tilt;
-	    mot_min_tilt = mot_emergency_min_tilt;
-
-	    mot_desired_tilt = 0;
-	    kalman_out = kalman_read();
-
-	    /* Try to come to a rest quickly - if we're tilted forward,
-	       set our desired position a little bit backward, otherwise
-	       set it a little bit forward. */
-	    mot_desired_pos = mot_curpos -
-	      (kalman_out / 256 * MOT_STEPS_PER_INCH / mot_max_tilt );
-	    mot_desired_pos_frac = 0;
-	    mot_interr = 0;
-	    mot_preverr = 0;
-
-	    mot_next_cmd_valid = 0;
-	    mot_stop_at_valid = 0;
-	    mot_v = 0;
-	    mot_desired_v = 0;
-
-	    mot_desired_heading = mot_heading;
-	  }
-	} else {
-	  /* In emergency mode, check if we're safe to exit. */
-	  mot_emergency_cnt++;
-	  if ((abs(mot_curpos - mot_desired_pos) < 100) &&
-	      (abs(mot_preverr) < 100) &&
-	      (abs(kalman_read() < 65536/2))) {
-	    mot_pending_emergency_cnt++;
-
-	    if (mot_emergency_cnt >= MOTOR_HZ*2) {
-	      /* We're not recovering!  Set position again. */
-	      mot_desired_tilt = 0;
-
-	      mot_desired_pos = mot_curpos -
-		(kalman_out / 256 * MOT_STEPS_PER_INCH / mot_max_tilt );
-
-	      mot_desired_pos_frac = 0;
-	      mot_interr = 0;
-	      mot_preverr = 0;
-
-	      mot_emergency_cnt = 0;
-	    }
-	  } else {
-	    mot_pending_emergency_cnt = 0;
-	  }
-
-	  if (mot_pending_emergency_cnt >= MOTOR_HZ/2) {
-	    TRACE_LOG0(ROBOT, EMERGENCY_CLEAR);
-	    mot_emergency = 0;
-	    mot_pending_emergency_cnt = 0;
-	    mot_emergency_cnt = 0;
-
-	    /* Revoke the balance PID loop's emergency powers. */
-	    mot_max_tilt = mot_normal_max_tilt;
-	    mot_min_tilt = mot_normal_min_tilt;
-	  }
-	}
-      }
-#endif
-
-      if (do_tilt_update_counter++ == TILT_UPDATE_INTERVAL) {
-	do_tilt_update = 1;
-	do_tilt_update_counter = 0;
-      } else
-	do_tilt_update = 0;
-
-      /* First, get current position of each motor. */
-      new_fqd0 = read_tpu_fqd0();
-      new_fqd1 = read_tpu_fqd1();
-
-      diff = new_fqd0 - prev_fqd0;
-      diff0 = diff;
-      mot_info[0].curpos = mot_info[0].curpos + diff;
-      prev_fqd0 = new_fqd0;
-
-      diff = new_fqd1 - prev_fqd1;
-      diff1 = diff;
-      mot_info[1].curpos = mot_info[1].curpos + diff;
-      prev_fqd1 = new_fqd1;
-
-      /* Update heading. */
-      heading_update = (diff0 - diff1) * 65536 / MOT_WHEEL_BASE; /* in radians. */
-      heading_update = div_f16_16 (heading_update * 180, F16_16_PI);
-      mot_heading += heading_update;
-      if (mot_heading >= 360*65536)
-	mot_heading -= 360*65536;
-      if (mot_heading < 0)
-	mot_heading += 360*65536;
-
-      /* Update current position. */
-      mot_wheel_velocity = (diff0 + diff1 + toggle_rounding)/2;
-      mot_curpos += mot_wheel_velocity;
-      toggle_rounding = -toggle_rounding;
-
-      /* Get tilt of robot. */
-      kalman_out = kalman_read();
-
-      /* Do PID loops. */
-      mot_check_stopped();
-      mot_do_motion();
-      pwm0 = mot_do_pid(kalman_out, do_tilt_update);
-
-      mot_do_heading_motion();
-      pwm1 = mot_do_heading_pid();
-
-      pwm_l = (((pwm0+pwm1) * mot_left_factor + 32768)/65536) + 128;
-      pwm_r = (((pwm0-pwm1) * mot_left_factor + 32768)/65536) + 128;
-
-      set_tpu_pwm0(MIN(MAX(pwm_l, 16), 255));
-      set_tpu_pwm1(MIN(MAX(pwm_r, 16), 255));
-
-      /* Finally, update ticks */
-      mot_ticks++;
+      mot_step();
+      PROF_SINCE(PROF_MOTOR, t);
     }
 }
+#endif
 
 /* Initialize the motor controller.  Returns 0 on success, non-zero
    on error. */
@@ -762,7 +1387,9 @@ mot_init(void)
 {
   int i;
   rtems_status_code code;
+#ifdef CONTROL_SEPARATE_TASKS
   Objects_Id t1;
+#endif
 
   printf ("Initializing fqd:\n");
   init_tpu_fqd();
@@ -793,10 +1420,14 @@ mot_init(void)
     }
   mot_curpos = 0;
   mot_wheel_velocity = 0;
+  mot_wheel_accel = 0;
   mot_desired_pos = 0;
   mot_desired_pos_frac = 0;
   mot_v = 0;
+  mot_v_frac = 0;
   mot_a = 0;
+  mot_cur_a = 0;
+  mot_jerk = 0;
   mot_desired_v = 0;
   mot_stopped = 0;
   mot_preverr = 0;
@@ -806,6 +1437,23 @@ mot_init(void)
   mot_stop_at_valid = 0;
   mot_next_cmd_valid = 0;
 
+  code = rtems_semaphore_create(rtems_build_name('M', 'C', 'M', 'D'),
+				1,
+				RTEMS_PRIORITY | RTEMS_BINARY_SEMAPHORE |
+				RTEMS_INHERIT_PRIORITY |
+				RTEMS_NO_PRIORITY_CEILING | RTEMS_LOCAL,
+				255, &mot_cmd_sem);
+  if (code != RTEMS_SUCCESSFUL)
+    printf ("mot_init: can't create mot_cmd_sem (%d)\n", code);
+
+  prev_fqd0 = read_tpu_fqd0();
+  prev_fqd1 = read_tpu_fqd1();
+
+  mot_publish_status();
+
+#ifndef CONTROL_SEPARATE_TASKS
+  control_register(CONTROL_ACT, "motor", mot_step);
+#else
   printf ("Spawning motor position task:\n");
   code = rtems_task_create(rtems_build_name('M', 'O', 'T', 'R'),
 			   5, RTEMS_MINIMUM_STACK_SIZE * 2,
@@ -815,6 +1463,7 @@ mot_init(void)
   printf ("  rtems_task_create returned %d; t1 = 0x%08x\n", code, t1);
   code = rtems_task_start(t1, motor_pos_task, 0);
   printf ("Done. (rtems_task_start returned %d)\n\n", code);
+#endif
 
   return 0;
 }
@@ -827,53 +1476,62 @@ mot_get_ticks(void)
   return mot_ticks;
 }
 
+/* Get the wheels' acceleration, measured by the encoders and
+   smoothed over a few ticks. */
+mot_accel_t
+mot_get_wheel_accel(void)
+{
+  return mot_wheel_accel;
+}
+
 /* Get the PID loop constants.  Values are in 24.8 format. */
 void
 mot_get_pid(int32 *kp, int32 *kd, int32 *ki)
 {
-  rtems_mode prev_mode, dummy;
+  control_lock_t lock;
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
+  control_lock(lock);
 
   *kp = mot_kp;
   *kd = mot_kd;
   *ki = mot_ki;
 
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  control_unlock(lock);
 }
 
 /* Set the PID loop constants.  Values are in 24.8 format. */
 void
 mot_set_pid(int32 kp, int32 kd, int32 ki)
 {
-  rtems_mode prev_mode, dummy;
-
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
-  mot_kp = kp;
-  mot_kd = kd;
-  mot_ki = ki;
-
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  mot_post_cmd(MOT_CMD_PID, kp, kd, ki, 0, 0);
 }
 
 /* Get the motor status. */
 void
 mot_get_status(mot_status_t *mot0p)
 {
-  rtems_mode prev_mode, dummy;
-
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
-  mot0p->pos = mot_desired_pos /* mot_curpos */;
-  mot0p->velocity = mot_v;
-  mot0p->accel = mot_a;
-  mot0p->tick = mot_ticks;
-  mot0p->stopped = mot_stopped;
-  mot0p->heading_stopped = mot_heading_stopped;
-  mot0p->emergency = mot_emergency;
+  unsigned int seq;
+
+  do {
+    seq = seqlock_read_begin(&mot_status_lock);
+    *mot0p = mot_status;
+  } while (seqlock_read_retry(&mot_status_lock, seq));
+
+  /* A motion or heading command the motor task hasn't got to yet is
+     about to start the robot moving. */
+  if ((int32)(mot0p->cmd_done - mot_cmd_move_seq) < 0)
+    mot0p->stopped = 0;
+  if ((int32)(mot0p->cmd_done - mot_cmd_heading_seq) < 0)
+    mot0p->heading_stopped = 0;
+}
 
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+/* Keep a jerk ramp (ticks) in the range the S-curve can handle. */
+static int
+mot_clamp_jerk(int jerk)
+{
+  if (jerk < 0)
+    return 0;
+  return (jerk > MOT_JERK_MAX) ? MOT_JERK_MAX : jerk;
 }
 
 /* Ramp a motor up (or down) to velocity 'v' using acceleration 'a'
@@ -881,26 +1539,21 @@ mot_get_status(mot_status_t *mot0p)
 int
 mot_set_vel(mot_accel_t a, mot_velocity_t v, uint32 tick)
 {
-  rtems_mode prev_mode, dummy;
+  return mot_set_vel_jerk(a, v, 0, tick);
+}
 
-  TRACE_LOG3(ROBOT, SET_VEL, a, v, tick);
+/* The same, along an S-curve. */
+int
+mot_set_vel_jerk(mot_accel_t a, mot_velocity_t v, int jerk, uint32 tick)
+{
+  TRACE_LOG4(ROBOT, SET_VEL, a, v, jerk, tick);
 
   if (mot_emergency) {
     TRACE_LOG0(ROBOT, EMERGENCY_IGNORED);
     return 1;
   }
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
-  mot_stop_at_valid = 0;
-  mot_next_cmd_valid = 1;
-  mot_next_cmd_time = tick;
-  mot_next_a = a;
-  mot_next_desired_v = v;
-  mot_next_s = 0;
-  mot_stopped = 0;
-
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  mot_post_cmd(MOT_CMD_MOVE, 0, a, v, tick, mot_clamp_jerk(jerk));
 
   return 0;
 }
@@ -910,31 +1563,27 @@ mot_set_vel(mot_accel_t a, mot_velocity_t v, uint32 tick)
 int
 mot_move(int32 s, mot_accel_t a, mot_velocity_t v, uint32 tick)
 {
-  rtems_mode prev_mode, dummy;
+  return mot_move_jerk(s, a, v, 0, tick);
+}
 
-  TRACE_LOG4(ROBOT, MOVE, s, a, v, tick);
+/* The same, along an S-curve. */
+int
+mot_move_jerk(int32 s, mot_accel_t a, mot_velocity_t v, int jerk,
+	      uint32 tick)
+{
+  TRACE_LOG5(ROBOT, MOVE, s, a, v, jerk, tick);
 
   if (mot_emergency) {
     TRACE_LOG0(ROBOT, EMERGENCY_IGNORED);
     return 1;
   }
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
 #if 0
   if (v == 0)
     s = 0; /* ignore steps if velocity is 0. */
 #endif
 
-  mot_stop_at_valid = 0;
-  mot_next_cmd_valid = 1;
-  mot_next_cmd_time = tick;
-  mot_next_a = a;
-  mot_next_desired_v = v;
-  mot_next_s = s;
-  mot_stopped = 0;
-
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  mot_post_cmd(MOT_CMD_MOVE, s, a, v, tick, mot_clamp_jerk(jerk));
 
   return 0;
 }
@@ -944,6 +1593,8 @@ mot_move(int32 s, mot_accel_t a, mot_velocity_t v, uint32 tick)
    will be turned off; otherwise it will be turned on. */
 int mot_balance(int on)
 {
+  control_lock_t lock;
+
   if (on) {
     mot_preverr_bal = 0;
     mot_interr_bal = 0;
@@ -961,6 +1612,11 @@ int mot_balance(int on)
 
     mot_emergency = 0;
     mot_pending_emergency_cnt = 0;
+
+    control_lock(lock);
+    mot_seg_clear();
+    mot_publish_status();
+    control_unlock(lock);
   }
   mot_bal_on = on;
 
@@ -977,45 +1633,37 @@ mot_balancing(void)
 /* Get the balancing PID loop constants.  Values are in 24.8 format. */
 void mot_get_bal_pid(int32 *kp, int32 *kd, int32 *ki)
 {
-  rtems_mode prev_mode, dummy;
+  control_lock_t lock;
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
+  control_lock(lock);
 
   *kp = mot_bal_kp;
   *kd = mot_bal_kd;
   *ki = mot_bal_ki;
 
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  control_unlock(lock);
 }
 
 /* Set the PID loop constants.  Values are in 24.8 format. */
 void mot_set_bal_pid(int32 kp, int32 kd, int32 ki)
 {
-  rtems_mode prev_mode, dummy;
-
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
-  mot_bal_kp = kp;
-  mot_bal_kd = kd;
-  mot_bal_ki = ki;
-
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  mot_post_cmd(MOT_CMD_BAL_PID, kp, kd, ki, 0, 0);
 }
 
-/* Get the current heading of the robot (24.8 number in degrees). */
-int
+/* Get the current heading of the robot. */
+bam32
 mot_get_heading(void)
 {
-  return mot_heading / 256;
+  return mot_heading;
 }
 
-/* Set a heading to turn to (24.8 number in degrees and degrees/s). */
+/* Set a heading to turn to (heading_vel is a 24.8 number in
+   degrees/s). */
 int
-mot_set_heading(int new_heading, int heading_vel)
+mot_set_heading(bam32 new_heading, int heading_vel)
 {
-  rtems_mode prev_mode, dummy;
-
-  TRACE_LOG4(ROBOT, SET_HD, new_heading/256, (new_heading%256)*100/256,
+  TRACE_LOG4(ROBOT, SET_HD,
+	     bam32_deg(new_heading), bam32_hundredths(new_heading),
 	     heading_vel/256, (heading_vel%256)*100/256);
 
   if (mot_emergency) {
@@ -1023,15 +1671,123 @@ mot_set_heading(int new_heading, int heading_vel)
     return 1;
   }
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
+  mot_post_cmd(MOT_CMD_HEADING, new_heading,
+	       bam32_from_24_8(heading_vel) / MOTOR_HZ, 0, 0, 0);
+
+  return 0;
+}
+
+/* Queue a motion segment. */
+static int
+mot_seg_post(mot_cmd_type_t type, int32 a0, int32 a1, int32 a2, int32 a3,
+	     int32 a4)
+{
+  if (mot_emergency) {
+    TRACE_LOG0(ROBOT, EMERGENCY_IGNORED);
+    return 1;
+  }
+
+  return mot_post_cmd(type, a0, a1, a2, a3, a4);
+}
 
-  mot_heading_stopped = 0;
-  mot_heading_steps = (heading_vel * 256) / MOTOR_HZ;
-  mot_heading_dest = (new_heading * 256) % (360 * 65536);
+/* Queue a move of 's' steps. */
+int
+mot_seg_move(int32 s, mot_accel_t a, mot_velocity_t v, int jerk,
+	     uint32 tick)
+{
+  TRACE_LOG5(ROBOT, SEG_MOVE, s, a, v, jerk, tick);
 
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  return mot_seg_post(MOT_CMD_SEG_MOVE, s, a, v, tick, mot_clamp_jerk(jerk));
+}
 
-  return 0;
+/* Queue a velocity change. */
+int
+mot_seg_vel(mot_accel_t a, mot_velocity_t v, int jerk, uint32 tick)
+{
+  TRACE_LOG4(ROBOT, SEG_VEL, a, v, jerk, tick);
+
+  return mot_seg_post(MOT_CMD_SEG_VEL, a, v, tick, mot_clamp_jerk(jerk), 0);
+}
+
+/* Queue a turn. */
+int
+mot_seg_heading(bam32 heading, int heading_vel, int wait, uint32 tick)
+{
+  TRACE_LOG4(ROBOT, SEG_HD, bam32_deg(heading), bam32_hundredths(heading),
+	     heading_vel/256, wait);
+
+  return mot_seg_post(MOT_CMD_SEG_HEADING, heading,
+		      bam32_from_24_8(heading_vel) / MOTOR_HZ, wait, tick, 0);
+}
+
+/* Queue a wait. */
+int
+mot_seg_wait(uint32 ticks)
+{
+  return mot_seg_post(MOT_CMD_SEG_WAIT, ticks, 0, 0, 0, 0);
+}
+
+/* Throw away the queued segments and stop. */
+void
+mot_seg_flush(void)
+{
+  TRACE_LOG0(ROBOT, SEG_FLUSH);
+
+  mot_post_cmd(MOT_CMD_SEG_FLUSH, 0, 0, 0, 0, 0);
+}
+
+/* How many segments are queued or running. */
+int
+mot_seg_pending(void)
+{
+  mot_status_t ms;
+
+  mot_get_status(&ms);
+  return mot_seg_posted - ms.seg_done;
+}
+
+/* Print the segment queue.  The queue belongs to the motor task, so
+   this is only a rough look at it while a path is running. */
+void
+mot_seg_report(void)
+{
+  mot_status_t ms;
+  mot_seg_t *g;
+  int i;
+
+  mot_get_status(&ms);
+  printf ("Motion segments: %d queued, %u done, v ",
+	  ms.seg_queued, ms.seg_done);
+  print_24_8(ms.velocity);
+  printf ("\n");
+
+  for (i = 0; i < ms.seg_queued; i++) {
+    g = &mot_segs[(mot_seg_head + i) % MOT_SEG_LEN];
+    printf ("  %c %-7s tick %u: ", (i == 0 && mot_seg_active) ? '>' : ' ',
+	    mot_seg_names[g->type - MOT_CMD_SEG_MOVE], g->tick);
+    switch (g->type) {
+    case MOT_CMD_SEG_MOVE:
+      printf ("%d steps, v ", g->s);
+      print_24_8(g->v);
+      if (g->jerk)
+	printf (", jerk %d", g->jerk);
+      break;
+    case MOT_CMD_SEG_VEL:
+      printf ("v ");
+      print_24_8(g->v);
+      if (g->jerk)
+	printf (", jerk %d", g->jerk);
+      break;
+    case MOT_CMD_SEG_HEADING:
+      printf ("%d.%02d deg%s", bam32_deg(g->heading),
+	      bam32_hundredths(g->heading), g->wait ? ", wait" : "");
+      break;
+    default:
+      printf ("%d ticks", g->wait);
+      break;
+    }
+    printf ("\n");
+  }
 }
 
 /* Receive a heading update from the distance task.  This gives us an
@@ -1040,18 +1796,16 @@ mot_set_heading(int new_heading, int heading_vel)
    above 270 or below 90; we will only consider angles above 330 and
    below 30, as we should be lined up with a wall most of the time.
    We will then have to compare that to the quadrant we are in, and if
-   we think this update is valid, we update our heading.  Note the
-   angle is an integer from 0 to 359. */
+   we think this update is valid, we update our heading. */
 void
-mot_heading_update(int update_angle)
+mot_heading_update(bam32 update_angle)
 {
-  int quadrant_offset;
-  int mot_heading_int = (mot_heading + 32768) / 65536;
-  int new_angle;
-  f16_16 new_heading, heading_diff;
-  rtems_mode prev_mode, dummy;
+  bam32 quadrant_offset;
+  bam32 new_angle, new_heading;
+  int heading_diff;
+  control_lock_t lock;
 
-  if (((update_angle < 330) && (update_angle > 30)) ||
+  if ((bam32_abs_diff(update_angle, 0) > BAM32_DEG(30)) ||
       ((mot_ticks - mot_last_heading_update) < HEADING_UPDATE_TICKS) ||
       mot_emergency) {
     /* throw out this update. */
@@ -1061,45 +1815,27 @@ mot_heading_update(int update_angle)
   /* Figure out which quadrant our current heading is in.  But using
      quadrants offset by 45 degrees.  So headings between 315 and 45
      would be in quadrant 0 (and have an offset of 0), headings
-     between 45 and 135 in quadrant 1 (offset 90), etc. */
-  
-  if (mot_heading_int <= 135) {
-    if (mot_heading_int <= 45)
-      quadrant_offset = 0;
-    else
-      quadrant_offset = 90;
-  } else {
-    /* greater than 135 */
-    if (mot_heading_int <= 225)
-      quadrant_offset = 180;
-    else if (mot_heading_int <= 315)
-      quadrant_offset = 270;
-    else
-      quadrant_offset = 0; /* angle greater than 315 */
-  }
+     between 45 and 135 in quadrant 1 (offset 90), etc.  With binary
+     angles a quadrant is the top two bits. */
+  quadrant_offset = (mot_heading + BAM32_DEG(45)) & 0xc0000000U;
 
-  new_angle = fixup_angle (update_angle + quadrant_offset);
-  if (abs_dir_diff (mot_heading_int, new_angle) <= 10) {
-    rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
+  new_angle = update_angle + quadrant_offset;
+  if (bam32_abs_diff(mot_heading, new_angle) <= BAM32_DEG(10)) {
+    control_lock(lock);
 
-    heading_diff = fixup_angle_f16_16 ((new_angle * 65536) - mot_heading);
-    if (heading_diff > (180*65536)) {
-      /* Make a difference of >180 degrees be the equivalent negative
-	 angle. */
-      heading_diff -= 360*65536;
-    }
-    new_heading = fixup_angle_f16_16 (mot_heading +
-				      (heading_diff * HEADING_UPD_PCT / 100));
+    /* Within 10 degrees, so this can't overflow. */
+    heading_diff = (int)(new_angle - mot_heading);
+    new_heading = mot_heading + heading_diff * HEADING_UPD_PCT / 100;
 
     TRACE_LOG4 (ROBOT, ACCEPT_HEADING_UPDATE,
-		mot_heading/65536, (mot_heading % 65536) * 100 / 65536,
-		new_heading/65536, (new_heading % 65536) * 100 / 65536);
+		bam32_deg(mot_heading), bam32_hundredths(mot_heading),
+		bam32_deg(new_heading), bam32_hundredths(new_heading));
 
     mot_heading = new_heading;
 
     mot_last_heading_update = mot_ticks;
 
-    rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+    control_unlock(lock);
   }
 }
 
@@ -1108,15 +1844,15 @@ mot_heading_update(int update_angle)
 void
 mot_get_hd_pid(int32 *kp, int32 *kd, int32 *ki)
 {
-  rtems_mode prev_mode, dummy;
+  control_lock_t lock;
 
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
+  control_lock(lock);
 
   *kp = mot_hd_kp;
   *kd = mot_hd_kd;
   *ki = mot_hd_ki;
 
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  control_unlock(lock);
 }
 
 /* Set the heading maintenance PID loop constants.  Values are in
@@ -1124,13 +1860,5 @@ mot_get_hd_pid(int32 *kp, int32 *kd, int32 *ki)
 void
 mot_set_hd_pid(int32 kp, int32 kd, int32 ki)
 {
-  rtems_mode prev_mode, dummy;
-
-  rtems_task_mode(RTEMS_NO_PREEMPT, RTEMS_PREEMPT_MASK, &prev_mode);
-
-  mot_hd_kp = kp;
-  mot_hd_kd = kd;
-  mot_hd_ki = ki;
-
-  rtems_task_mode(prev_mode, RTEMS_PREEMPT_MASK, &dummy);
+  mot_post_cmd(MOT_CMD_HD_PID, kp, kd, ki, 0, 0);
 }
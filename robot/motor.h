@@ -26,6 +26,8 @@
 #ifndef _MOTOR_H
 #define _MOTOR_H
 
+#include "bam.h"
+
 /**********************************************************************/
 /* Constants */
 /**********************************************************************/
@@ -36,6 +38,12 @@
 /* Motor number of right motor. */
 #define MOT_RIGHT		1
 
+/* Most motion segments that can be queued at once. */
+#define MOT_SEG_LEN		16
+
+/* Longest jerk ramp, in ticks, an S-curve move can have. */
+#define MOT_JERK_MAX		127
+
 /**********************************************************************/
 /* Types */
 /**********************************************************************/
@@ -58,6 +66,10 @@ typedef struct mot_status
   int heading_stopped;
   uint32 tick;
   int emergency;
+  uint32 cmd_done;		/* commands the motor task has applied */
+  uint32 seg_done;		/* motion segments finished or flushed */
+  int seg_queued;		/* motion segments queued, counting the
+				   one running */
 } mot_status_t;
 
 /* If 'emergency' is set in the mot_status_t, the motor task detected
@@ -74,6 +86,13 @@ typedef struct mot_status
    on error. */
 int mot_init(void);
 
+/* NOTE: the calls that start a motion, set a heading or set PID
+   constants queue a command for the motor task and return without
+   waiting for it; the motor task applies queued commands, in order,
+   at the top of its next pass.  mot_get_status() reports a queued
+   motion or heading command as the robot not being stopped, and
+   'cmd_done' in the status counts the commands applied so far. */
+
 /* Get the PID loop constants.  Values are in 24.8 format. */
 void mot_get_pid(int32 *kp, int32 *kd, int32 *ki);
 
@@ -87,6 +106,10 @@ uint32 mot_get_ticks(void);
 /* Get the motor status. */
 void mot_get_status(mot_status_t *mot);
 
+/* Get the wheels' acceleration, measured by the encoders and
+   smoothed over a few ticks. */
+mot_accel_t mot_get_wheel_accel(void);
+
 /* Ramp the chassis up (or down) to velocity 'v' using acceleration 'a'
    starting at time 'tick'.
    NOTE: a and v are in 24.8 format. */
@@ -96,6 +119,22 @@ int mot_set_vel(mot_accel_t a, mot_velocity_t v, uint32 tick);
    and acceleration. */
 int mot_calc_stop_dist(mot_accel_t a, mot_velocity_t v);
 
+/* S-curves: the *_jerk() calls and segments take 'jerk', the number of
+   ticks (0 to MOT_JERK_MAX) the acceleration takes to ramp between 0
+   and 'a', rather than stepping straight to it.  Smoothing the steps
+   in acceleration keeps them from kicking the tilt, so 'a' and 'v' can
+   be higher for the same upset to the balance loop.  A move takes
+   about 'jerk' ticks longer for each change in velocity.  0 is the
+   plain trapezoid. */
+int mot_set_vel_jerk(mot_accel_t a, mot_velocity_t v, int jerk, uint32 tick);
+int mot_move_jerk(int32 s, mot_accel_t a, mot_velocity_t v, int jerk,
+		  uint32 tick);
+
+/* How many steps it takes to go from velocity v to v_end (the same
+   way, or 0) with an S-curve. */
+int mot_calc_scurve_dist(mot_accel_t a, int jerk, mot_velocity_t v,
+			 mot_velocity_t v_end);
+
 /* Move the chassis forward (or backward) 's' steps, using
    acceleration 'a' and max velocity 'v', starting at time 'tick'.
    NOTE: all values should be positive, except velocity can be negative
@@ -120,11 +159,52 @@ void mot_set_bal_pid(int32 kp, int32 kd, int32 ki);
 /* Dump out the PID trace to the console. */
 void mot_dump_pid_trace(void);
 
-/* Get the current heading of the robot (24.8 number in degrees). */
-int mot_get_heading(void);
+/* Get the current heading of the robot. */
+bam32 mot_get_heading(void);
+
+/* Set a heading to turn to, turning at heading_vel degrees/s (a 24.8
+   number). */
+int mot_set_heading(bam32 new_heading, int heading_vel);
+
+/* Motion segments: a queue of moves, velocity changes, turns and
+   waits that the motor task runs back to back, without stopping
+   between them.  A move runs straight into a move or velocity change
+   after it that goes the same way and starts right away (tick 0),
+   and only slows to that segment's velocity.  Each segment starts no
+   earlier than its 'tick', or right after the one before if that is
+   0.  Segments should all be queued from one task.
+
+   The mot_seg_*() calls that queue a segment return 0 on success, 1
+   if the motor task is in an emergency, and 2 if the queue is full
+   (MOT_SEG_LEN segments).  mot_move(), mot_set_vel() and
+   mot_seg_flush() throw away whatever is queued. */
+
+/* Move 's' steps at velocity 'v' (24.8, negative to go backwards)
+   with acceleration 'a' and jerk ramp 'jerk'. */
+int mot_seg_move(int32 s, mot_accel_t a, mot_velocity_t v, int jerk,
+		 uint32 tick);
+
+/* Change velocity to 'v' with acceleration 'a' and jerk ramp 'jerk',
+   and keep going at that velocity until the next segment. */
+int mot_seg_vel(mot_accel_t a, mot_velocity_t v, int jerk, uint32 tick);
+
+/* Turn to 'heading' at heading_vel degrees/s (24.8).  If 'wait' is
+   non-zero the next segment waits until the turn is done, otherwise
+   it starts right away and the turn goes on alongside it. */
+int mot_seg_heading(bam32 heading, int heading_vel, int wait, uint32 tick);
+
+/* Carry on as we are for 'ticks' ticks. */
+int mot_seg_wait(uint32 ticks);
+
+/* Throw away the queued segments and come to a stop. */
+void mot_seg_flush(void);
+
+/* How many segments are queued or running (including ones the motor
+   task hasn't picked up yet). */
+int mot_seg_pending(void);
 
-/* Set a heading to turn to (24.8 number in degrees and degrees/s). */
-int mot_set_heading(int new_heading, int heading_vel);
+/* Print the segment queue ('seg' command). */
+void mot_seg_report(void);
 
 /* Receive a heading update from the distance task.  This gives us an
    estimate of our heading relative to one or both walls to our sides.
@@ -132,9 +212,8 @@ int mot_set_heading(int new_heading, int heading_vel);
    above 270 or below 90; we will only consider angles above 315 and
    below 45, as we should be lined up with a wall most of the time.
    We will then have to compare that to the quadrant we are in, and if
-   we think this update is valid, we update our heading.  Note the
-   angle is an integer from 0 to 359. */
-void mot_heading_update(int update_angle);
+   we think this update is valid, we update our heading. */
+void mot_heading_update(bam32 update_angle);
 
 /* Get the heading maintenance PID loop constants.  Values are in 16.16
    format. */
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Reporting for the pass profiler (see prof.h).
+ */
+
+#include <bsp.h>
+#include <stdio.h>
+#include "global.h"
+#include "prof.h"
+
+#ifdef PROFILE
+
+#define PROF_POINT(_name, _hz) { _name, _hz, 0, 0, ~0U, 0, 0 }
+
+prof_point_t prof_points[PROF_NUM_POINTS] = {
+  PROF_POINT("control", 250),
+  PROF_POINT("gyro", 250),
+  PROF_POINT("kalman", 250),
+  PROF_POINT("motor", 250),
+  PROF_POINT("tone", 50),
+};
+
+void
+prof_report(void)
+{
+  prof_point_t *p;
+  unsigned int us_per_tick = 1000000 / ticks_per_sec;
+  int i, b;
+
+  printf ("Whole ticks (%u us) each pass ran past the tick it started "
+	  "on; histogram buckets are 0, 1, 2-3, 4-7... ticks\n", us_per_tick);
+  printf ("%-10s %8s %6s %6s %6s %6s  histogram\n",
+	  "loop", "passes", "period", "min", "max", "over");
+  for (i = 0; i < PROF_NUM_POINTS; i++) {
+    p = &prof_points[i];
+    if (p->cnt == 0)
+      continue;
+
+    printf ("%-10s %8lu %6u %6u %6u %6lu ", p->name, p->cnt, p->period,
+	    p->min, p->max, p->over);
+    for (b = 0; b < PROF_HIST_BUCKETS; b++)
+      printf (" %lu", p->hist[b]);
+    printf ("\n");
+  }
+}
+
+void
+prof_reset(void)
+{
+  prof_point_t *p;
+  int i, b;
+
+  for (i = 0; i < PROF_NUM_POINTS; i++) {
+    p = &prof_points[i];
+    p->cnt = p->over = 0;
+    p->min = ~0U;
+    p->max = 0;
+    for (b = 0; b < PROF_HIST_BUCKETS; b++)
+      p->hist[b] = 0;
+  }
+}
+
+#else /* PROFILE */
+
+void
+prof_report(void)
+{
+  printf ("Profiler not built in - build with -DPROFILE.\n");
+}
+
+void
+prof_reset(void)
+{
+}
+
+#endif /* PROFILE */
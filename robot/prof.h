@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Pass timing of the periodic tasks, for finding which of them miss
+ * their deadlines, and how badly.
+ *
+ * Build with -DPROFILE (see the Makefile) and each periodic loop below
+ * keeps the min and max time a pass took, a log2 histogram of the
+ * times, and how many passes took longer than the period.  The 'prof'
+ * UI command prints them.
+ *
+ * The only clock the CPU can read on this board is the clock tick,
+ * and the rate monotonic loops release each pass on a tick, so a pass
+ * reads as the number of whole ticks it ran past its start: 0 for
+ * anything under a tick, every time.  That's why only whole passes are timed - a stage
+ * inside a pass would always read 0 - and why there is no average.
+ * What it does show is which loops run over a tick or past their
+ * period, and by how many ticks.
+ *
+ * Without PROFILE all of this compiles away to nothing.
+ */
+
+#ifndef _PROF_H
+#define _PROF_H
+
+#include <bsp.h>
+
+/**********************************************************************/
+/* Constants */
+/**********************************************************************/
+
+/* Log2 histogram buckets: bucket 0 counts times of 0 ticks, bucket n
+   counts times from 2^(n-1) to 2^n - 1 ticks, and the last bucket
+   counts anything longer. */
+#define PROF_HIST_BUCKETS	8
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+/* The profiling points, each one pass of a periodic loop.  Keep
+   prof_points[] in prof.c in step. */
+typedef enum prof_id
+{
+  PROF_CONTROL,			/* the control chain */
+  PROF_GYRO,			/* the gyro task (CONTROL_SEPARATE_TASKS) */
+  PROF_KALMAN,			/* the kalman task (CONTROL_SEPARATE_TASKS) */
+  PROF_MOTOR,			/* the motor task (CONTROL_SEPARATE_TASKS) */
+  PROF_TONE,			/* the tone task */
+  PROF_NUM_POINTS
+} prof_id_t;
+
+typedef rtems_interval prof_time_t;
+
+#ifdef PROFILE
+
+typedef struct prof_point
+{
+  const char *name;
+  int hz;			/* loop rate */
+  prof_time_t period;		/* ticks per loop, worked out from hz */
+  unsigned long cnt;
+  prof_time_t min;
+  prof_time_t max;
+  unsigned long over;		/* times longer than the period */
+  unsigned long hist[PROF_HIST_BUCKETS];
+} prof_point_t;
+
+/**********************************************************************/
+/* Globals */
+/**********************************************************************/
+
+extern prof_point_t prof_points[PROF_NUM_POINTS];
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static inline prof_time_t
+prof_now(void)
+{
+  prof_time_t now;
+
+  rtems_clock_get(RTEMS_CLOCK_GET_TICKS_SINCE_BOOT, &now);
+  return now;
+}
+
+/* Count one time 't' for point 'id'. */
+static inline void
+prof_record(prof_id_t id, prof_time_t t)
+{
+  prof_point_t *p = &prof_points[id];
+  int b = 0;
+
+  if (p->period == 0)
+    p->period = ticks_per_sec / p->hz;
+
+  p->cnt++;
+  if (t < p->min)
+    p->min = t;
+  if (t > p->max)
+    p->max = t;
+  if (t > p->period)
+    p->over++;
+
+  while (t != 0 && b < PROF_HIST_BUCKETS-1) {
+    t >>= 1;
+    b++;
+  }
+  p->hist[b]++;
+}
+
+/* Count the time since 'start' for point 'id'. */
+static inline void
+prof_since(prof_id_t id, prof_time_t start)
+{
+  prof_record(id, prof_now() - start);
+}
+
+/**********************************************************************/
+/* Macros */
+/**********************************************************************/
+
+/* Declare a timestamp variable, take it at the start of a pass, or
+   time the pass since it. */
+#define PROF_DECL(_t)		prof_time_t _t
+#define PROF_START(_t)		((_t) = prof_now())
+#define PROF_SINCE(_id, _t)	prof_since((_id), (_t))
+
+#else /* PROFILE */
+
+#define PROF_DECL(_t)		prof_time_t _t __attribute__((unused))
+#define PROF_START(_t)		do { } while (0)
+#define PROF_SINCE(_id, _t)	do { } while (0)
+
+#endif /* PROFILE */
+
+/* Print the times for every loop (or say the profiler isn't built
+   in). */
+void prof_report(void);
+
+/* Zero all the times. */
+void prof_reset(void);
+
+#endif /* _PROF_H */
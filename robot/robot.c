@@ -34,8 +34,8 @@
 #include "flame.h"
 #include "fastint.h"
 #include "f16_16.h"
+#include "fixed.h"
 #include "robot_trace.h"
-#include <math.h>
 #include <sim.h>
 
 /**********************************************************************/
@@ -80,6 +80,12 @@ typedef enum stop_condition
 /* Means don't go a specific distance (when passed to drive_straight). */
 #define FOREVER -1
 
+/* CORDIC iterations find_candle() uses for the distance & bearing to
+   the candle - good to about 0.03 degrees, against 0.5 for sqrti() and
+   fastatan2().  bench/bench_cordic has it at 0.75-0.9x their speed,
+   which doesn't matter for one call per candle sighting. */
+#define CANDLE_CORDIC_ITERS 12
+
 /**********************************************************************/
 /* Globals */
 /**********************************************************************/
@@ -94,6 +100,8 @@ long robot_acc = 0x001; /* accel is 1/256 step per tick, so it takes
 			   step/tick. */
 long robot_vel = 0x100; /* 1 step/tick, 250 steps/sec, or about
 			   4 inches/sec */
+long robot_jerk = 0;	/* ticks to ramp the acceleration up and down
+			   over (S-curve moves); 0 for trapezoids. */
 
 /**********************************************************************/
 /* Functions */
@@ -128,8 +136,8 @@ stop_motors(void)
 
   TRACE_LOG0 (ROBOT, STOP_MOTORS);
   mot_get_status(&ms);
-  s = mot_calc_stop_dist(robot_acc, ms.velocity);
-  mot_move(s, robot_acc, 0, mot_get_ticks()+1);
+  s = mot_calc_scurve_dist(robot_acc, robot_jerk, ms.velocity, 0);
+  mot_move_jerk(s, robot_acc, 0, robot_jerk, mot_get_ticks()+1);
   return wait_for_mot_stopped(5);
 }
 
@@ -168,12 +176,12 @@ get_balance(void)
 
 /* Turn the robot to face a specific heading. */
 int
-robot_turn_to(int heading)
+robot_turn_to(bam32 heading)
 {
   int heading_vel = 45 * 256;
   int retval;
 
-  TRACE_LOG4(ROBOT, TURN_TO, heading/256, (heading%256)*100/256,
+  TRACE_LOG4(ROBOT, TURN_TO, bam32_deg(heading), bam32_hundredths(heading),
 	     heading_vel/256, (heading_vel%256)*100/256);
 
   do {
@@ -186,6 +194,54 @@ robot_turn_to(int heading)
   return 0;
 }
 
+int
+wait_for_path_done(int seconds)
+{
+  int retries;
+  mot_status_t ms;
+  int emergency = 0;
+
+  for (retries=0; retries<seconds*10; retries++) {
+    rtems_task_wake_after(ticks_per_sec/10);
+    mot_get_status(&ms);
+    if (ms.emergency)
+      emergency = 1;
+    if ((mot_seg_pending() == 0) && (ms.stopped) && (ms.heading_stopped) &&
+	(!ms.emergency))
+      return emergency;
+  }
+
+  /* we timed out! */
+  TRACE_LOG2(ROBOT, PATH_TIMEOUT, seconds, mot_seg_pending());
+  mot_seg_flush();
+  return -1;
+}
+
+/* Step sideways: the turn out, the move and the turn back go to the
+   motor task as one path, instead of waiting for each to finish
+   before asking for the next. */
+int
+robot_side_step(bam32 heading, bam32 side, int32 s, mot_velocity_t v)
+{
+  int heading_vel = 45 * 256;
+  int retval;
+
+  TRACE_LOG5(ROBOT, SIDE_STEP, bam32_deg(heading), bam32_hundredths(heading),
+	     bam32_deg(side), bam32_hundredths(side), s);
+
+  stop_motors();
+  mot_seg_heading(heading + side, heading_vel, 1, 0);
+  mot_seg_move(s, robot_acc, v, robot_jerk, 0);
+  mot_seg_heading(heading, heading_vel, 1, 0);
+
+  retval = wait_for_path_done(20);
+  if (retval != 0)
+    /* Didn't go as planned - at least face the right way again. */
+    robot_turn_to(heading);
+
+  return retval;
+}
+
 /* 62.5 deci-inches as a 16.16 fixed number. */
 #define EYE_DIST_F16_16		4096000
 
@@ -201,8 +257,8 @@ calc_flame_pos(int angle_l, int angle_r,
     cl = 0;
   else
     {
-      sinval = isinof[90 - angle_l] << 2;
-      cosval = icosof[90 - angle_l] << 2;
+      sinval = f16_16_from_f18_14 (isinof[90 - angle_l]);
+      cosval = f16_16_from_f18_14 (icosof[90 - angle_l]);
       /* div_f16_16(sinval,cosval) forms the equivalent of tan(90 - angle_l) */
       cl = div_f16_16(-1 * 65536, div_f16_16(sinval, cosval));
     }
@@ -211,8 +267,8 @@ calc_flame_pos(int angle_l, int angle_r,
     cr = 0;
   else
     {
-      sinval = isinof[(90 + angle_r) % 360] << 2;
-      cosval = icosof[(90 + angle_r) % 360] << 2;
+      sinval = f16_16_from_f18_14 (isinof[(90 + angle_r) % 360]);
+      cosval = f16_16_from_f18_14 (icosof[(90 + angle_r) % 360]);
       /* div_f16_16(sinval,cosval) forms the equivalent of tan(90 + angle_r) */
       cr = div_f16_16(1 * 65536, div_f16_16(sinval, cosval));
     }
@@ -317,7 +373,8 @@ read_array(int sensor, int *anglep, int *highest_reading)
    infrared arrays.  Returns 1 if the candle is out of range to the
    left, 2 if the candle is out of range to the right, -1 if out of
    range and can't tell which side, 0 on success (with distp & anglep
-   filled in).  distp is in deci-inches; anglep is in degrees. */
+   filled in).  distp is in deci-inches; anglep is in degrees as a 24.8
+   number. */
 int
 find_candle(int *distp, int *anglep, int *highest_readingl,
 	    int *highest_readingr)
@@ -325,6 +382,8 @@ find_candle(int *distp, int *anglep, int *highest_readingl,
   int anglel, angler, ret0, ret1;
   int real_anglel, real_angler;
   int x, y;
+  unsigned long dist;
+  f16_16 angle;
 
   ret0 = read_array(0, &anglel, highest_readingl);
   ret1 = read_array(1, &angler, highest_readingr);
@@ -358,11 +417,12 @@ find_candle(int *distp, int *anglep, int *highest_readingl,
     }
   else
     {
-      *distp = (int) (sqrti(x*x + y*y));
-      *anglep = 90 - fastatan2(y, x);
+      cordic_vector(x, y, CANDLE_CORDIC_ITERS, &dist, &angle);
+      *distp = (int) dist;
+      *anglep = 90*256 - (int) (f24_8_from_f16_16 (angle) % (360*256));
       TRACE_LOG6 (ROBOT, FIND_CANDLE, real_anglel, real_angler, x, y, *distp, *anglep);
 
-      if (abs(*anglep)>45) {
+      if (abs(*anglep)>45*256) {
 	/* should not be possible!  something went wrong with our
 	   calculations.  Just tell caller we could not see the
 	   candle. */
@@ -381,10 +441,12 @@ int
 put_out_fire(void)
 {
   int dist, angle, hi_l, hi_r;
-  int best_angle, highest;
-  int best_angle_flame, highest_flame, flame;
+  bam32 best_angle;
+  int highest;
+  bam32 best_angle_flame;
+  int highest_flame, flame;
   int retval;
-  int heading, curheading;
+  bam32 heading, curheading;
   uint32 ticks;
   int num_nocandle_checks;
   mot_status_t m0;
@@ -412,7 +474,8 @@ put_out_fire(void)
       rtems_task_wake_after(ticks_per_sec/2);
 
       heading = mot_get_heading();
-      TRACE_LOG2 (ROBOT, POF_INIT_HD, heading/256, (heading%256)*100/256);
+      TRACE_LOG2 (ROBOT, POF_INIT_HD, bam32_deg(heading),
+		  bam32_hundredths(heading));
       best_angle = heading;
       best_angle_flame = heading;
 
@@ -422,7 +485,7 @@ put_out_fire(void)
       ticks = mot_get_ticks();
       for (i=0; i <4; i++)
 	{
-	  heading = fixup_angle_24_8(heading - 90*256);
+	  heading -= BAM32_DEG(90);
 	  mot_set_heading (heading, 30*256);
 
 	  turn_done = 0;
@@ -431,8 +494,8 @@ put_out_fire(void)
 	    *PORTC ^= 0x10; /* flash green LED. */
 
 	    curheading = mot_get_heading();
-	    TRACE_LOG2(ROBOT, HEADING, curheading/256,
-		       (curheading%256)*100/256);
+	    TRACE_LOG2(ROBOT, HEADING, bam32_deg(curheading),
+		       bam32_hundredths(curheading));
 	    retval = find_candle(&dist, &angle, &hi_l, &hi_r);
 
 	    if (retval == 0)
@@ -442,10 +505,11 @@ put_out_fire(void)
 
 		if (hi_l > highest)
 		  {
-		    best_angle = fixup_angle_24_8(curheading + angle*256);
+		    best_angle = curheading + bam32_from_24_8(angle);
 		    highest = hi_l;
 		    TRACE_LOG3 (ROBOT, POF_NEW_BEST, hi_l,
-				best_angle/256, (best_angle%256)*100/256);
+				bam32_deg(best_angle),
+				bam32_hundredths(best_angle));
 
 #if 0
 		    /* what was this trying to do? */
@@ -456,16 +520,16 @@ put_out_fire(void)
 	      }
 
 	    curheading = mot_get_heading();
-	    TRACE_LOG2(ROBOT, HEADING, curheading/256,
-		       (curheading%256)*100/256);
+	    TRACE_LOG2(ROBOT, HEADING, bam32_deg(curheading),
+		       bam32_hundredths(curheading));
 	    retval = flame_read(0);
 	    if (retval > highest_flame)
 	      {
 		best_angle_flame = curheading;
 		highest_flame = retval;
 		TRACE_LOG3 (ROBOT, POF_NEW_BEST_UV, highest_flame,
-			    best_angle_flame/256,
-			    (best_angle_flame%256)*100/256);
+			    bam32_deg(best_angle_flame),
+			    bam32_hundredths(best_angle_flame));
 	      }
 
 	    mot_get_status(&m0);
@@ -552,23 +616,23 @@ put_out_fire(void)
 	      TRACE_LOG4 (ROBOT, HUNT_STATE,
 			  uv_only, front_dist, left_dist, right_dist);
 
-	      if (abs(angle) > 20)
+	      if (abs(angle) > 20*256)
 		{
 		  stop_motors();
 		  moving = 0;
 		  rtems_task_wake_after(ticks_per_sec/2);
 
-		  best_angle = fixup_angle_24_8(mot_get_heading() + angle*256);
+		  best_angle = mot_get_heading() + bam32_from_24_8(angle);
 
 		  robot_turn_to(best_angle);
 		}
 	      else
 		{
 		  if (angle != 0) {
-		    best_angle = fixup_angle_24_8(mot_get_heading() +
-						  angle*256);
+		    best_angle = mot_get_heading() + bam32_from_24_8(angle);
 		    TRACE_LOG2 (ROBOT, HEAD_ADJ,
-				best_angle/256, (best_angle%256)*100/256);
+				bam32_deg(best_angle),
+				bam32_hundredths(best_angle));
 		    mot_set_heading(best_angle, 60*256);
 		  }
 		}
@@ -606,8 +670,8 @@ put_out_fire(void)
 
 		  /* Back up a few inches & try again. */
 		  ticks = mot_get_ticks();
-		  mot_move(MOT_STEPS_PER_INCH * 2, robot_acc,
-			   -robot_vel, ticks+1);
+		  mot_move_jerk(MOT_STEPS_PER_INCH * 2, robot_acc,
+				-robot_vel, robot_jerk, ticks+1);
 		  wait_for_mot_stopped(5);
 		  moving = 0;
 		  
@@ -629,8 +693,8 @@ put_out_fire(void)
 		  rtems_task_wake_after(ticks_per_sec/2);
 
 		  ticks = mot_get_ticks();
-		  mot_move(MOT_STEPS_PER_INCH * 6, robot_acc,
-			   -robot_vel, ticks+1);
+		  mot_move_jerk(MOT_STEPS_PER_INCH * 6, robot_acc,
+				-robot_vel, robot_jerk, ticks+1);
 		  wait_for_mot_stopped(10);
 		  moving = 0;
 		  break;
@@ -646,16 +710,10 @@ put_out_fire(void)
 		  moving = 0;
 		  rtems_task_wake_after(ticks_per_sec/2);
 
-		  best_angle = fixup_angle_24_8(mot_get_heading() + angle*256);
-
-		  robot_turn_to(fixup_angle_24_8(best_angle + 90*256));
+		  best_angle = mot_get_heading() + bam32_from_24_8(angle);
 
-		  ticks = mot_get_ticks();
-		  mot_move(MOT_STEPS_PER_INCH * 6, robot_acc, robot_vel/2,
-			   ticks+1);
-		  wait_for_mot_stopped(10);
-
-		  robot_turn_to(best_angle);
+		  robot_side_step(best_angle, BAM32_DEG(90),
+				  MOT_STEPS_PER_INCH * 6, robot_vel/2);
 		  moving = 0;
 		  continue;
 		}
@@ -670,16 +728,10 @@ put_out_fire(void)
 		  moving = 0;
 		  rtems_task_wake_after(ticks_per_sec/2);
 
-		  best_angle = fixup_angle_24_8(mot_get_heading() + angle*256);
-
-		  robot_turn_to(fixup_angle_24_8(best_angle - 90*256));
+		  best_angle = mot_get_heading() + bam32_from_24_8(angle);
 
-		  ticks = mot_get_ticks();
-		  mot_move(MOT_STEPS_PER_INCH * 6, robot_acc, robot_vel/2,
-			   ticks+1);
-		  wait_for_mot_stopped(10);
-
-		  robot_turn_to(best_angle);
+		  robot_side_step(best_angle, -BAM32_DEG(90),
+				  MOT_STEPS_PER_INCH * 6, robot_vel/2);
 		  moving = 0;
 		  continue;
 		}
@@ -693,8 +745,8 @@ put_out_fire(void)
 		  ticks = mot_get_ticks();
 		  mot_get_status(&m0);
 		  m0pos_orig = m0.pos;
-		  mot_move(MOT_STEPS_PER_INCH * (dist - CANDLE_DIST) / 10,
-			   robot_acc, robot_vel/2, ticks+1);
+		  mot_move_jerk(MOT_STEPS_PER_INCH * (dist - CANDLE_DIST) / 10,
+				robot_acc, robot_vel/2, robot_jerk, ticks+1);
 		  moving = 1;
 		  dist_to_move = dist - CANDLE_DIST;
 		}
@@ -718,9 +770,9 @@ put_out_fire(void)
 		      if (dist < (CANDLE_DIST+1))
 			dist = CANDLE_DIST + 1;
 		      ticks = mot_get_ticks();
-		      mot_move(MOT_STEPS_PER_INCH *
-			       (dist - CANDLE_DIST) / 10,
-			       robot_acc, robot_vel/2, ticks+1);
+		      mot_move_jerk(MOT_STEPS_PER_INCH *
+				    (dist - CANDLE_DIST) / 10,
+				    robot_acc, robot_vel/2, robot_jerk, ticks+1);
 		      moving = 1;
 		      dist_to_move = dist - CANDLE_DIST;
 		    }
@@ -839,10 +891,10 @@ void set_front_dist(int desired_dist)
 	      TRACE_LOG2(ROBOT, SFD_MOVING, diff, dir);
 
 	      ticks = mot_get_ticks();
-	      mot_move(MAX (MOT_STEPS_PER_INCH * moving_dist / 10 -
-			    MOT_STEPS_PER_INCH /* hack - we always seem to overcorrect. */,
-			    MOT_STEPS_PER_INCH/4),
-		       robot_acc, robot_vel/2 * moving_dir, ticks+1);
+	      mot_move_jerk(MAX (MOT_STEPS_PER_INCH * moving_dist / 10 -
+				 MOT_STEPS_PER_INCH /* hack - we always seem to overcorrect. */,
+				 MOT_STEPS_PER_INCH/4),
+			    robot_acc, robot_vel/2 * moving_dir, robot_jerk, ticks+1);
 	    }
 	}
 
@@ -885,7 +937,7 @@ int check_for_front_wall(int front_dist, int *speedp, int *movingp,
 	      if (*dist_leftp == FOREVER)
 		{
 		  ticks = mot_get_ticks();
-		  mot_set_vel(robot_acc, *speedp, ticks+1);
+		  mot_set_vel_jerk(robot_acc, *speedp, robot_jerk, ticks+1);
 		}
 	      else
 		{
@@ -895,14 +947,14 @@ int check_for_front_wall(int front_dist, int *speedp, int *movingp,
 		  if (*dist_leftp <= 0)
 		    {
 		      *dist_leftp = 0;
-		      mot_set_vel(robot_acc, 0, m0.tick+2);
+		      mot_set_vel_jerk(robot_acc, 0, robot_jerk, m0.tick+2);
 		      TRACE_LOG0(ROBOT, CFFW_COMPLETE);
 		      return DIST_COMPLETE;
 		    }
 		  else
 		    {
-		      mot_move((*dist_leftp * MOT_STEPS_PER_INCH) / 10,
-			       robot_acc, *speedp, m0.tick+2);
+		      mot_move_jerk((*dist_leftp * MOT_STEPS_PER_INCH) / 10,
+				    robot_acc, *speedp, robot_jerk, m0.tick+2);
 		    }
 		  *m0startposp = m0.pos + m0.velocity * 2;
 		  *movingp = 1;
@@ -913,13 +965,13 @@ int check_for_front_wall(int front_dist, int *speedp, int *movingp,
   return NOT_STOPPED;
 }
 
-stop_condition_t drive_straight(int desired_dir,
+stop_condition_t drive_straight(bam32 desired_dir,
 				stop_condition_t stop_condition,
 				int dist /* in deci-inches */,
 				int start_speed)
 {
   stop_condition_t retval;
-  int delta, d, l, r;
+  int d, l, r;
   int speed = start_speed;
   int dist_left = dist;
   int moving = 0;
@@ -927,11 +979,12 @@ stop_condition_t drive_straight(int desired_dir,
   uint32 ticks;
   uint32 m0startpos;
   uint32 m0_lwa; /* motor positions at last wall avoidance. */
-  int orig_dir = desired_dir;
+  bam32 orig_dir = desired_dir;
   uint32 diff0;
   int keep_parallel = 0;
 
-  TRACE_LOG5(ROBOT, DRIVE_STRAIGHT, desired_dir/256, (desired_dir%256)*100/256,
+  TRACE_LOG5(ROBOT, DRIVE_STRAIGHT,
+	     bam32_deg(desired_dir), bam32_hundredths(desired_dir),
 	     stop_condition, dist, start_speed);
 
   get_balance();
@@ -981,7 +1034,7 @@ stop_condition_t drive_straight(int desired_dir,
 		}
 	      moving = 0;
 
-	      if (abs_dir_diff_24_8(desired_dir, orig_dir) > 5*256)
+	      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(5))
 		{
 		  /* If we're not parallel to the hallway, make us
                      parallel, then check to see if we still see the
@@ -1017,7 +1070,7 @@ stop_condition_t drive_straight(int desired_dir,
 		}
 	      moving = 0;
 
-	      if (abs_dir_diff_24_8(desired_dir, orig_dir) > 5*256)
+	      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(5))
 		{
 		  /* If we're not parallel to the hallway, make us
                      parallel, then check to see if we still see the
@@ -1052,7 +1105,7 @@ stop_condition_t drive_straight(int desired_dir,
 		}
 	      moving = 0;
 
-	      if (abs_dir_diff_24_8(desired_dir, orig_dir) > 5*256)
+	      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(5))
 		{
 		  /* If we're not parallel to the hallway, make us
                      parallel and then check to see if we still see
@@ -1090,7 +1143,7 @@ stop_condition_t drive_straight(int desired_dir,
 		}
 	      moving = 0;
 
-	      if (abs_dir_diff_24_8(desired_dir, orig_dir) > 5*256)
+	      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(5))
 		{
 		  /* If we're not parallel to the hallway, make us
                      parallel, then check to see if we still see the
@@ -1129,7 +1182,7 @@ stop_condition_t drive_straight(int desired_dir,
 		}
 	      moving = 0;
 
-	      if (abs_dir_diff_24_8(desired_dir, orig_dir) > 5*256)
+	      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(5))
 		{
 		  /* If we're not parallel to the hallway, make us
                      parallel, then check to see if we still see the
@@ -1170,35 +1223,31 @@ stop_condition_t drive_straight(int desired_dir,
 	  (r >= 0) && (r < 120))
 	{
 	  /* Can see both walls - make sure we're close to the middle. */
-	  desired_dir = fixup_angle_24_8(orig_dir + ((r - l)/2)*256);
+	  desired_dir = orig_dir + bam32_from_24_8(((r - l)/2)*256);
 	}
       else if ((l >= 0) && (l < 120))
 	{
 	  /* Can only see left wall. */
-	  desired_dir = fixup_angle_24_8 (((50 - l)/2)*256 + orig_dir);
+	  desired_dir = orig_dir + bam32_from_24_8(((50 - l)/2)*256);
 	}
       else if ((r >= 0) && (r < 120))
 	{
 	  /* Can only see right wall. */
-	  desired_dir = fixup_angle_24_8 (((r - 50)/2)*256 + orig_dir);
+	  desired_dir = orig_dir + bam32_from_24_8(((r - 50)/2)*256);
 	}
 
       /* Keep our heading to within DIR_MAX_CORRECT degrees of the
          original heading. */
-      if (abs_dir_diff_24_8(desired_dir, orig_dir) > DIR_MAX_CORRECT*256)
+      if (bam32_abs_diff(desired_dir, orig_dir) > BAM32_DEG(DIR_MAX_CORRECT))
 	{
-	  delta = desired_dir - orig_dir;
-	  if (delta < 0)
-	    delta += 360*256;
-
-	  if (delta < 180)
-	    desired_dir = fixup_angle_24_8(orig_dir + DIR_MAX_CORRECT*256);
+	  if ((int)(desired_dir - orig_dir) > 0)
+	    desired_dir = orig_dir + BAM32_DEG(DIR_MAX_CORRECT);
 	  else
-	    desired_dir = fixup_angle_24_8(orig_dir - DIR_MAX_CORRECT*256);
+	    desired_dir = orig_dir - BAM32_DEG(DIR_MAX_CORRECT);
 	}
 
-      TRACE_LOG2 (ROBOT, DS_DESIRED_DIR, desired_dir/256,
-		  (desired_dir%256)*100/256);
+      TRACE_LOG2 (ROBOT, DS_DESIRED_DIR, bam32_deg(desired_dir),
+		  bam32_hundredths(desired_dir));
       mot_set_heading(desired_dir, 45*256);
 
       mot_get_status(&m0);
@@ -1219,12 +1268,12 @@ stop_condition_t drive_straight(int desired_dir,
 	  ticks = mot_get_ticks();
 	  if (dist_left == FOREVER)
 	    {
-	      mot_set_vel(robot_acc, speed, ticks+1);
+	      mot_set_vel_jerk(robot_acc, speed, robot_jerk, ticks+1);
 	    }
 	  else
 	    {
-	      mot_move((dist_left * MOT_STEPS_PER_INCH) / 10,
-		       robot_acc, speed, ticks+1);
+	      mot_move_jerk((dist_left * MOT_STEPS_PER_INCH) / 10,
+			    robot_acc, speed, robot_jerk, ticks+1);
 	    }
 	  moving = 1;
 	}
@@ -1238,7 +1287,7 @@ stop_condition_t drive_straight(int desired_dir,
 int
 run_maze(void)
 {
-  int desired_dir;
+  bam32 desired_dir;
   int speed = robot_vel;
   int i;
 
@@ -1250,15 +1299,15 @@ run_maze(void)
   set_front_dist(70);
 
   /* Turn left 90 degrees & check in the first room. */
-  desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* west */
+  desired_dir -= BAM32_DEG(90); /* west */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
-  desired_dir = fixup_angle_24_8 (desired_dir + 90*256); /* north */
+  desired_dir += BAM32_DEG(90); /* north */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, 100, speed);
-  desired_dir = fixup_angle_24_8 (desired_dir + 45*256); /* northeat */
+  desired_dir += BAM32_DEG(45); /* northeat */
   robot_turn_to(desired_dir);
-  desired_dir = fixup_angle_24_8 (desired_dir - 45*256); /* north */
+  desired_dir -= BAM32_DEG(45); /* north */
 
   rtems_task_wake_after(ticks_per_sec/2);
   TRACE_LOG0(ROBOT, ROOM1);
@@ -1272,27 +1321,27 @@ run_maze(void)
 	  if (put_out_fire() == 0)
 	    {
 	      /* Yay! We put out out!  Now go home. */
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* west */
+	      desired_dir -= BAM32_DEG(90); /* west */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* south */
+	      desired_dir -= BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* east */
+	      desired_dir -= BAM32_DEG(90); /* east */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* south */
+	      desired_dir += BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* west */
+	      desired_dir += BAM32_DEG(90); /* west */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+	      desired_dir += BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      return 0;
 	    }
@@ -1302,27 +1351,27 @@ run_maze(void)
          all... */
     }
 
-  desired_dir = fixup_angle_24_8 (desired_dir - 90*256); /* west */
+  desired_dir -= BAM32_DEG(90); /* west */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
   /* Turn around & drive out - go check the second room (which used to
      be the first room...). */
-  desired_dir = fixup_angle_24_8 (desired_dir - 90*256); /* south */
+  desired_dir -= BAM32_DEG(90); /* south */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8 (desired_dir - 90*256); /* east */
+  desired_dir -= BAM32_DEG(90); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, NO_WALL_ON_RIGHT, FOREVER, speed/2);
   drive_straight(desired_dir, WALL_IN_FRONT, 100, speed);
 
-  desired_dir = fixup_angle_24_8 (desired_dir + 90*256); /* south */
+  desired_dir += BAM32_DEG(90); /* south */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, 150, speed);
-  desired_dir = fixup_angle_24_8 (desired_dir + 45*256); /* southwest */
+  desired_dir += BAM32_DEG(45); /* southwest */
   robot_turn_to(desired_dir);
-  desired_dir = fixup_angle_24_8 (desired_dir - 45*256); /* south */
+  desired_dir -= BAM32_DEG(45); /* south */
 
   rtems_task_wake_after(ticks_per_sec/2);
   TRACE_LOG0(ROBOT, ROOM2);
@@ -1336,27 +1385,27 @@ run_maze(void)
 	  if (put_out_fire() == 0)
 	    {
 	      /* Yay! We put out out!  Now go home. */
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* east */
+	      desired_dir -= BAM32_DEG(90); /* east */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* north */
+	      desired_dir -= BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+	      desired_dir += BAM32_DEG(90); /* east */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* south */
+	      desired_dir += BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* west */
+	      desired_dir += BAM32_DEG(90); /* west */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+	      desired_dir += BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      return 0;
 	    }
@@ -1366,26 +1415,26 @@ run_maze(void)
          all... */
     }
 
-  desired_dir = fixup_angle_24_8(desired_dir -90*256); /* east */
+  desired_dir -= BAM32_DEG(90); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
   /* Leave this room & try room 3. */
-  desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* north */
+  desired_dir -= BAM32_DEG(90); /* north */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+  desired_dir += BAM32_DEG(90); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, NO_WALL_ON_LEFT, FOREVER, speed);
   drive_straight(desired_dir, WALL_IN_FRONT, 60, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* north */
+  desired_dir -= BAM32_DEG(90); /* north */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
   /* Try the third room. */
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+  desired_dir += BAM32_DEG(90); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, 100, speed);
 
@@ -1401,27 +1450,27 @@ run_maze(void)
 	  if (put_out_fire() == 0)
 	    {
 	      /* Yay! We put out out!  Now go home. */
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* north */
+	      desired_dir -= BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* west */
+	      desired_dir -= BAM32_DEG(90); /* west */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* south */
+	      desired_dir -= BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 	      
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+	      desired_dir += BAM32_DEG(90); /* east */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, NO_WALL_ON_LEFT, FOREVER, speed);
 	      drive_straight(desired_dir, WALL_IN_FRONT, 80, speed);
-	      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* south */
+	      desired_dir -= BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 180*256); /* north */
+	      desired_dir += BAM32_DEG(180); /* north */
 	      robot_turn_to(desired_dir);
 	      return 0;
 	    }
@@ -1429,34 +1478,34 @@ run_maze(void)
 
       /* We failed to put it out.  Maybe it was a false alarm after
          all... */
-      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* north */
+      desired_dir -= BAM32_DEG(90); /* north */
       robot_turn_to(desired_dir);
       drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
       /* set desired dir back to what will be expected. */
-      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+      desired_dir += BAM32_DEG(90); /* east */
     }
 
-  desired_dir = fixup_angle_24_8(desired_dir + 180*256); /* west */
+  desired_dir += BAM32_DEG(180); /* west */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* south */
+  desired_dir -= BAM32_DEG(90); /* south */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* east */
+  desired_dir -= BAM32_DEG(90); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* south */
+  desired_dir += BAM32_DEG(90); /* south */
   robot_turn_to(desired_dir);
 
   /* Try the fourth room: */
   drive_straight(desired_dir, WALL_ON_RIGHT, FOREVER, speed/2);
   drive_straight(desired_dir, NO_WALL_ON_RIGHT, FOREVER, speed/2);
   drive_straight(desired_dir, WALL_IN_FRONT, 80, speed);
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* west */
+  desired_dir += BAM32_DEG(90); /* west */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, 100, speed);
   rtems_task_wake_after(ticks_per_sec/2);
@@ -1464,32 +1513,32 @@ run_maze(void)
   if (flame_read(0) > 0)
     {
       /* OK, this is _NOT_ a drill! */
-      desired_dir = fixup_angle_24_8(desired_dir - 45*256); /* southwest */
+      desired_dir -= BAM32_DEG(45); /* southwest */
       robot_turn_to(desired_dir);
       drive_straight(desired_dir, WALL_IN_FRONT, 80, speed);
-      desired_dir = fixup_angle_24_8(desired_dir + 45*256); /* west */
+      desired_dir += BAM32_DEG(45); /* west */
       for (i=0; i<2; i++)
 	{
 	  if (put_out_fire() == 0)
 	    {
 	      /* Yay! We put out out!  Now go home. */
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+	      desired_dir += BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* east */
+	      desired_dir += BAM32_DEG(90); /* east */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* south */
+	      desired_dir += BAM32_DEG(90); /* south */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 	      
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* west */
+	      desired_dir += BAM32_DEG(90); /* west */
 	      robot_turn_to(desired_dir);
 	      drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-	      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+	      desired_dir += BAM32_DEG(90); /* north */
 	      robot_turn_to(desired_dir);
 	      return 0;
 	    }
@@ -1497,27 +1546,27 @@ run_maze(void)
 
       /* We failed to put it out.  Maybe it was a false alarm after
          all... */
-      desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+      desired_dir += BAM32_DEG(90); /* north */
       robot_turn_to(desired_dir);
       drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
       /* set desired dir back to what will be expected. */
-      desired_dir = fixup_angle_24_8(desired_dir - 90*256); /* west */
+      desired_dir -= BAM32_DEG(90); /* west */
     }
 
-  desired_dir = fixup_angle_24_8(desired_dir + 180*256); /* east */
+  desired_dir += BAM32_DEG(180); /* east */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* south */
+  desired_dir += BAM32_DEG(90); /* south */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* west */
+  desired_dir += BAM32_DEG(90); /* west */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 90*256); /* north */
+  desired_dir += BAM32_DEG(90); /* north */
   robot_turn_to(desired_dir);
 
   return 1;
@@ -1526,16 +1575,16 @@ run_maze(void)
 int
 doit(void)
 {
-  int desired_dir = 0;
+  bam32 desired_dir = 0;
   int speed = robot_vel;
 
   drive_straight(desired_dir, WALL_IN_FRONT, 120, robot_vel);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 180*256); /* south */
+  desired_dir += BAM32_DEG(180); /* south */
   robot_turn_to(desired_dir);
   drive_straight(desired_dir, WALL_IN_FRONT, FOREVER, speed);
 
-  desired_dir = fixup_angle_24_8(desired_dir + 180*256); /* north */
+  desired_dir += BAM32_DEG(180); /* north */
   robot_turn_to(desired_dir);
 
   return 0;
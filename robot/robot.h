@@ -34,21 +34,32 @@
    automatically.  Note that this is a 24.8 number. */
 extern long heading_movement_factor;
 
-/* Default acceleration and velocity. */
+/* Default acceleration, velocity and jerk ramp (see mot_move_jerk()). */
 extern long robot_acc;
 extern long robot_vel;
+extern long robot_jerk;
 
 /**********************************************************************/
 /* Functions */
 /**********************************************************************/
 
 /* Turn the robot to face a specific heading. */
-int robot_turn_to(int heading);
+int robot_turn_to(bam32 heading);
+
+/* Wait for a path queued with the mot_seg_*() calls to finish and the
+   robot to come to rest.  Returns 0 if it did, 1 if it did but there
+   was an emergency on the way, and -1 (after throwing the rest of the
+   path away) if it took longer than 'seconds'. */
+int wait_for_path_done(int seconds);
+
+/* Step sideways as one path: turn 'side' away from 'heading', move
+   's' steps at velocity 'v', and turn back to 'heading'. */
+int robot_side_step(bam32 heading, bam32 side, int32 s, mot_velocity_t v);
 
 /* Calculate the distance & andle to the candle by reading the two
    infrared arrays.  Returns 1 if the candle is out of range, 0
    on success (with distp & anglep filled in).  distp is in
-   deci-inches; anglep is in degrees. */
+   deci-inches; anglep is in degrees as a 24.8 number. */
 int find_candle(int *distp, int *anglep, int *highest_readingl,
 		int *highest_readingr);
 
@@ -42,6 +42,10 @@ TRACE_ENTRIES_BEGIN(ROBOT)
 
      TRACE_ENTRY(ROBOT, TURN_TO, "robot_turn_to(%d.%02d, %d.%02d)\n")
 
+     TRACE_ENTRY(ROBOT, PATH_TIMEOUT, "wait_for_path_done: timed out after %d seconds, %d segments left\n")
+
+     TRACE_ENTRY(ROBOT, SIDE_STEP, "robot_side_step(%d.%02d, %d.%02d, %d)\n")
+
      TRACE_ENTRY(ROBOT, FIND_CANDLE_RET, "find_candle() returning %d\n")
 
      TRACE_ENTRY(ROBOT, FIND_CANDLE, "find_candle() ret 0, real_anglel %d real_angler %d x %d y %d dist %d angle %d\n")
@@ -134,9 +138,13 @@ TRACE_ENTRIES_BEGIN(ROBOT)
      TRACE_ENTRY(ROBOT, ROOM3, "checking for candle in room 3.\n")
      TRACE_ENTRY(ROBOT, ROOM4, "checking for candle in room 4.\n")
 
-     TRACE_ENTRY(ROBOT, MOVE, "mot_move s=%d a=%d v=%d tick=%d\n")
-     TRACE_ENTRY(ROBOT, SET_VEL, "mot_move a=%d v=%d tick=%d\n")
+     TRACE_ENTRY(ROBOT, MOVE, "mot_move s=%d a=%d v=%d jerk=%d tick=%d\n")
+     TRACE_ENTRY(ROBOT, SET_VEL, "mot_move a=%d v=%d jerk=%d tick=%d\n")
      TRACE_ENTRY(ROBOT, SET_HD, "mot_set_heading: hd=%d.%02d hdvel=%d.%02d\n")
+     TRACE_ENTRY(ROBOT, SEG_MOVE, "mot_seg_move s=%d a=%d v=%d jerk=%d tick=%d\n")
+     TRACE_ENTRY(ROBOT, SEG_VEL, "mot_seg_vel a=%d v=%d jerk=%d tick=%d\n")
+     TRACE_ENTRY(ROBOT, SEG_HD, "mot_seg_heading: hd=%d.%02d hdvel=%d wait=%d\n")
+     TRACE_ENTRY(ROBOT, SEG_FLUSH, "mot_seg_flush\n")
 
      TRACE_ENTRY(ROBOT, EMERGENCY, "motor task: emergency recovery mode! preverr %d pending %d\n")
      TRACE_ENTRY(ROBOT, EMERGENCY_CLEAR, "motor task: emergency recovery complete\n")
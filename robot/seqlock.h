@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Sequence locks, for letting other tasks read a group of variables
+ * that one task keeps up to date, without the readers ever blocking
+ * or turning off preemption.
+ *
+ * The writer bumps the sequence number to odd before it changes
+ * anything and back to even when it's done.  A reader notes the
+ * sequence number, copies what it wants, and checks the number again:
+ * if it was odd, or has changed, the writer got in the middle of the
+ * copy and the reader just goes around again.
+ *
+ *   writer:  seqlock_write_begin(&l);  shared = new;  seqlock_write_end(&l);
+ *
+ *   reader:  do {
+ *              seq = seqlock_read_begin(&l);
+ *              copy = shared;
+ *            } while (seqlock_read_retry(&l, seq));
+ *
+ * There can only be one writer at a time.  Readers spin while a write
+ * is in progress, so on the robot (one CPU) the writer must never be
+ * preempted by a reader: write from a higher priority task than any
+ * reader, or with preemption off.
+ */
+
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef struct seqlock
+{
+  volatile unsigned int seq;	/* odd while a write is in progress */
+} seqlock_t;
+
+/**********************************************************************/
+/* Macros */
+/**********************************************************************/
+
+#define SEQLOCK_INIT	{ 0 }
+
+/* Keeps the compiler from moving loads and stores of the protected
+   data across the sequence number.  That's all the robot needs, with
+   one CPU; the host stress test (bench/bench_seqlock.c) defines it as
+   a real memory barrier. */
+#ifndef SEQLOCK_BARRIER
+#define SEQLOCK_BARRIER()	__asm__ __volatile__ ("" : : : "memory")
+#endif
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+static inline void
+seqlock_init(seqlock_t *l)
+{
+  l->seq = 0;
+}
+
+/* Start changing the protected data. */
+static inline void
+seqlock_write_begin(seqlock_t *l)
+{
+  l->seq++;
+  SEQLOCK_BARRIER();
+}
+
+/* Done changing the protected data. */
+static inline void
+seqlock_write_end(seqlock_t *l)
+{
+  SEQLOCK_BARRIER();
+  l->seq++;
+}
+
+/* Start reading the protected data.  Returns the sequence number to
+   hand to seqlock_read_retry(). */
+static inline unsigned int
+seqlock_read_begin(const seqlock_t *l)
+{
+  unsigned int seq;
+
+  while ((seq = l->seq) & 1)
+    ;
+  SEQLOCK_BARRIER();
+  return seq;
+}
+
+/* Done reading.  Returns non-zero if the data changed while it was
+   being read, and the read has to be done again. */
+static inline int
+seqlock_read_retry(const seqlock_t *l, unsigned int seq)
+{
+  SEQLOCK_BARRIER();
+  return l->seq != seq;
+}
+
+#endif /* _SEQLOCK_H */
@@ -28,6 +28,7 @@
 #include "tone.h"
 #include "pta.h"
 #include "global.h"
+#include "prof.h"
 
 unsigned int tone_good = 0;
 unsigned int tone_last_raw = 0;
@@ -63,6 +64,7 @@ tone_task(rtems_task_argument ignored)
   rtems_id period;
   rtems_status_code status;
   int last_good_cnt, last_bad_cnt;
+  PROF_DECL(t);
 
   period_name = rtems_build_name ('T', 'N', 'P', 'D');
   status = rtems_rate_monotonic_create (period_name, &period);
@@ -85,6 +87,7 @@ tone_task(rtems_task_argument ignored)
 	     our next timeout, until the end of time... */
 	  tone_task_timeouts++;
 	}
+      PROF_START(t);
 
       if ((last_good_cnt == tone_good_cnt) &&
 	  (last_bad_cnt == tone_bad_cnt)) {
@@ -96,6 +99,7 @@ tone_task(rtems_task_argument ignored)
 
       last_good_cnt = tone_good_cnt;
       last_bad_cnt = tone_bad_cnt;
+      PROF_SINCE(PROF_TONE, t);
     }
 }
 
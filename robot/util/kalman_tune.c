@@ -0,0 +1,593 @@
+/*
+ *  Copyright (c) 2003 by Matt Cross <matt@dragonflyhollow.org>
+ *
+ *  This file is part of the firemarshalbill package.
+ *
+ *  Firemarshalbill is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Firemarshalbill is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Firemarshalbill; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Offline tuning for the kalman filters' Q and R.
+ *
+ * Replays gyro/accelerometer recordings (from the robot's 'krec'
+ * command) through kalman.c itself, built for the host, for every
+ * candidate Q, R and kalman update rate, through both the one state
+ * kalman() and the two state kalman2() (where Q is Q_angle, with
+ * Q_bias left as it is), and scores each candidate on:
+ *
+ *   lag   - milliseconds to move 63% of the way to a 1 degree step in
+ *           the accelerometer's angle, with the gyro still.  How fast
+ *           gyro drift gets corrected.
+ *   noise - rms size (degrees) of the corrections the accelerometer
+ *           updates make to the angle over the recordings.  How much
+ *           accelerometer noise gets through to the balance loop.
+ *
+ * Candidates are spread over all the host's cores by a small work
+ * stealing pool.  For each filter, the ones no other candidate beats
+ * on both lag and noise are printed, with the lines to paste into
+ * kalman.c.  R is shared by both filters, so take it from the one
+ * kalman_step() runs (kalman2() unless built with KALMAN_ONE_STATE).
+ *
+ * usage: kalman_tune [-j threads] [-r random_candidates] [file...]
+ *
+ * With no files, makes up a minute of data instead (and also shows
+ * the rms error against the made up tilt).  Without -r, searches a
+ * grid.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include "f16_16.h"
+#include "fastint.h"
+#include "kalman.h"
+
+/**********************************************************************/
+/* Constants */
+/**********************************************************************/
+
+#define UPDATE_HZ	250
+#define MAX_STREAMS	16
+#define MAX_SAMPLES	(600 * UPDATE_HZ)
+#define SYNTH_SECONDS	60
+
+/* How long the lag test runs for, in gyro readings, before giving
+   up. */
+#define LAG_TICKS	(10 * UPDATE_HZ)
+
+/* Ignore this many seconds at the start of each recording, while the
+   filter settles. */
+#define SETTLE_SECONDS	5
+
+/* Grid searched without -r: Q and R are spaced evenly on a log scale,
+   and the kalman filter runs every one of these many gyro readings. */
+#define GRID_Q		16
+#define GRID_R		16
+#define Q_MIN		64		/* ~0.001 */
+#define Q_MAX		65536		/* 1 */
+#define R_MIN		655		/* ~0.01 */
+#define R_MAX		655360		/* 10 */
+
+static const int ratios[] = { 5, 10, 25, 50 };
+#define NUM_RATIOS	(sizeof(ratios) / sizeof(ratios[0]))
+
+/* The filters tuned: kalman_engines[0] and [1], kalman() and
+   kalman2(). */
+#define NUM_ENGINES	2
+
+/* kalman.c's Q_BIAS (0.003 per second), which kalman2() keeps while
+   its Q_angle is tuned. */
+#define Q_BIAS		197
+
+/**********************************************************************/
+/* Types */
+/**********************************************************************/
+
+typedef struct stream
+{
+  f16_16 *gyro, *accel;
+  double *truth;		/* made up data only */
+  int n;
+} stream_t;
+
+typedef struct candidate
+{
+  f16_16 Q, R;
+  int every;			/* gyro readings per kalman update */
+  int engine;			/* which of kalman_engines[] */
+  double lag_ms;
+  double noise;
+  double err;			/* rms error against truth, made up data */
+  int pareto;
+} candidate_t;
+
+/* One worker of the pool.  It works through its own range of
+   candidates, then steals half of what's left in someone else's. */
+typedef struct worker
+{
+  pthread_mutex_t lock;
+  int next, end;
+  int id;
+  int steals;
+  pthread_t thread;
+} worker_t;
+
+/**********************************************************************/
+/* Globals */
+/**********************************************************************/
+
+/* kalman.c's tunables, thread local in this build. */
+extern __thread f16_16 Q, R;
+extern __thread f16_16 kalman_dt, Q_angle_dt, Q_bias_dt;
+extern const f16_16 dt;
+
+static stream_t streams[MAX_STREAMS];
+static int num_streams;
+static int synthetic;
+
+static candidate_t *cands;
+static int num_cands;
+
+static worker_t *workers;
+static int num_workers;
+
+/**********************************************************************/
+/* Functions */
+/**********************************************************************/
+
+/* Small, repeatable random numbers (xorshift32). */
+static unsigned
+rand_next(unsigned *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static double
+rand_unit(unsigned *state)
+{
+  return (double)rand_next(state) / 4294967296.0;
+}
+
+static double
+noise(unsigned *state, double sd)
+{
+  double sum = 0;
+  int i;
+
+  for (i = 0; i < 12; i++)
+    sum += rand_unit(state);
+  return (sum - 6.0) * sd;
+}
+
+static void
+alloc_stream(stream_t *s, int n)
+{
+  s->gyro = malloc(n * sizeof(f16_16));
+  s->accel = malloc(n * sizeof(f16_16));
+  s->truth = NULL;
+  s->n = 0;
+  if (s->gyro == NULL || s->accel == NULL) {
+    fprintf (stderr, "out of memory\n");
+    exit (1);
+  }
+}
+
+/* A minute of rocking back and forth with a drifting gyro - the same
+   kind of data bench/bench_kalman makes up. */
+static void
+make_data(void)
+{
+  stream_t *s = &streams[num_streams++];
+  double t, angle, rate, b;
+  unsigned seed = 2463534242U;
+  int i;
+
+  alloc_stream(s, SYNTH_SECONDS * UPDATE_HZ);
+  s->truth = malloc(SYNTH_SECONDS * UPDATE_HZ * sizeof(double));
+  for (i = 0; i < SYNTH_SECONDS * UPDATE_HZ; i++) {
+    t = (double)i / UPDATE_HZ;
+    angle = 3.0 * sin(2 * M_PI * 0.7 * t) + 2.0 * sin(2 * M_PI * 0.05 * t);
+    rate = 3.0 * 2 * M_PI * 0.7 * cos(2 * M_PI * 0.7 * t) +
+      2.0 * 2 * M_PI * 0.05 * cos(2 * M_PI * 0.05 * t);
+    b = 1.5 * (1.0 - exp(-t / 15.0));
+
+    s->truth[i] = angle;
+    s->gyro[i] = (f16_16)lrint((rate + b + noise(&seed, 0.3)) * 65536.0);
+    s->accel[i] = (f16_16)lrint((sin(angle * M_PI / 180) +
+				 noise(&seed, 0.02)) * 65536.0);
+  }
+  s->n = i;
+}
+
+/* Reads what kalman_dump_record() printed. */
+static int
+read_data(const char *name)
+{
+  FILE *f;
+  stream_t *s;
+  char line[200];
+  long g, a;
+
+  if (num_streams >= MAX_STREAMS) {
+    fprintf (stderr, "%s: too many recordings\n", name);
+    return 0;
+  }
+  f = fopen(name, "r");
+  if (f == NULL) {
+    perror(name);
+    return 0;
+  }
+
+  s = &streams[num_streams];
+  alloc_stream(s, MAX_SAMPLES);
+  while (fgets(line, sizeof(line), f) != NULL && s->n < MAX_SAMPLES)
+    if (line[0] != '#' && sscanf(line, "%ld %ld", &g, &a) == 2) {
+      s->gyro[s->n] = (f16_16)g;
+      s->accel[s->n] = (f16_16)a;
+      s->n++;
+    }
+  fclose(f);
+
+  if (s->n <= SETTLE_SECONDS * UPDATE_HZ) {
+    fprintf (stderr, "%s: recording too short\n", name);
+    return 0;
+  }
+  num_streams++;
+  return 1;
+}
+
+/* The accelerometer's angle, the way kalman_step() works it out. */
+static f16_16
+theta_m_of(f16_16 a)
+{
+  if (a > 65536)
+    a = 65536;
+  if (a < -65536)
+    a = -65536;
+  return fastasin_f16_16(a);
+}
+
+/* Lag: time to get 63% of the way to a 1 degree step. */
+static double
+measure_lag(const candidate_t *c)
+{
+  kalman_fn fn = kalman_engines[c->engine].fn;
+  kalman_state_t s;
+  int i, cnt = 0;
+
+  kalman_state_init(&s);
+  for (i = 0; i < LAG_TICKS; i++) {
+    if (++cnt == c->every)
+      cnt = 0;
+    fn(&s, 0, 0, cnt == 0);
+  }
+  for (i = 0; i < LAG_TICKS; i++) {
+    if (++cnt == c->every)
+      cnt = 0;
+    if (fn(&s, 0, 65536, cnt == 0) >= 41419)	/* 0.632 */
+      return (i + 1) * 1000.0 / UPDATE_HZ;
+  }
+  return 1e9;
+}
+
+/* Replays every stream through the candidate's filter with its
+   settings. */
+static void
+evaluate(candidate_t *c)
+{
+  kalman_fn fn = kalman_engines[c->engine].fn;
+  int hz = UPDATE_HZ / c->every;
+  kalman_state_t s;
+  f16_16 theta_m = 0, prev, prev_bias, th;
+  double corr_sq = 0, err_sq = 0, d;
+  long corr_n = 0, err_n = 0;
+  int i, k, cnt, do_kalman;
+
+  /* kalman2() works its process noise out per update, the way
+     kalman.c does for KALMAN_HZ. */
+  Q = c->Q;
+  R = c->R;
+  kalman_dt = (65536 + hz/2) / hz;
+  Q_angle_dt = (c->Q + hz/2) / hz;
+  Q_bias_dt = (Q_BIAS + hz/2) / hz;
+
+  c->lag_ms = measure_lag(c);
+
+  for (k = 0; k < num_streams; k++) {
+    stream_t *st = &streams[k];
+
+    kalman_state_init(&s);
+    cnt = 0;
+    for (i = 0; i < st->n; i++) {
+      do_kalman = (++cnt == c->every);
+      if (do_kalman) {
+	cnt = 0;
+	theta_m = theta_m_of(st->accel[i]);
+      }
+      prev = s.theta;
+      prev_bias = s.bias;
+      th = fn(&s, st->gyro[i], theta_m, do_kalman);
+      if (i < SETTLE_SECONDS * UPDATE_HZ)
+	continue;
+
+      /* Whatever the gyro (less kalman2()'s bias) didn't account for
+	 came from the accelerometer. */
+      if (do_kalman) {
+	d = (th - prev -
+	     mult_f16_16 (sub_f16_16 (st->gyro[i], prev_bias), dt)) / 65536.0;
+	corr_sq += d * d;
+	corr_n++;
+      }
+      if (st->truth != NULL) {
+	d = th / 65536.0 - st->truth[i];
+	err_sq += d * d;
+	err_n++;
+      }
+    }
+  }
+
+  c->noise = corr_n ? sqrt(corr_sq / corr_n) : 0;
+  c->err = err_n ? sqrt(err_sq / err_n) : 0;
+}
+
+/* Next candidate for worker 'w', or -1 when there's nothing left
+   anywhere. */
+static int
+next_candidate(worker_t *w)
+{
+  int i, v, lo, hi, mid;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->next < w->end) {
+    i = w->next++;
+    pthread_mutex_unlock(&w->lock);
+    return i;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  /* Out of work - take the top half of someone else's range. */
+  for (v = 1; v < num_workers; v++) {
+    worker_t *victim = &workers[(w->id + v) % num_workers];
+
+    pthread_mutex_lock(&victim->lock);
+    lo = victim->next;
+    hi = victim->end;
+    if (lo >= hi) {
+      pthread_mutex_unlock(&victim->lock);
+      continue;
+    }
+    mid = lo + (hi - lo) / 2;
+    victim->end = mid;
+    pthread_mutex_unlock(&victim->lock);
+
+    pthread_mutex_lock(&w->lock);
+    w->next = mid + 1;
+    w->end = hi;
+    w->steals++;
+    pthread_mutex_unlock(&w->lock);
+    return mid;
+  }
+
+  return -1;
+}
+
+static void *
+worker_main(void *arg)
+{
+  worker_t *w = arg;
+  int i;
+
+  while ((i = next_candidate(w)) >= 0)
+    evaluate(&cands[i]);
+
+  return NULL;
+}
+
+/* Evaluate every candidate, on 'threads' threads. */
+static int
+run_pool(int threads)
+{
+  int i, steals = 0;
+
+  num_workers = threads;
+  workers = calloc(threads, sizeof(worker_t));
+  for (i = 0; i < threads; i++) {
+    pthread_mutex_init(&workers[i].lock, NULL);
+    workers[i].id = i;
+    workers[i].next = (long long)num_cands * i / threads;
+    workers[i].end = (long long)num_cands * (i + 1) / threads;
+  }
+  for (i = 0; i < threads; i++)
+    pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+  for (i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    steals += workers[i].steals;
+  }
+
+  return steals;
+}
+
+static f16_16
+log_step(f16_16 lo, f16_16 hi, double frac)
+{
+  return (f16_16)lrint(lo * pow((double)hi / lo, frac));
+}
+
+static void
+make_grid(void)
+{
+  int e, q, r, k, n = 0;
+
+  num_cands = NUM_ENGINES * GRID_Q * GRID_R * NUM_RATIOS;
+  cands = calloc(num_cands, sizeof(candidate_t));
+  for (e = 0; e < NUM_ENGINES; e++)
+    for (k = 0; k < NUM_RATIOS; k++)
+      for (q = 0; q < GRID_Q; q++)
+	for (r = 0; r < GRID_R; r++) {
+	  cands[n].Q = log_step(Q_MIN, Q_MAX, (double)q / (GRID_Q - 1));
+	  cands[n].R = log_step(R_MIN, R_MAX, (double)r / (GRID_R - 1));
+	  cands[n].every = ratios[k];
+	  cands[n].engine = e;
+	  n++;
+	}
+}
+
+static void
+make_random(int n)
+{
+  unsigned seed = 2463534242U;
+  int i;
+
+  num_cands = n;
+  cands = calloc(num_cands, sizeof(candidate_t));
+  for (i = 0; i < n; i++) {
+    cands[i].Q = log_step(Q_MIN, Q_MAX, rand_unit(&seed));
+    cands[i].R = log_step(R_MIN, R_MAX, rand_unit(&seed));
+    cands[i].every = ratios[rand_next(&seed) % NUM_RATIOS];
+    cands[i].engine = i % NUM_ENGINES;
+  }
+}
+
+static int
+compare_lag(const void *av, const void *bv)
+{
+  const candidate_t *a = av, *b = bv;
+
+  if (a->engine != b->engine)
+    return a->engine - b->engine;
+  if (a->lag_ms != b->lag_ms)
+    return a->lag_ms < b->lag_ms ? -1 : 1;
+  return a->noise < b->noise ? -1 : a->noise > b->noise;
+}
+
+/* Mark the candidates nothing else for the same filter beats on both
+   lag and noise.  Sorted by filter and lag, a candidate is on the front
+   if it's quieter than everything with less lag. */
+static int
+mark_pareto(void)
+{
+  double best_noise = 1e9;
+  int i, n = 0;
+
+  qsort(cands, num_cands, sizeof(candidate_t), compare_lag);
+  for (i = 0; i < num_cands; i++) {
+    if (i > 0 && cands[i].engine != cands[i-1].engine)
+      best_noise = 1e9;
+    if (cands[i].lag_ms < 1e9 && cands[i].noise < best_noise) {
+      best_noise = cands[i].noise;
+      cands[i].pareto = 1;
+      n++;
+    }
+  }
+  return n;
+}
+
+int
+main(int argc, char **argv)
+{
+  int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int random_n = 0, opt, e, i, steals, front;
+  long samples = 0;
+  struct timespec t0, t1;
+  double secs;
+
+  while ((opt = getopt(argc, argv, "j:r:")) != -1)
+    switch (opt) {
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'r':
+      random_n = atoi(optarg);
+      break;
+    default:
+      fprintf (stderr, "usage: %s [-j threads] [-r random_candidates] "
+	       "[file...]\n", argv[0]);
+      return 1;
+    }
+  if (threads < 1)
+    threads = 1;
+
+  for (i = optind; i < argc; i++)
+    if (!read_data(argv[i]))
+      return 1;
+  if (num_streams == 0) {
+    synthetic = 1;
+    make_data();
+  }
+  for (i = 0; i < num_streams; i++)
+    samples += streams[i].n;
+
+  if (random_n > 0)
+    make_random(random_n);
+  else
+    make_grid();
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  steals = run_pool(threads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+  printf ("%d candidates over %d %s (%ld samples) on %d threads: "
+	  "%.2f s, %d steals\n", num_cands, num_streams,
+	  synthetic ? "made up recording" : "recordings", samples, threads,
+	  secs, steals);
+
+  front = mark_pareto();
+  printf ("\n%d candidates on the lag/noise fronts.\n", front);
+
+  for (e = 0; e < NUM_ENGINES; e++) {
+    printf ("\n%s()%s:\n\n", kalman_engines[e].name,
+	    e == kalman_selected() ? " - the one kalman_step() runs" : "");
+    printf ("  %8s %8s %10s %10s %10s%s\n",
+	    e == 0 ? "Q" : "Q_angle", "R", "KALMAN_HZ", "lag ms",
+	    "noise deg", synthetic ? "    err deg" : "");
+    for (i = 0; i < num_cands; i++)
+      if (cands[i].pareto && cands[i].engine == e) {
+	printf ("  %8.4f %8.4f %10d %10.0f %10.5f", cands[i].Q / 65536.0,
+		cands[i].R / 65536.0, UPDATE_HZ / cands[i].every,
+		cands[i].lag_ms, cands[i].noise);
+	if (synthetic)
+	  printf (" %10.4f", cands[i].err);
+	printf ("\n");
+      }
+  }
+
+  printf ("\nTo use one, paste into kalman.c:\n");
+  for (i = 0; i < num_cands; i++)
+    if (cands[i].pareto) {
+      printf ("\n/* %s(): lag %.0f ms, noise %.5f degrees */\n",
+	      kalman_engines[cands[i].engine].name, cands[i].lag_ms,
+	      cands[i].noise);
+      printf ("#define KALMAN_HZ %d\n", UPDATE_HZ / cands[i].every);
+      if (cands[i].engine == 0)
+	printf ("KALMAN_CONST f16_16 Q\t\t= %ld;\t\t/* %.4f */\n",
+		(long)cands[i].Q, cands[i].Q / 65536.0);
+      else
+	printf ("#define Q_ANGLE\t\t%ld\t\t/* %.4f */\n",
+		(long)cands[i].Q, cands[i].Q / 65536.0);
+      printf ("KALMAN_VAR f16_16 R\t\t= %ld;\t/* %.4f */\n",
+	      (long)cands[i].R, cands[i].R / 65536.0);
+    }
+
+  return 0;
+}